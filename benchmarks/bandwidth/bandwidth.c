@@ -0,0 +1,2064 @@
+#include <float.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "bench.h"
+#include "config.h"
+#include "fit.h"
+#include "placement.h"
+
+#ifndef REPS
+#define REPS 10
+#endif
+
+#ifndef INCLUDE_ALLOC
+#define INCLUDE_ALLOC 1
+#endif
+
+// Kinds of host memory the transfers use (BW_MEMORY)
+enum bandwidth_memory_kind {
+    BW_MEM_PAGEABLE = 0,    // pageable memory, copies are staged by the runtime
+    BW_MEM_PINNED,          // page-locked memory allocated by the runtime
+    BW_MEM_REGISTERED,      // pageable memory page-locked (registered) after allocation
+    BW_MEM_ZEROCOPY,        // page-locked memory accessed directly by the kernel
+    BW_MEM_NKINDS
+};
+
+static const char * const memory_kind_names[BW_MEM_NKINDS] = {
+    "pageable", "pinned", "registered", "zerocopy"
+};
+
+typedef struct bandwidth_data {
+    int nsizes;
+    const size_t * array_sizes_bytes;
+    char ** per_thread_buffs;
+    size_t buf_size;
+    int kind;                       // current host memory kind
+    int pages;                      // current page size of pageable buffers (BW_PAGES)
+    int include_alloc;              // allocate device memory in every round trip (BW_INCLUDE_ALLOC)
+    char variant[48];               // record variant, e.g. "memory=pinned"
+    bench_stats_t ** reg_stats;     // [size][core] register + unregister time
+    bench_stats_t *** alloc_stats;  // [size][core][device] device alloc + free time
+    bench_placement_t placement;    // host buffer placement (BW_PLACEMENT)
+    int * buf_node;                 // NUMA domain each buffer is currently bound to
+    double ** buffer_numa;          // [core][device] domain the buffer resided on
+    double *** times_abs;
+    double *** bandwidth;
+    bench_stats_t *** stats;
+} bandwidth_data_t;
+
+typedef struct transfer_arg {
+    const bench_backend_t * be;
+    bench_devbuf_t buf;
+} transfer_arg_t;
+
+// one repetition without staging copies: the kernel accesses host memory
+static void zerocopy_rep(void * arg) {
+    transfer_arg_t * a = (transfer_arg_t *)arg;
+    a->be->zerocopy(a->buf.dev, a->buf.host, a->buf.size);
+}
+
+// one repetition of page-locking size bytes of host memory and releasing them
+static void register_rep(void * arg) {
+    transfer_arg_t * a = (transfer_arg_t *)arg;
+    a->be->host_register(a->buf.host, a->buf.size);
+    a->be->host_unregister(a->buf.host, a->buf.size);
+}
+
+// one repetition of allocating and freeing device memory only
+static void alloc_rep(void * arg) {
+    transfer_arg_t * a = (transfer_arg_t *)arg;
+    a->be->alloc(&a->buf);
+    a->be->free(&a->buf);
+}
+
+// Backend operations with fallbacks to alloc/copy/free
+static void map_to(const bench_backend_t * be, bench_devbuf_t * buf) {
+    if (be->map_to != NULL) {
+        be->map_to(buf);
+    } else {
+        be->alloc(buf);
+        be->copy_h2d(buf, buf->size);
+        be->sync(buf->dev);
+    }
+}
+
+static void unmap_from(const bench_backend_t * be, bench_devbuf_t * buf) {
+    if (be->unmap_from != NULL) {
+        be->unmap_from(buf);
+    } else {
+        be->copy_d2h(buf, buf->size);
+        be->sync(buf->dev);
+        be->free(buf);
+    }
+}
+
+// one repetition with allocation: allocate, copy, launch, copy back, free
+static void roundtrip_rep(void * arg) {
+    transfer_arg_t * a = (transfer_arg_t *)arg;
+    a->be->roundtrip(a->buf.dev, a->buf.host, a->buf.size);
+}
+
+// one repetition on persistent device memory: copy, launch, copy back. If
+// the backend maps host memory (OpenMP), the buffer stays mapped and the
+// round trip on present data only launches the kernel.
+static void persistent_rep(void * arg) {
+    transfer_arg_t * a = (transfer_arg_t *)arg;
+    if (a->be->update_to != NULL && a->be->update_from != NULL) {
+        a->be->update_to(&a->buf);
+        a->be->roundtrip(a->buf.dev, a->buf.host, a->buf.size);
+        a->be->update_from(&a->buf);
+        return;
+    }
+    a->be->copy_h2d(&a->buf, a->buf.size);
+    a->be->launch(a->buf.dev, &a->buf);
+    a->be->copy_d2h(&a->buf, a->buf.size);
+    a->be->sync(a->buf.dev);
+}
+
+// Time the round trips (copy to device, empty kernel, copy back) of the
+// first size bytes of buffer to device d. With include_alloc the device
+// memory is allocated and freed in every repetition, otherwise it is
+// allocated (or the buffer mapped) once outside the timed region. Zero-copy
+// round trips let a kernel read and write the host buffer in place instead.
+// If window is not NULL, it receives the wall time before and after the
+// sampled repetitions, without device initialization and mapping.
+static void time_transfers(bench_context_t * ctx, const bandwidth_data_t * data, int d, char * buffer,
+                           size_t size, int adaptive, bench_stats_t * st, double * window) {
+    transfer_arg_t a = { ctx->backend, { d, buffer, size, NULL } };
+    bench_rep_fn fn = persistent_rep;
+    ctx->backend->init_device(d);
+    if (data->kind == BW_MEM_ZEROCOPY) {
+        fn = zerocopy_rep;
+    } else if (data->include_alloc) {
+        fn = roundtrip_rep;
+    } else {
+        map_to(ctx->backend, &a.buf);
+    }
+    double ts = omp_get_wtime();
+    bench_sample(ctx, fn, &a, adaptive, st);
+    double te = omp_get_wtime();
+    if (fn == persistent_rep) {
+        unmap_from(ctx->backend, &a.buf);
+    }
+    if (window != NULL) {
+        window[0] = ts;
+        window[1] = te;
+    }
+}
+
+// Domain returned by place_buffer if the buffer could not be placed
+#define BW_PLACE_FAILED (-2)
+
+// Move the pageable buffer of core c to the NUMA domain the placement
+// requests for device d. Returns the domain the buffer resides on (-1 if interleaved or
+// unknown) or BW_PLACE_FAILED; the cell is then skipped, it would measure
+// another placement than requested.
+static int place_buffer(bench_context_t * ctx, bandwidth_data_t * data, int c, int d) {
+    char * buf = data->per_thread_buffs[c];
+    // page-locked memory cannot be migrated
+    if (data->placement.mode == BENCH_PLACE_LOCAL || data->kind != BW_MEM_PAGEABLE) {
+        int node = bench_buffer_node(buf);
+        return node >= 0 ? node : ctx->core_numa[c];
+    }
+    int node = bench_placement_node(ctx, &data->placement, c, d);
+    if (node != data->buf_node[c]) {
+        if (bench_buffer_place(buf, data->buf_size, data->pages, node) != 0) {
+            fprintf(stderr, "could not place buffer of thread %d on NUMA domain %d, skipping device %d\n",
+                    c, node, d);
+            data->buf_node[c] = BW_PLACE_FAILED;
+            return BW_PLACE_FAILED;
+        }
+        data->buf_node[c] = node;
+    }
+    return node < 0 ? -1 : bench_buffer_node(buf);
+}
+
+static void measure_core(bench_context_t * ctx, int c, void * arg) {
+    bandwidth_data_t * data = (bandwidth_data_t *)arg;
+    for (int s = 0; s < data->nsizes; s++) {
+        size_t cur_size     = data->array_sizes_bytes[s];
+        double tmp_size_mb  = ((double)cur_size / 1e6);
+
+        for (int d = 0; d < ctx->ndev; d++) {
+            int node = place_buffer(ctx, data, c, d);
+            bench_stats_t * st = &data->stats[s][c][d];
+            if (node == BW_PLACE_FAILED) {
+                // skipped cells have no repetitions and are not written
+                memset(st, 0, sizeof(*st));
+                data->buffer_numa[c][d] = -1;
+                data->times_abs[s][c][d] = 0.0;
+                data->bandwidth[s][c][d] = 0.0;
+                continue;
+            }
+            data->buffer_numa[c][d] = node;
+            bench_progress("running for thread=%3d, size=%7.2fMB, device=%2d and buffer on NUMA domain %d\n",
+                           c, tmp_size_mb, d, node);
+
+            time_transfers(ctx, data, d, data->per_thread_buffs[c], cur_size, 1, st, NULL);
+            data->times_abs[s][c][d] = st->sum;
+            data->bandwidth[s][c][d] = tmp_size_mb * 2 / st->mean;
+        }
+    }
+}
+
+// Contention mode: selected cores issue transfers at the same time. Cores
+// are selected via BW_CONTENTION_CORES ("all", "numa" for one core per NUMA
+// domain, or a list like "0,4,8-11"). BW_CONTENTION_DEVICES selects whether
+// all cores target the "same" device (each device in turn) or "spread"
+// round-robin over the devices.
+static void run_contention(bench_context_t * ctx, const char * core_spec, bandwidth_data_t * data) {
+    int ncores = ctx->ncores;
+    int ndev = ctx->ndev;
+    int nsizes = data->nsizes;
+    const char * dev_spec = getenv("BW_CONTENTION_DEVICES");
+    int spread = (dev_spec != NULL && strcmp(dev_spec, "spread") == 0);
+    int ncfg = spread ? 1 : ndev;
+
+    // Select the participating cores.
+    int * sel_cores = (int *)malloc(ncores * sizeof(int));
+    int nsel = bench_select_cores(core_spec, ncores, ctx->core_numa, sel_cores);
+    if (nsel == 0 || ndev == 0) {
+        fprintf(stdout, "contention mode: nothing to measure (cores=%d, devices=%d)\n", nsel, ndev);
+        free(sel_cores);
+        return;
+    }
+
+    // Concurrency levels: 1, 2, 4, ... and finally all selected cores.
+    int nlevels = 0;
+    int * levels = (int *)malloc((nsel + 1) * sizeof(int));
+    for (int k = 1; k < nsel; k *= 2) {
+        levels[nlevels++] = k;
+    }
+    levels[nlevels++] = nsel;
+
+    fprintf(stdout, "contention mode: %d cores, devices=%s\n", nsel, spread ? "spread" : "same");
+    fprintf(stdout, "selected cores (NUMA domain):");
+    for (int k = 0; k < nsel; k++) {
+        fprintf(stdout, " %d(%d)", sel_cores[k], ctx->core_numa[sel_cores[k]]);
+    }
+    fprintf(stdout, "\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // Result data: [size][config][level] and per-core bandwidth at full concurrency.
+    int ncells = nsizes * ncfg * nlevels;
+    double * aggregate = (double *)malloc(ncells * sizeof(double));
+    double * core_min  = (double *)malloc(ncells * sizeof(double));
+    double * core_max  = (double *)malloc(ncells * sizeof(double));
+    double * core_mean = (double *)malloc(ncells * sizeof(double));
+    double * jain      = (double *)malloc(ncells * sizeof(double));
+    double * per_core  = (double *)malloc(nsizes * ncfg * nsel * sizeof(double));
+    // Per-core statistics and wall time window of the sampled repetitions.
+    bench_stats_t * core_stats = (bench_stats_t *)malloc(ncores * sizeof(bench_stats_t));
+    double (*window)[2] = (double (*)[2])malloc(ncores * sizeof(*window));
+    // set if a participant of the current level could not place its buffer
+    int unplaced = 0;
+
+    #pragma omp parallel num_threads(ncores)
+    {
+        int cur_thread = omp_get_thread_num();
+        int my_rank = -1;
+        for (int k = 0; k < nsel; k++) {
+            if (sel_cores[k] == cur_thread) {
+                my_rank = k;
+            }
+        }
+
+        for (int s = 0; s < nsizes; s++) {
+            size_t cur_size     = data->array_sizes_bytes[s];
+            double tmp_size_mb  = ((double)cur_size / 1e6);
+            for (int g = 0; g < ncfg; g++) {
+                for (int l = 0; l < nlevels; l++) {
+                    int active = (my_rank >= 0 && my_rank < levels[l]);
+                    if (active && place_buffer(ctx, data, cur_thread, spread ? (my_rank % ndev) : g) == BW_PLACE_FAILED) {
+                        #pragma omp atomic write
+                        unplaced = 1;
+                    }
+                    #pragma omp single
+                    {
+                        bench_progress("running for %3d cores, size=%7.2fMB and device=%s\n",
+                                       levels[l], tmp_size_mb, spread ? "spread" : "same");
+                    }
+                    // implicit barrier of single: all participants start together with
+                    // their buffers in place, or skip the level together
+                    if (active && !unplaced) {
+                        int d = spread ? (my_rank % ndev) : g;
+                        time_transfers(ctx, data, d, data->per_thread_buffs[cur_thread], cur_size, 0,
+                                       &core_stats[cur_thread], window[cur_thread]);
+                    }
+                    #pragma omp barrier
+                    #pragma omp single
+                    {
+                        int idx = (s * ncfg + g) * nlevels + l;
+                        if (unplaced) {
+                            // skipped level: zero in the tables, no records
+                            aggregate[idx] = core_min[idx] = core_max[idx] = core_mean[idx] = jain[idx] = 0.0;
+                            for (int k = 0; k < nsel && levels[l] == nsel; k++) {
+                                per_core[(s * ncfg + g) * nsel + k] = 0.0;
+                            }
+                            unplaced = 0;
+                        } else {
+                            double first = DBL_MAX, last = 0.0;
+                            double sum = 0.0, sum_sq = 0.0, reps = 0.0;
+                            double bw_min = DBL_MAX, bw_max = 0.0;
+                            for (int k = 0; k < levels[l]; k++) {
+                                int c = sel_cores[k];
+                                double bw = tmp_size_mb * 2 / core_stats[c].mean;
+                                if (window[c][0] < first) first = window[c][0];
+                                if (window[c][1] > last) last = window[c][1];
+                                reps += core_stats[c].n;
+                                if (bw < bw_min) bw_min = bw;
+                                if (bw > bw_max) bw_max = bw;
+                                sum += bw;
+                                sum_sq += bw * bw;
+                                if (levels[l] == nsel) {
+                                    per_core[(s * ncfg + g) * nsel + k] = bw;
+                                }
+                                char variant[96];
+                                snprintf(variant, sizeof(variant), "cores=%d,devices=%s,%s",
+                                         levels[l], spread ? "spread" : "same", data->variant);
+                                bench_record_t rec;
+                                bench_record_init(&rec, "contention", c, spread ? (k % ndev) : g, cur_size);
+                                rec.variant = variant;
+                                rec.stats = &core_stats[c];
+                                bench_record_add(&rec, "bandwidth_mbs", bw);
+                                bench_output_record(ctx, &rec);
+                            }
+                            // all bytes moved between the first start and the last end of sampling
+                            aggregate[idx] = tmp_size_mb * 2 * reps / (last - first);
+                            core_min[idx]  = bw_min;
+                            core_max[idx]  = bw_max;
+                            core_mean[idx] = sum / levels[l];
+                            // Jain's fairness index: 1 = perfectly fair, 1/n = one core gets everything
+                            jain[idx]      = (sum * sum) / (levels[l] * sum_sq);
+
+                            char variant[96];
+                            snprintf(variant, sizeof(variant), "cores=%d,devices=%s,%s",
+                                     levels[l], spread ? "spread" : "same", data->variant);
+                            bench_record_t rec;
+                            bench_record_init(&rec, "contention", -1, spread ? -1 : g, cur_size);
+                            rec.variant = variant;
+                            bench_record_add(&rec, "aggregate_mbs", aggregate[idx]);
+                            bench_record_add(&rec, "mean_mbs", core_mean[idx]);
+                            bench_record_add(&rec, "min_mbs", core_min[idx]);
+                            bench_record_add(&rec, "max_mbs", core_max[idx]);
+                            bench_record_add(&rec, "jain", jain[idx]);
+                            bench_output_record(ctx, &rec);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    const char * titles[5] = {
+        "Contention: aggregate bandwidth (MB/s)",
+        "Contention: mean per-core bandwidth (MB/s)",
+        "Contention: min per-core bandwidth (MB/s)",
+        "Contention: max per-core bandwidth (MB/s)",
+        "Contention: fairness (Jain index)"
+    };
+    double * tables[5] = {aggregate, core_mean, core_min, core_max, jain};
+    for (int t = 0; t < 5; t++) {
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "%s\n", titles[t]);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < nsizes; s++) {
+            size_t cur_size = data->array_sizes_bytes[s];
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", cur_size / 1000.0);
+            fprintf(stdout, ";");
+            for (int l = 0; l < nlevels; l++) {
+                fprintf(stdout, "%d Cores%c", levels[l], l<nlevels-1 ? ';' : '\n');
+            }
+            for (int g = 0; g < ncfg; g++) {
+                if (spread) {
+                    fprintf(stdout, "Spread;");
+                } else {
+                    fprintf(stdout, "GPU %d;", g);
+                }
+                for (int l = 0; l < nlevels; l++) {
+                    fprintf(stdout, "%lf%c", tables[t][(s * ncfg + g) * nlevels + l], l<nlevels-1 ? ';' : '\n');
+                }
+            }
+        }
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Contention: per-core bandwidth with all %d cores active (MB/s)\n", nsel);
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        size_t cur_size = data->array_sizes_bytes[s];
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", cur_size / 1000.0);
+        fprintf(stdout, ";");
+        for (int k = 0; k < nsel; k++) {
+            fprintf(stdout, "Core %d%c", sel_cores[k], k<nsel-1 ? ';' : '\n');
+        }
+        for (int g = 0; g < ncfg; g++) {
+            if (spread) {
+                fprintf(stdout, "Spread;");
+            } else {
+                fprintf(stdout, "GPU %d;", g);
+            }
+            for (int k = 0; k < nsel; k++) {
+                fprintf(stdout, "%lf%c", per_core[(s * ncfg + g) * nsel + k], k<nsel-1 ? ';' : '\n');
+            }
+        }
+    }
+
+    free(sel_cores);
+    free(levels);
+    free(aggregate);
+    free(core_min);
+    free(core_max);
+    free(core_mean);
+    free(jain);
+    free(per_core);
+    free(core_stats);
+    free(window);
+}
+
+typedef struct pipeline_arg {
+    const bench_backend_t * be;
+    bench_devbuf_t buf;
+    size_t chunk;
+    int depth;
+} pipeline_arg_t;
+
+// one repetition of a pipelined round trip on persistent device memory
+static void pipeline_rep(void * arg) {
+    pipeline_arg_t * a = (pipeline_arg_t *)arg;
+    a->be->pipeline(&a->buf, a->chunk, a->depth);
+}
+
+// Pipelined mode: every transfer size is split into chunks (BW_PIPELINE_CHUNKS,
+// e.g. "64K,1M") with up to depth chunks in flight (BW_PIPELINE_DEPTHS,
+// default "1,2,4,8"), so that copies to the device, kernels and copies back
+// of different chunks overlap. Measured from a single core (BW_PIPELINE_CORE,
+// default 0) to every device.
+static void run_pipeline(bench_context_t * ctx, const char * chunk_spec, bandwidth_data_t * data) {
+    int ndev = ctx->ndev;
+    int nsizes = data->nsizes;
+    const char * depth_spec = getenv("BW_PIPELINE_DEPTHS");
+    const char * core_str = getenv("BW_PIPELINE_CORE");
+    int core = core_str ? atoi(core_str) : 0;
+    if (core < 0 || core >= ctx->ncores) {
+        core = 0;
+    }
+
+    size_t * chunks = NULL;
+    size_t * depths = NULL;
+    int nchunks = bench_parse_size_list(chunk_spec, &chunks);
+    int ndepths = bench_parse_size_list(depth_spec ? depth_spec : "1,2,4,8", &depths);
+    for (int i = 0; i < ndepths; i++) {
+        if (depths[i] > BENCH_MAX_PIPELINE_DEPTH) {
+            depths[i] = BENCH_MAX_PIPELINE_DEPTH;
+        }
+    }
+    if (nchunks == 0 || ndepths == 0 || ndev == 0 || data->kind == BW_MEM_ZEROCOPY) {
+        fprintf(stdout, "pipeline mode: nothing to measure (chunks=%d, depths=%d, devices=%d, memory=%s)\n",
+                nchunks, ndepths, ndev, memory_kind_names[data->kind]);
+        free(chunks);
+        free(depths);
+        return;
+    }
+
+    fprintf(stdout, "pipeline mode: core %d, %d chunk sizes, %d depths\n", core, nchunks, ndepths);
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // Bandwidth indexed by [size][device][chunk][depth].
+    double * bandwidth = (double *)calloc((size_t)nsizes * ndev * nchunks * ndepths, sizeof(double));
+
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        if (omp_get_thread_num() == core) {
+            for (int s = 0; s < nsizes; s++) {
+                size_t cur_size     = data->array_sizes_bytes[s];
+                double tmp_size_mb  = ((double)cur_size / 1e6);
+                for (int d = 0; d < ndev; d++) {
+                    if (place_buffer(ctx, data, core, d) == BW_PLACE_FAILED) {
+                        continue;
+                    }
+                    ctx->backend->init_device(d);
+                    pipeline_arg_t a = { ctx->backend, { d, data->per_thread_buffs[core], cur_size, NULL }, 0, 1 };
+                    ctx->backend->alloc(&a.buf);
+                    for (int i = 0; i < nchunks; i++) {
+                        for (int j = 0; j < ndepths; j++) {
+                            bench_progress("running for size=%7.2fMB, device=%2d, chunk=%7.2fMB and depth=%2zu\n",
+                                           tmp_size_mb, d, chunks[i] / 1e6, depths[j]);
+                            a.chunk = chunks[i];
+                            a.depth = (int)depths[j];
+                            bench_stats_t st;
+                            bench_sample(ctx, pipeline_rep, &a, 1, &st);
+                            double bw = tmp_size_mb * 2 / st.mean;
+                            bandwidth[((size_t)(s * ndev + d) * nchunks + i) * ndepths + j] = bw;
+
+                            char variant[96];
+                            snprintf(variant, sizeof(variant), "chunk=%zu,depth=%zu,%s",
+                                     chunks[i], depths[j], data->variant);
+                            bench_record_t rec;
+                            bench_record_init(&rec, "pipeline", core, d, cur_size);
+                            rec.variant = variant;
+                            rec.stats = &st;
+                            bench_record_add(&rec, "bandwidth_mbs", bw);
+                            bench_record_add(&rec, "chunk", (double)chunks[i]);
+                            bench_record_add(&rec, "depth", (double)depths[j]);
+                            bench_output_record(ctx, &rec);
+                        }
+                    }
+                    ctx->backend->free(&a.buf);
+                }
+            }
+        }
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Pipelined bandwidth by chunk size and depth (MB/s)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        for (int d = 0; d < ndev; d++) {
+            fprintf(stdout, "##### Problem Size: %.2f KB, GPU %d\n", data->array_sizes_bytes[s] / 1000.0, d);
+            fprintf(stdout, ";");
+            for (int j = 0; j < ndepths; j++) {
+                fprintf(stdout, "Depth %zu%c", depths[j], j<ndepths-1 ? ';' : '\n');
+            }
+            for (int i = 0; i < nchunks; i++) {
+                fprintf(stdout, "%.2f KB;", chunks[i] / 1000.0);
+                for (int j = 0; j < ndepths; j++) {
+                    fprintf(stdout, "%lf%c", bandwidth[((size_t)(s * ndev + d) * nchunks + i) * ndepths + j],
+                            j<ndepths-1 ? ';' : '\n');
+                }
+            }
+        }
+    }
+
+    // Smallest chunk that achieves 90% of the peak bandwidth of the size.
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Pipeline saturation: smallest chunk within 10%% of the peak (KB)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, ";");
+    for (int j = 0; j < ndepths; j++) {
+        fprintf(stdout, "Depth %zu%c", depths[j], j<ndepths-1 ? ';' : '\n');
+    }
+    for (int s = 0; s < nsizes; s++) {
+        for (int d = 0; d < ndev; d++) {
+            const double * bw = &bandwidth[(size_t)(s * ndev + d) * nchunks * ndepths];
+            double peak = 0.0;
+            for (int k = 0; k < nchunks * ndepths; k++) {
+                if (bw[k] > peak) {
+                    peak = bw[k];
+                }
+            }
+            fprintf(stdout, "%.2f KB GPU %d;", data->array_sizes_bytes[s] / 1000.0, d);
+            for (int j = 0; j < ndepths; j++) {
+                double smallest = 0.0;
+                for (int i = 0; i < nchunks; i++) {
+                    if (bw[i * ndepths + j] >= 0.9 * peak && (smallest == 0.0 || chunks[i] < smallest)) {
+                        smallest = (double)chunks[i];
+                    }
+                }
+                fprintf(stdout, "%lf%c", smallest / 1000.0, j<ndepths-1 ? ';' : '\n');
+            }
+        }
+    }
+
+    free(bandwidth);
+    free(chunks);
+    free(depths);
+}
+
+// Determine the transfer sizes: an explicit list via BW_SIZES (e.g.
+// "4K,64K,1M"), a geometric sweep from BW_SIZE_MIN to BW_SIZE_MAX with
+// factor BW_SIZE_FACTOR (default 2), or the default sizes 10MB, 100MB, 1GB.
+static int setup_sizes(size_t ** sizes) {
+    const char * list = getenv("BW_SIZES");
+    const char * min = getenv("BW_SIZE_MIN");
+    const char * max = getenv("BW_SIZE_MAX");
+    int nsizes = 0;
+
+    if (list != NULL) {
+        nsizes = bench_parse_size_list(list, sizes);
+    } else if (min != NULL || max != NULL) {
+        const char * factor_str = getenv("BW_SIZE_FACTOR");
+        size_t lo = min ? bench_parse_size(min, NULL) : 8;
+        size_t hi = max ? bench_parse_size(max, NULL) : ((size_t)2 << 30);
+        size_t factor = factor_str ? (size_t)atol(factor_str) : 2;
+        if (lo == 0) lo = 1;
+        if (factor < 2) factor = 2;
+        for (size_t sz = lo; sz <= hi; sz *= factor) {
+            nsizes++;
+        }
+        *sizes = (size_t *)malloc((nsizes > 0 ? nsizes : 1) * sizeof(size_t));
+        nsizes = 0;
+        for (size_t sz = lo; sz <= hi; sz *= factor) {
+            (*sizes)[nsizes++] = sz;
+        }
+    } else {
+        nsizes = 3;
+        *sizes = (size_t *)malloc(nsizes * sizeof(size_t));
+        (*sizes)[0] = 10000000;
+        (*sizes)[1] = 100000000;
+        (*sizes)[2] = 1000000000;
+    }
+    return nsizes;
+}
+
+// Fit the Hockney model t = alpha + n/beta over all sizes for every core/device
+// pair, where n are the bytes moved per round trip (to and from the device).
+static void print_model_fit(bench_context_t * ctx, bandwidth_data_t * data) {
+    int nsizes = data->nsizes;
+    double ** alpha = bench_matrix_alloc(ctx->ncores, ctx->ndev);
+    double ** beta = bench_matrix_alloc(ctx->ncores, ctx->ndev);
+    double ** n_half = bench_matrix_alloc(ctx->ncores, ctx->ndev);
+    double * bytes = (double *)malloc(nsizes * sizeof(double));
+    double * time = (double *)malloc(nsizes * sizeof(double));
+
+    for (int c = 0; c < ctx->ncores; c++) {
+        for (int d = 0; d < ctx->ndev; d++) {
+            for (int s = 0; s < nsizes; s++) {
+                bytes[s] = 2.0 * data->array_sizes_bytes[s];
+                time[s] = data->stats[s][c][d].mean;
+            }
+            bench_hockney_t fit;
+            if (bench_fit_hockney(bytes, time, nsizes, &fit) == 0) {
+                alpha[c][d] = fit.alpha * 1e6;
+                beta[c][d] = fit.beta / 1e6;
+                n_half[c][d] = fit.n_half / 1000.0;
+
+                bench_record_t rec;
+                bench_record_init(&rec, "hockney", c, d, 0);
+                rec.variant = data->variant;
+                bench_record_add(&rec, "alpha_s", fit.alpha);
+                bench_record_add(&rec, "beta_bytes_per_s", fit.beta);
+                bench_record_add(&rec, "n_half_bytes", fit.n_half);
+                bench_output_record(ctx, &rec);
+            }
+        }
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Hockney model t = alpha + n/beta: latency alpha (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_print_matrix(stdout, alpha, ctx->ncores, ctx->ndev, 1.0);
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Hockney model t = alpha + n/beta: asymptotic bandwidth beta (MB/s)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_print_matrix(stdout, beta, ctx->ncores, ctx->ndev, 1.0);
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Hockney model t = alpha + n/beta: half-performance size n_1/2 (KB)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_print_matrix(stdout, n_half, ctx->ncores, ctx->ndev, 1.0);
+
+    bench_matrix_free(alpha, ctx->ncores);
+    bench_matrix_free(beta, ctx->ncores);
+    bench_matrix_free(n_half, ctx->ncores);
+    free(bytes);
+    free(time);
+}
+
+// Print the bandwidth per core with one row per device and one column per size.
+static void print_per_core(bench_context_t * ctx, bandwidth_data_t * data, const double * divisor) {
+    int nsizes = data->nsizes;
+    for (int c = 0; c < ctx->ncores; c++) {
+        fprintf(stdout, "##### Core: %d\n", c);
+        fprintf(stdout, ";");
+        for (int s = 0; s < nsizes; s++) {
+            size_t cur_size = data->array_sizes_bytes[s];
+            fprintf(stdout, "%.2f KB%c", cur_size / 1000.0, s<nsizes-1 ? ';' : '\n');
+        }
+        for (int d = 0; d < ctx->ndev; d++) {
+            fprintf(stdout, "GPU %d;", d);
+            for (int s = 0; s < nsizes; s++) {
+                fprintf(stdout, "%lf%c", data->bandwidth[s][c][d] / divisor[s], s<nsizes-1 ? ';' : '\n');
+            }
+        }
+    }
+}
+
+// Check whether a comma separated list contains name as a whole entry.
+static int list_contains(const char * list, const char * name) {
+    size_t len = strlen(name);
+    for (const char * p = strstr(list, name); p != NULL; p = strstr(p + 1, name)) {
+        if ((p == list || p[-1] == ',') && (p[len] == '\0' || p[len] == ',')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parse the host memory kinds to measure: a list like "pageable,pinned" or
+// "all" (BW_MEMORY, default: pageable). Kinds the backend does not support
+// are skipped. Returns the number of kinds.
+static int setup_memory_kinds(const bench_context_t * ctx, int * kinds) {
+    const char * spec = getenv("BW_MEMORY");
+    const bench_backend_t * be = ctx->backend;
+    int supported[BW_MEM_NKINDS] = {
+        1,
+        be->host_alloc_pinned != NULL,
+        be->host_register != NULL,
+        be->host_alloc_pinned != NULL && be->zerocopy != NULL,
+    };
+    int nkinds = 0;
+    for (int k = 0; k < BW_MEM_NKINDS; k++) {
+        int wanted;
+        if (spec == NULL) {
+            wanted = (k == BW_MEM_PAGEABLE);
+        } else if (strcmp(spec, "all") == 0) {
+            wanted = 1;
+        } else {
+            wanted = list_contains(spec, memory_kind_names[k]);
+        }
+        if (wanted && !supported[k]) {
+            fprintf(stderr, "host memory kind '%s' is not supported by the %s backend, skipping\n",
+                    memory_kind_names[k], be->name);
+        } else if (wanted) {
+            kinds[nkinds++] = k;
+        }
+    }
+    return nkinds;
+}
+
+// Runtime allocated (page-locked) kinds are not backed by pages of our choice.
+static int kind_is_pinned(int kind) {
+    return kind == BW_MEM_PINNED || kind == BW_MEM_ZEROCOPY;
+}
+
+// Allocate a host buffer of the current memory kind and page size,
+// initialized using first-touch by the calling thread. Registration is up to
+// the caller. Returns NULL if no pages of the requested size are available.
+static char * alloc_host_buffer(bench_context_t * ctx, bandwidth_data_t * data) {
+    char * buf;
+    if (kind_is_pinned(data->kind)) {
+        buf = ctx->backend->host_alloc_pinned(data->buf_size);
+    } else {
+        buf = bench_buffer_alloc_pages(data->buf_size, data->pages);
+    }
+    if (buf != NULL) {
+        memset(buf, 0, data->buf_size);
+    }
+    return buf;
+}
+
+static void free_host_buffer(bench_context_t * ctx, bandwidth_data_t * data, char * buf) {
+    if (kind_is_pinned(data->kind)) {
+        ctx->backend->host_free_pinned(buf, data->buf_size);
+    } else {
+        bench_buffer_free_pages(buf, data->buf_size, data->pages);
+    }
+}
+
+// Allocate one buffer of the current memory kind per thread into bufs,
+// first-touched by the owning thread. Returns -1 and frees everything if a
+// buffer could not be allocated.
+static int alloc_thread_buffers(bench_context_t * ctx, bandwidth_data_t * data, char ** bufs) {
+    int failed = 0;
+    #pragma omp parallel num_threads(ctx->ncores) reduction(|:failed)
+    {
+        int cur_thread = omp_get_thread_num();
+        bufs[cur_thread] = alloc_host_buffer(ctx, data);
+        failed |= (bufs[cur_thread] == NULL);
+    }
+    if (failed) {
+        for (int c = 0; c < ctx->ncores; c++) {
+            if (bufs[c] != NULL) {
+                free_host_buffer(ctx, data, bufs[c]);
+            }
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static void free_thread_buffers(bench_context_t * ctx, bandwidth_data_t * data, char ** bufs) {
+    for (int c = 0; c < ctx->ncores; c++) {
+        free_host_buffer(ctx, data, bufs[c]);
+    }
+}
+
+// Allocate the per thread buffers of the current memory kind (first-touch by
+// the owning thread, other placements move them later on). Returns -1 if a
+// buffer could not be allocated.
+static int alloc_buffers(bench_context_t * ctx, bandwidth_data_t * data) {
+    if (alloc_thread_buffers(ctx, data, data->per_thread_buffs) != 0) {
+        return -1;
+    }
+    for (int c = 0; c < ctx->ncores; c++) {
+        data->buf_node[c] = ctx->core_numa[c];
+    }
+    return 0;
+}
+
+static void free_buffers(bench_context_t * ctx, bandwidth_data_t * data) {
+    free_thread_buffers(ctx, data, data->per_thread_buffs);
+}
+
+// Time registering and unregistering the first size bytes of the (not yet
+// registered) buffer for every size.
+static void measure_registration(bench_context_t * ctx, int c, void * arg) {
+    bandwidth_data_t * data = (bandwidth_data_t *)arg;
+    for (int s = 0; s < data->nsizes; s++) {
+        transfer_arg_t a = { ctx->backend, { 0, data->per_thread_buffs[c], data->array_sizes_bytes[s], NULL } };
+        bench_progress("registering for thread=%3d and size=%7.2fMB\n", c, data->array_sizes_bytes[s] / 1e6);
+        bench_sample(ctx, register_rep, &a, 1, &data->reg_stats[s][c]);
+    }
+}
+
+// Time allocating and freeing device memory of every size on every device
+// (BW_ALLOC_COST), i.e., what a device memory pool would save per transfer.
+static void measure_alloc(bench_context_t * ctx, int c, void * arg) {
+    bandwidth_data_t * data = (bandwidth_data_t *)arg;
+    for (int s = 0; s < data->nsizes; s++) {
+        for (int d = 0; d < ctx->ndev; d++) {
+            transfer_arg_t a = { ctx->backend, { d, NULL, data->array_sizes_bytes[s], NULL } };
+            bench_progress("allocating for thread=%3d, size=%7.2fMB and device=%2d\n",
+                           c, data->array_sizes_bytes[s] / 1e6, d);
+            ctx->backend->init_device(d);
+            bench_sample(ctx, alloc_rep, &a, 1, &data->alloc_stats[s][c][d]);
+        }
+    }
+}
+
+// Directional transfers (BW_DIRECTIONS)
+enum bandwidth_direction {
+    BW_DIR_TO = 0,      // target enter data map(to:)
+    BW_DIR_FROM,        // target exit data map(from:)
+    BW_DIR_UPDATE_TO,   // target update to() on mapped memory
+    BW_DIR_UPDATE_FROM, // target update from() on mapped memory
+    BW_DIR_BIDIR,       // update to and from at the same time
+    BW_DIR_N
+};
+
+static const char * const direction_names[BW_DIR_N] = {
+    "to", "from", "update_to", "update_from", "bidir"
+};
+
+typedef struct direction_arg {
+    const bench_backend_t * be;
+    bench_devbuf_t buf;     // to the device
+    bench_devbuf_t buf2;    // from the device (bidirectional)
+} direction_arg_t;
+
+typedef struct direction_data {
+    bandwidth_data_t * data;
+    int selected[BW_DIR_N];
+    char ** buf2;               // per thread second buffers of bidirectional transfers
+    bench_stats_t *** stats;    // [direction * nsizes + size][core][device]
+} direction_data_t;
+
+static void map_to_rep(void * arg) {
+    direction_arg_t * a = (direction_arg_t *)arg;
+    map_to(a->be, &a->buf);
+}
+
+static void unmap_from_rep(void * arg) {
+    direction_arg_t * a = (direction_arg_t *)arg;
+    unmap_from(a->be, &a->buf);
+}
+
+static void update_to_rep(void * arg) {
+    direction_arg_t * a = (direction_arg_t *)arg;
+    if (a->be->update_to != NULL) {
+        a->be->update_to(&a->buf);
+    } else {
+        a->be->copy_h2d(&a->buf, a->buf.size);
+        a->be->sync(a->buf.dev);
+    }
+}
+
+static void update_from_rep(void * arg) {
+    direction_arg_t * a = (direction_arg_t *)arg;
+    if (a->be->update_from != NULL) {
+        a->be->update_from(&a->buf);
+    } else {
+        a->be->copy_d2h(&a->buf, a->buf.size);
+        a->be->sync(a->buf.dev);
+    }
+}
+
+static void bidir_rep(void * arg) {
+    direction_arg_t * a = (direction_arg_t *)arg;
+    a->be->copy_bidir(&a->buf, &a->buf2, a->buf.size);
+}
+
+// Time every selected direction for all sizes and devices. No kernel is
+// launched, so the times are pure data movement (with allocation for to/from).
+static void measure_directions(bench_context_t * ctx, int c, void * arg) {
+    direction_data_t * dd = (direction_data_t *)arg;
+    bandwidth_data_t * data = dd->data;
+    const bench_backend_t * be = ctx->backend;
+    // second buffer for the opposite direction of bidirectional transfers
+    char * buf2 = dd->selected[BW_DIR_BIDIR] ? dd->buf2[c] : NULL;
+
+    for (int s = 0; s < data->nsizes; s++) {
+        size_t cur_size = data->array_sizes_bytes[s];
+        for (int d = 0; d < ctx->ndev; d++) {
+            if (place_buffer(ctx, data, c, d) == BW_PLACE_FAILED) {
+                // skipped cells have no repetitions
+                for (int k = 0; k < BW_DIR_N; k++) {
+                    memset(&dd->stats[k * data->nsizes + s][c][d], 0, sizeof(bench_stats_t));
+                }
+                continue;
+            }
+            be->init_device(d);
+            direction_arg_t a = { be, { d, data->per_thread_buffs[c], cur_size, NULL }, { d, buf2, cur_size, NULL } };
+            for (int k = 0; k < BW_DIR_N; k++) {
+                if (!dd->selected[k]) {
+                    continue;
+                }
+                bench_progress("running for thread=%3d, size=%7.2fMB, device=%2d and direction=%s\n",
+                               c, cur_size / 1e6, d, direction_names[k]);
+                bench_stats_t * st = &dd->stats[k * data->nsizes + s][c][d];
+                switch (k) {
+                    case BW_DIR_TO:
+                        bench_sample_phases(ctx, NULL, map_to_rep, unmap_from_rep, &a, 1, st);
+                        break;
+                    case BW_DIR_FROM:
+                        bench_sample_phases(ctx, map_to_rep, unmap_from_rep, NULL, &a, 1, st);
+                        break;
+                    case BW_DIR_UPDATE_TO:
+                    case BW_DIR_UPDATE_FROM:
+                        map_to(be, &a.buf);
+                        bench_sample(ctx, k == BW_DIR_UPDATE_TO ? update_to_rep : update_from_rep, &a, 1, st);
+                        unmap_from(be, &a.buf);
+                        break;
+                    case BW_DIR_BIDIR:
+                        map_to(be, &a.buf);
+                        map_to(be, &a.buf2);
+                        bench_sample(ctx, bidir_rep, &a, 1, st);
+                        unmap_from(be, &a.buf2);
+                        unmap_from(be, &a.buf);
+                        break;
+                }
+            }
+        }
+    }
+}
+
+// Directional mode: measure copies to and from the device separately
+// (BW_DIRECTIONS, a list of to, from, update_to, update_from and bidir, or
+// "all") one core at a time.
+static void run_directions(bench_context_t * ctx, const char * spec, bandwidth_data_t * data) {
+    int nsizes = data->nsizes;
+    direction_data_t dd;
+    dd.data = data;
+    int ndir = 0;
+    for (int k = 0; k < BW_DIR_N; k++) {
+        dd.selected[k] = strcmp(spec, "all") == 0 || list_contains(spec, direction_names[k]);
+        if (k == BW_DIR_BIDIR && dd.selected[k] && ctx->backend->copy_bidir == NULL) {
+            fprintf(stderr, "bidirectional transfers are not supported by the %s backend, skipping\n",
+                    ctx->backend->name);
+            dd.selected[k] = 0;
+        }
+    }
+
+    // The second buffers are allocated up front: with huge pages the pool
+    // may not hold them, which only drops the bidirectional transfers.
+    dd.buf2 = (char **)calloc(ctx->ncores, sizeof(char *));
+    if (dd.selected[BW_DIR_BIDIR] && ctx->ndev > 0 && data->kind != BW_MEM_ZEROCOPY) {
+        if (alloc_thread_buffers(ctx, data, dd.buf2) != 0) {
+            fprintf(stderr, "no %s pages available for the second buffers of bidirectional transfers, skipping\n",
+                    bench_page_names[data->pages]);
+            dd.selected[BW_DIR_BIDIR] = 0;
+        } else if (data->kind == BW_MEM_REGISTERED) {
+            #pragma omp parallel num_threads(ctx->ncores)
+            {
+                int cur_thread = omp_get_thread_num();
+                ctx->backend->host_register(dd.buf2[cur_thread], data->buf_size);
+            }
+        }
+    }
+    for (int k = 0; k < BW_DIR_N; k++) {
+        ndir += dd.selected[k];
+    }
+    if (ndir == 0 || ctx->ndev == 0 || data->kind == BW_MEM_ZEROCOPY) {
+        fprintf(stdout, "directional mode: nothing to measure (directions=%d, devices=%d, memory=%s)\n",
+                ndir, ctx->ndev, memory_kind_names[data->kind]);
+        free(dd.buf2);
+        return;
+    }
+
+    dd.stats = (bench_stats_t ***)malloc(BW_DIR_N * nsizes * sizeof(bench_stats_t **));
+    for (int i = 0; i < BW_DIR_N * nsizes; i++) {
+        dd.stats[i] = bench_stats_matrix_alloc(ctx->ncores, ctx->ndev);
+    }
+    bench_sweep_cores(ctx, measure_directions, &dd);
+    for (int i = 0; i < BW_DIR_N * nsizes; i++) {
+        bench_sweep_fill_rows(ctx, (void **)dd.stats[i], ctx->ndev * sizeof(bench_stats_t));
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // Bandwidth per direction: bytes moved in one direction (both for
+    // bidirectional transfers) per time.
+    double ** bw = bench_matrix_alloc(ctx->ncores, ctx->ndev);
+    double ** best = bench_matrix_alloc(BW_DIR_N * nsizes, ctx->ndev);
+    for (int k = 0; k < BW_DIR_N; k++) {
+        if (!dd.selected[k]) {
+            continue;
+        }
+        double factor = (k == BW_DIR_BIDIR) ? 2.0 : 1.0;
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Directional bandwidth: %s (MB/s)\n", direction_names[k]);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < nsizes; s++) {
+            size_t cur_size = data->array_sizes_bytes[s];
+            bench_stats_t ** st = dd.stats[k * nsizes + s];
+            for (int c = 0; c < ctx->ncores; c++) {
+                for (int d = 0; d < ctx->ndev; d++) {
+                    bw[c][d] = st[c][d].n > 0 ? factor * cur_size / 1e6 / st[c][d].mean : 0.0;
+                    if (bw[c][d] > best[k * nsizes + s][d]) {
+                        best[k * nsizes + s][d] = bw[c][d];
+                    }
+                    if (!bench_core_measured(ctx, c) || st[c][d].n == 0) {
+                        continue;
+                    }
+
+                    char variant[64];
+                    snprintf(variant, sizeof(variant), "direction=%s,%s", direction_names[k], data->variant);
+                    bench_record_t rec;
+                    bench_record_init(&rec, "direction", c, d, cur_size);
+                    rec.variant = variant;
+                    rec.stats = &st[c][d];
+                    bench_record_add(&rec, "bandwidth_mbs", bw[c][d]);
+                    bench_output_record(ctx, &rec);
+                }
+            }
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", cur_size / 1000.0);
+            bench_print_matrix(stdout, bw, ctx->ncores, ctx->ndev, 1.0);
+        }
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Directional bandwidth, best core per device (MB/s)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", data->array_sizes_bytes[s] / 1000.0);
+        for (int k = 0; k < BW_DIR_N; k++) {
+            if (dd.selected[k]) {
+                fprintf(stdout, ";%s", direction_names[k]);
+            }
+        }
+        fprintf(stdout, "\n");
+        for (int d = 0; d < ctx->ndev; d++) {
+            fprintf(stdout, "GPU %d", d);
+            for (int k = 0; k < BW_DIR_N; k++) {
+                if (dd.selected[k]) {
+                    fprintf(stdout, ";%lf", best[k * nsizes + s][d]);
+                }
+            }
+            fprintf(stdout, "\n");
+        }
+    }
+
+    bench_matrix_free(bw, ctx->ncores);
+    bench_matrix_free(best, BW_DIR_N * nsizes);
+    for (int i = 0; i < BW_DIR_N * nsizes; i++) {
+        bench_stats_matrix_free(dd.stats[i], ctx->ncores);
+    }
+    free(dd.stats);
+    if (dd.selected[BW_DIR_BIDIR]) {
+        if (data->kind == BW_MEM_REGISTERED) {
+            #pragma omp parallel num_threads(ctx->ncores)
+            {
+                int cur_thread = omp_get_thread_num();
+                ctx->backend->host_unregister(dd.buf2[cur_thread], data->buf_size);
+            }
+        }
+        free_thread_buffers(ctx, data, dd.buf2);
+    }
+    free(dd.buf2);
+}
+
+// Data layouts (BW_LAYOUTS), each moving the same number of bytes as the
+// contiguous reference
+enum bandwidth_layout {
+    BW_LAYOUT_CONTIGUOUS = 0,   // one block, like the directions to and from
+    BW_LAYOUT_STRIDED,          // rows of BW_LAYOUT_WIDTH bytes, BW_LAYOUT_STRIDE apart (2D array section)
+    BW_LAYOUT_PACKED,           // the strided rows packed into the contiguous buffer and back
+    BW_LAYOUT_PIECES,           // BW_LAYOUT_PIECES separate buffers in one construct
+    BW_LAYOUT_MAPPER,           // structs pointing to BW_LAYOUT_WIDTH bytes each, declare mapper
+    BW_LAYOUT_DEEP,             // the same structs, one data directive per struct
+    BW_LAYOUT_N
+};
+
+static const char * const layout_names[BW_LAYOUT_N] = {
+    "contiguous", "strided", "packed", "pieces", "mapper", "deep"
+};
+
+// backend layout of every non-contiguous driver layout (packed: -1)
+static const int layout_kinds[BW_LAYOUT_N] = {
+    -1, BENCH_LAYOUT_STRIDED, -1, BENCH_LAYOUT_PIECES, BENCH_LAYOUT_MAPPER, BENCH_LAYOUT_DEEP
+};
+
+typedef struct layout_arg {
+    const bench_backend_t * be;
+    int layout;
+    bench_devbuf_t buf;         // contiguous data or packing buffer
+    bench_layout_t l;
+    bench_devbuf_t * scratch;   // device buffers of the piece by piece copies
+} layout_arg_t;
+
+// Host data of the layouts: the strided rows and the separate buffers of the
+// pieces and structs, all within buf.
+typedef struct layout_host {
+    char * buf;
+    size_t size;
+    int node;                   // NUMA domain buf is placed on (BW_PLACE_FAILED: not placed)
+    bench_node_t pieces[BENCH_MAX_LAYOUT_PIECES];
+    bench_node_t * nodes;
+    bench_devbuf_t * scratch;
+} layout_host_t;
+
+typedef struct layout_data {
+    bandwidth_data_t * data;
+    layout_host_t host;
+    int selected[BW_LAYOUT_N];
+    size_t width;
+    size_t stride;
+    int npieces;
+    bench_stats_t *** stats;    // [layout * nsizes + size][core][device]
+    size_t * bytes;             // [layout * nsizes + size] bytes moved each way
+} layout_data_t;
+
+// Shape of a layout for size bytes: rows or structs of up to width bytes,
+// or npieces pieces.
+static void layout_shape(const layout_data_t * ld, int layout, size_t size, size_t * count, size_t * width) {
+    if (layout == BW_LAYOUT_PIECES) {
+        *count = ld->npieces;
+        *width = size / ld->npieces > 0 ? size / ld->npieces : 1;
+    } else if (layout == BW_LAYOUT_CONTIGUOUS) {
+        *count = 1;
+        *width = size;
+    } else {
+        *width = size < ld->width ? size : ld->width;
+        *count = size / *width;
+    }
+}
+
+// Copy a layout row by row or piece by piece through the device buffer
+// interface, as an OpenMP runtime splits it, if the backend has no
+// dedicated path. Mappers have no such equivalent.
+static int layout_copy(const bench_backend_t * be, const bench_layout_t * l, bench_devbuf_t * scratch) {
+    switch (l->kind) {
+        case BENCH_LAYOUT_STRIDED: {
+            bench_devbuf_t dst = { l->dev, l->host, l->count * l->width, NULL };
+            be->alloc(&dst);
+            for (size_t r = 0; r < l->count; r++) {
+                bench_devbuf_t row = { l->dev, l->host + r * l->stride, l->width, (char *)dst.ptr + r * l->width };
+                be->copy_h2d(&row, l->width);
+            }
+            be->sync(l->dev);
+            for (size_t r = 0; r < l->count; r++) {
+                bench_devbuf_t row = { l->dev, l->host + r * l->stride, l->width, (char *)dst.ptr + r * l->width };
+                be->copy_d2h(&row, l->width);
+            }
+            be->sync(l->dev);
+            be->free(&dst);
+            return 0;
+        }
+        case BENCH_LAYOUT_PIECES:
+        case BENCH_LAYOUT_DEEP: {
+            // deep copies include the structs, scratch[count]
+            size_t n = l->count + (l->kind == BENCH_LAYOUT_DEEP);
+            for (size_t i = 0; i < l->count; i++) {
+                bench_devbuf_t piece = { l->dev, l->nodes[i].data, l->nodes[i].len, NULL };
+                scratch[i] = piece;
+            }
+            if (l->kind == BENCH_LAYOUT_DEEP) {
+                bench_devbuf_t structs = { l->dev, (char *)l->nodes, l->count * sizeof(bench_node_t), NULL };
+                scratch[l->count] = structs;
+            }
+            for (size_t i = 0; i < n; i++) {
+                be->alloc(&scratch[i]);
+                be->copy_h2d(&scratch[i], scratch[i].size);
+            }
+            be->sync(l->dev);
+            for (size_t i = 0; i < n; i++) {
+                be->copy_d2h(&scratch[i], scratch[i].size);
+            }
+            be->sync(l->dev);
+            for (size_t i = 0; i < n; i++) {
+                be->free(&scratch[i]);
+            }
+            return 0;
+        }
+        default:
+            return -1;
+    }
+}
+
+static int layout_map(const bench_backend_t * be, const bench_layout_t * l, bench_devbuf_t * scratch) {
+    if (be->map_layout != NULL && be->map_layout(l) == 0) {
+        return 0;
+    }
+    return layout_copy(be, l, scratch);
+}
+
+static void layout_rep(void * arg) {
+    layout_arg_t * a = (layout_arg_t *)arg;
+    switch (a->layout) {
+        case BW_LAYOUT_CONTIGUOUS:
+            map_to(a->be, &a->buf);
+            unmap_from(a->be, &a->buf);
+            break;
+        case BW_LAYOUT_PACKED:
+            for (size_t r = 0; r < a->l.count; r++) {
+                memcpy(a->buf.host + r * a->l.width, a->l.host + r * a->l.stride, a->l.width);
+            }
+            map_to(a->be, &a->buf);
+            unmap_from(a->be, &a->buf);
+            for (size_t r = 0; r < a->l.count; r++) {
+                memcpy(a->l.host + r * a->l.stride, a->buf.host + r * a->l.width, a->l.width);
+            }
+            break;
+        default:
+            layout_map(a->be, &a->l, a->scratch);
+            break;
+    }
+}
+
+// Allocate the host data of the layouts once per run, sized for the largest
+// transfer and backed by the pages of the reference buffer: one buffer holds
+// the strided rows, the pieces and the data of the structs, which the
+// layouts measured one after another may share. Returns -1 if no such pages
+// are available.
+static int layout_host_alloc(const layout_data_t * ld, layout_host_t * h) {
+    const bandwidth_data_t * data = ld->data;
+    size_t count, width;
+    layout_shape(ld, BW_LAYOUT_STRIDED, data->buf_size, &count, &width);
+    h->size = count * ld->stride > data->buf_size ? count * ld->stride : data->buf_size;
+    h->buf = bench_buffer_alloc_pages(h->size, data->pages);
+    if (h->buf == NULL) {
+        return -1;
+    }
+    memset(h->buf, 0, h->size);
+    h->node = BW_PLACE_FAILED;
+    layout_shape(ld, BW_LAYOUT_PIECES, data->buf_size, &count, &width);
+    for (int i = 0; i < ld->npieces; i++) {
+        h->pieces[i].len = width;
+        h->pieces[i].data = h->buf + i * (h->size / ld->npieces);
+    }
+    layout_shape(ld, BW_LAYOUT_MAPPER, data->buf_size, &count, &width);
+    h->nodes = (bench_node_t *)malloc(count * sizeof(bench_node_t));
+    for (size_t i = 0; i < count; i++) {
+        h->nodes[i].len = width;
+        h->nodes[i].data = h->buf + i * ld->stride;
+    }
+    size_t nscratch = count > (size_t)ld->npieces ? count : (size_t)ld->npieces;
+    h->scratch = (bench_devbuf_t *)malloc((nscratch + 1) * sizeof(bench_devbuf_t));
+    return 0;
+}
+
+static void layout_host_free(const layout_data_t * ld, layout_host_t * h) {
+    bench_buffer_free_pages(h->buf, h->size, ld->data->pages);
+    free(h->nodes);
+    free(h->scratch);
+}
+
+// Move the layout data to the NUMA domain of the reference buffer of core
+// for dev. Returns BW_PLACE_FAILED if it cannot be moved.
+static int place_layout_host(bench_context_t * ctx, layout_data_t * ld, int c, int d) {
+    bandwidth_data_t * data = ld->data;
+    layout_host_t * h = &ld->host;
+    int node;
+    if (data->placement.mode == BENCH_PLACE_LOCAL) {
+        // the reference buffer is first-touched by the measuring core
+        if (bench_numa_num_nodes() < 2) {
+            return 0;
+        }
+        node = ctx->core_numa[c];
+    } else {
+        node = bench_placement_node(ctx, &data->placement, c, d);
+    }
+    if (node != h->node) {
+        if (bench_buffer_place(h->buf, h->size, data->pages, node) != 0) {
+            fprintf(stderr, "could not place layout data of thread %d on NUMA domain %d, skipping device %d\n",
+                    c, node, d);
+            h->node = BW_PLACE_FAILED;
+            return BW_PLACE_FAILED;
+        }
+        h->node = node;
+    }
+    return 0;
+}
+
+// Time every selected layout for all sizes and devices.
+static void measure_layouts(bench_context_t * ctx, int c, void * arg) {
+    layout_data_t * ld = (layout_data_t *)arg;
+    bandwidth_data_t * data = ld->data;
+    layout_host_t * h = &ld->host;
+
+    for (int s = 0; s < data->nsizes; s++) {
+        size_t cur_size = data->array_sizes_bytes[s];
+        for (int d = 0; d < ctx->ndev; d++) {
+            if (place_buffer(ctx, data, c, d) == BW_PLACE_FAILED
+                || place_layout_host(ctx, ld, c, d) == BW_PLACE_FAILED) {
+                // skipped cells have no repetitions
+                for (int k = 0; k < BW_LAYOUT_N; k++) {
+                    memset(&ld->stats[k * data->nsizes + s][c][d], 0, sizeof(bench_stats_t));
+                }
+                continue;
+            }
+            ctx->backend->init_device(d);
+            for (int k = 0; k < BW_LAYOUT_N; k++) {
+                if (!ld->selected[k]) {
+                    continue;
+                }
+                layout_arg_t a;
+                a.be = ctx->backend;
+                a.layout = k;
+                a.scratch = h->scratch;
+                a.l.kind = layout_kinds[k];
+                a.l.dev = d;
+                a.l.stride = ld->stride;
+                a.l.host = h->buf;
+                a.l.nodes = (k == BW_LAYOUT_PIECES) ? h->pieces : h->nodes;
+                layout_shape(ld, k == BW_LAYOUT_PACKED ? BW_LAYOUT_STRIDED : k, cur_size, &a.l.count, &a.l.width);
+                if (k == BW_LAYOUT_PIECES || k == BW_LAYOUT_MAPPER || k == BW_LAYOUT_DEEP) {
+                    for (size_t i = 0; i < a.l.count; i++) {
+                        a.l.nodes[i].len = a.l.width;
+                    }
+                }
+                bench_devbuf_t buf = { d, data->per_thread_buffs[c], a.l.count * a.l.width, NULL };
+                a.buf = buf;
+                ld->bytes[k * data->nsizes + s] = a.l.count * a.l.width;
+
+                bench_progress("running for thread=%3d, size=%7.2fMB, device=%2d and layout=%s\n",
+                               c, cur_size / 1e6, d, layout_names[k]);
+                bench_sample(ctx, layout_rep, &a, 1, &ld->stats[k * data->nsizes + s][c][d]);
+            }
+        }
+    }
+}
+
+// Whether the backend can map a layout at all: only mappers may be missing.
+static int layout_supported(bench_context_t * ctx, int layout) {
+    if (layout != BW_LAYOUT_MAPPER) {
+        return 1;
+    }
+    const bench_backend_t * be = ctx->backend;
+    char byte = 0;
+    bench_node_t node = { 1, &byte };
+    bench_layout_t l = { BENCH_LAYOUT_MAPPER, 0, 1, 1, 1, NULL, &node };
+    be->init_device(0);
+    return be->map_layout != NULL && be->map_layout(&l) == 0;
+}
+
+// Layout mode: map strided array sections, separate buffers and structs
+// with pointers (BW_LAYOUTS, a list of strided, packed, pieces, mapper and
+// deep, or "all") and compare them to contiguous transfers of the same
+// number of bytes, one core at a time.
+static void run_layouts(bench_context_t * ctx, const char * spec, bandwidth_data_t * data) {
+    int nsizes = data->nsizes;
+    layout_data_t ld;
+    ld.data = data;
+    const char * width_env = getenv("BW_LAYOUT_WIDTH");
+    const char * stride_env = getenv("BW_LAYOUT_STRIDE");
+    const char * pieces_env = getenv("BW_LAYOUT_PIECES");
+    ld.width = width_env ? bench_parse_size(width_env, NULL) : 4096;
+    ld.width = ld.width > 0 ? ld.width : 1;
+    ld.stride = stride_env ? bench_parse_size(stride_env, NULL) : 2 * ld.width;
+    ld.stride = ld.stride > ld.width ? ld.stride : ld.width;
+    // the OpenMP backend spells out the map clauses for powers of two
+    int npieces = pieces_env ? atoi(pieces_env) : 8;
+    ld.npieces = 1;
+    while (ld.npieces * 2 <= npieces && ld.npieces * 2 <= BENCH_MAX_LAYOUT_PIECES) {
+        ld.npieces *= 2;
+    }
+    if (ctx->ndev == 0 || data->kind != BW_MEM_PAGEABLE) {
+        fprintf(stdout, "layout mode: nothing to measure (devices=%d, memory=%s)\n",
+                ctx->ndev, memory_kind_names[data->kind]);
+        return;
+    }
+
+    // the contiguous transfers are the reference
+    for (int k = 0; k < BW_LAYOUT_N; k++) {
+        ld.selected[k] = k == BW_LAYOUT_CONTIGUOUS || strcmp(spec, "all") == 0 || list_contains(spec, layout_names[k]);
+        if (ld.selected[k] && !layout_supported(ctx, k)) {
+            fprintf(stderr, "layout '%s' is not supported by the %s backend, skipping\n",
+                    layout_names[k], ctx->backend->name);
+            ld.selected[k] = 0;
+        }
+    }
+    if (layout_host_alloc(&ld, &ld.host) != 0) {
+        fprintf(stderr, "no %s pages available for the layout data, skipping\n", bench_page_names[data->pages]);
+        return;
+    }
+    fprintf(stdout, "layout width: %zu, stride: %zu, pieces: %d\n", ld.width, ld.stride, ld.npieces);
+
+    ld.stats = (bench_stats_t ***)malloc(BW_LAYOUT_N * nsizes * sizeof(bench_stats_t **));
+    ld.bytes = (size_t *)calloc(BW_LAYOUT_N * nsizes, sizeof(size_t));
+    for (int i = 0; i < BW_LAYOUT_N * nsizes; i++) {
+        ld.stats[i] = bench_stats_matrix_alloc(ctx->ncores, ctx->ndev);
+    }
+    bench_sweep_cores(ctx, measure_layouts, &ld);
+    layout_host_free(&ld, &ld.host);
+    for (int i = 0; i < BW_LAYOUT_N * nsizes; i++) {
+        bench_sweep_fill_rows(ctx, (void **)ld.stats[i], ctx->ndev * sizeof(bench_stats_t));
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // Effective bandwidth: bytes moved each way per round trip time, like
+    // the round trips of the default mode.
+    double ** bw = bench_matrix_alloc(ctx->ncores, ctx->ndev);
+    double ** best = bench_matrix_alloc(BW_LAYOUT_N * nsizes, ctx->ndev);
+    for (int k = 0; k < BW_LAYOUT_N; k++) {
+        if (!ld.selected[k]) {
+            continue;
+        }
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Layout bandwidth: %s (MB/s)\n", layout_names[k]);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < nsizes; s++) {
+            size_t cur_size = data->array_sizes_bytes[s];
+            size_t bytes = ld.bytes[k * nsizes + s];
+            bench_stats_t ** st = ld.stats[k * nsizes + s];
+            bench_stats_t ** ref = ld.stats[BW_LAYOUT_CONTIGUOUS * nsizes + s];
+            for (int c = 0; c < ctx->ncores; c++) {
+                for (int d = 0; d < ctx->ndev; d++) {
+                    bw[c][d] = st[c][d].n > 0 ? 2.0 * bytes / 1e6 / st[c][d].mean : 0.0;
+                    if (bw[c][d] > best[k * nsizes + s][d]) {
+                        best[k * nsizes + s][d] = bw[c][d];
+                    }
+                    if (!bench_core_measured(ctx, c) || st[c][d].n == 0) {
+                        continue;
+                    }
+
+                    char variant[96];
+                    snprintf(variant, sizeof(variant), "layout=%s,width=%zu,%s", layout_names[k],
+                             k == BW_LAYOUT_PIECES ? bytes / ld.npieces : (k == BW_LAYOUT_CONTIGUOUS ? bytes : ld.width),
+                             data->variant);
+                    bench_record_t rec;
+                    bench_record_init(&rec, "layout", c, d, cur_size);
+                    rec.variant = variant;
+                    rec.stats = &st[c][d];
+                    bench_record_add(&rec, "bandwidth_mbs", bw[c][d]);
+                    bench_record_add(&rec, "relative", ref[c][d].mean / st[c][d].mean * bytes / cur_size);
+                    bench_output_record(ctx, &rec);
+                }
+            }
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", cur_size / 1000.0);
+            bench_print_matrix(stdout, bw, ctx->ncores, ctx->ndev, 1.0);
+        }
+    }
+
+    // Below 1 the layout is slower than one contiguous transfer, and packing
+    // pays off if the packed layout comes closer to 1.
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Layout bandwidth relative to contiguous, best core per device\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", data->array_sizes_bytes[s] / 1000.0);
+        for (int k = 0; k < BW_LAYOUT_N; k++) {
+            if (ld.selected[k]) {
+                fprintf(stdout, ";%s", layout_names[k]);
+            }
+        }
+        fprintf(stdout, "\n");
+        for (int d = 0; d < ctx->ndev; d++) {
+            fprintf(stdout, "GPU %d", d);
+            double ref = best[BW_LAYOUT_CONTIGUOUS * nsizes + s][d];
+            for (int k = 0; k < BW_LAYOUT_N; k++) {
+                if (ld.selected[k]) {
+                    fprintf(stdout, ";%lf", ref > 0.0 ? best[k * nsizes + s][d] / ref : 0.0);
+                }
+            }
+            fprintf(stdout, "\n");
+        }
+    }
+
+    bench_matrix_free(bw, ctx->ncores);
+    bench_matrix_free(best, BW_LAYOUT_N * nsizes);
+    for (int i = 0; i < BW_LAYOUT_N * nsizes; i++) {
+        bench_stats_matrix_free(ld.stats[i], ctx->ncores);
+    }
+    free(ld.stats);
+    free(ld.bytes);
+}
+
+// Print the host counters per round trip (BENCH_COUNTERS), one matrix per
+// counter and size. Cores that stand out in the bandwidth matrix with many
+// page faults or remote accesses are limited by the host, not the link.
+static void print_counters(bench_context_t * ctx, bandwidth_data_t * data) {
+    double ** m = bench_matrix_alloc(ctx->ncores, ctx->ndev);
+    for (int k = 0; k < BENCH_NCOUNTERS; k++) {
+        if (!(ctx->counters & (1u << k))) {
+            continue;
+        }
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Host counter %s per round trip\n", bench_counter_names[k]);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < data->nsizes; s++) {
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", data->array_sizes_bytes[s] / 1000.0);
+            bench_stats_extract(data->stats[s], ctx->ncores, ctx->ndev,
+                                offsetof(bench_stats_t, counters) + k * sizeof(double), 1.0, m);
+            bench_print_matrix(stdout, m, ctx->ncores, ctx->ndev, 1.0);
+        }
+    }
+    bench_matrix_free(m, ctx->ncores);
+}
+
+// Write the records and print the tables of a one-core-at-a-time sweep.
+static void report_sweep(bench_context_t * ctx, bandwidth_data_t * data, const double * ones, const char * placement_str) {
+    int nsizes = data->nsizes;
+    const size_t * array_sizes_bytes = data->array_sizes_bytes;
+    double * min_bandwidth = (double *)calloc(nsizes, sizeof(double));
+
+    for (int s = 0; s < nsizes; s++) {
+        // minimum over the measured cells, skipped cells hold no bandwidth
+        min_bandwidth[s] = DBL_MAX;
+        for (int c = 0; c < ctx->ncores; c++) {
+            for (int d = 0; d < ctx->ndev && bench_core_measured(ctx, c); d++) {
+                if (data->stats[s][c][d].n == 0) {
+                    continue;
+                }
+                if (data->bandwidth[s][c][d] < min_bandwidth[s]) {
+                    min_bandwidth[s] = data->bandwidth[s][c][d];
+                }
+                bench_record_t rec;
+                bench_record_init(&rec, "sweep", c, d, array_sizes_bytes[s]);
+                rec.variant = data->variant;
+                rec.stats = &data->stats[s][c][d];
+                bench_record_add(&rec, "bandwidth_mbs", data->bandwidth[s][c][d]);
+                bench_record_add(&rec, "buffer_numa", data->buffer_numa[c][d]);
+                bench_output_record(ctx, &rec);
+            }
+        }
+        if (min_bandwidth[s] == DBL_MAX || min_bandwidth[s] <= 0.0) {
+            min_bandwidth[s] = 1.0;
+        }
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Absolute times (sec)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", array_sizes_bytes[s] / 1000.0);
+        bench_print_matrix(stdout, data->times_abs[s], ctx->ncores, ctx->ndev, 1.0);
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Absolute measurements (MB/s)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", array_sizes_bytes[s] / 1000.0);
+        bench_print_matrix(stdout, data->bandwidth[s], ctx->ncores, ctx->ndev, 1.0);
+    }
+    fprintf(stdout, "\n\n");
+    print_per_core(ctx, data, ones);
+
+    if (data->placement.mode != BENCH_PLACE_LOCAL) {
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "NUMA domain of the host buffer (placement %s, -1 = interleaved)\n", placement_str);
+        fprintf(stdout, BENCH_SEPARATOR);
+        bench_print_matrix(stdout, data->buffer_numa, ctx->ncores, ctx->ndev, 1.0);
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Relative measurements to minimum bandwidth for size\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", array_sizes_bytes[s] / 1000.0);
+        bench_print_matrix(stdout, data->bandwidth[s], ctx->ncores, ctx->ndev, min_bandwidth[s]);
+    }
+    fprintf(stdout, "\n\n");
+    print_per_core(ctx, data, min_bandwidth);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Round trip time statistics per repetition (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", array_sizes_bytes[s] / 1000.0);
+        bench_print_stats(stdout, "Round trip time", "us", data->stats[s], ctx->ncores, ctx->ndev, 1e6);
+    }
+    if (ctx->counters != 0) {
+        print_counters(ctx, data);
+    }
+
+    if (nsizes >= 2) {
+        print_model_fit(ctx, data);
+    }
+    free(min_bandwidth);
+}
+
+// Print the registration overhead per core and size and the number of
+// transfers after which registering pays off compared to pageable memory,
+// based on the round trip times averaged over all cores.
+static void print_registration(bench_context_t * ctx, bandwidth_data_t * data,
+                               double ** mean_pageable, double ** mean_registered) {
+    int nsizes = data->nsizes;
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Registration overhead: register + unregister (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, ";");
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "%.2f KB%c", data->array_sizes_bytes[s] / 1000.0, s<nsizes-1 ? ';' : '\n');
+    }
+    for (int c = 0; c < ctx->ncores; c++) {
+        fprintf(stdout, "Core %d;", c);
+        for (int s = 0; s < nsizes; s++) {
+            fprintf(stdout, "%lf%c", data->reg_stats[s][c].mean * 1e6, s<nsizes-1 ? ';' : '\n');
+            if (!bench_core_measured(ctx, c)) {
+                continue;
+            }
+
+            bench_record_t rec;
+            bench_record_init(&rec, "registration", c, -1, data->array_sizes_bytes[s]);
+            rec.stats = &data->reg_stats[s][c];
+            bench_output_record(ctx, &rec);
+        }
+    }
+
+    if (mean_pageable == NULL) {
+        return;
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Registration break-even: transfers until registering pays off (-1 = never)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, ";");
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "%.2f KB%c", data->array_sizes_bytes[s] / 1000.0, s<nsizes-1 ? ';' : '\n');
+    }
+    for (int d = 0; d < ctx->ndev; d++) {
+        fprintf(stdout, "GPU %d;", d);
+        for (int s = 0; s < nsizes; s++) {
+            double overhead = 0.0;
+            for (int c = 0; c < ctx->ncores; c++) {
+                overhead += data->reg_stats[s][c].mean / ctx->ncores;
+            }
+            double gain = mean_pageable[s][d] - mean_registered[s][d];
+            double n = gain > 0.0 ? overhead / gain : -1.0;
+            fprintf(stdout, "%lf%c", n, s<nsizes-1 ? ';' : '\n');
+        }
+    }
+}
+
+// Print the device allocation cost per size and, if the round trips include
+// the allocation, its share of the round trip time averaged over all cores.
+static void print_alloc_cost(bench_context_t * ctx, bandwidth_data_t * data, double ** mean_roundtrip) {
+    int nsizes = data->nsizes;
+    for (int s = 0; s < nsizes; s++) {
+        for (int c = 0; c < ctx->ncores; c++) {
+            for (int d = 0; d < ctx->ndev && bench_core_measured(ctx, c); d++) {
+                bench_record_t rec;
+                bench_record_init(&rec, "allocation", c, d, data->array_sizes_bytes[s]);
+                rec.stats = &data->alloc_stats[s][c][d];
+                bench_output_record(ctx, &rec);
+            }
+        }
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Device allocation: alloc + free (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "##### Problem Size: %.2f KB\n", data->array_sizes_bytes[s] / 1000.0);
+        bench_print_stats(stdout, "Allocation time", "us", data->alloc_stats[s], ctx->ncores, ctx->ndev, 1e6);
+    }
+
+    if (mean_roundtrip == NULL) {
+        return;
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Allocation share of the round trip time (%%)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, ";");
+    for (int s = 0; s < nsizes; s++) {
+        fprintf(stdout, "%.2f KB%c", data->array_sizes_bytes[s] / 1000.0, s<nsizes-1 ? ';' : '\n');
+    }
+    for (int d = 0; d < ctx->ndev; d++) {
+        fprintf(stdout, "GPU %d;", d);
+        for (int s = 0; s < nsizes; s++) {
+            double alloc = 0.0;
+            for (int c = 0; c < ctx->ncores; c++) {
+                alloc += data->alloc_stats[s][c][d].mean / ctx->ncores;
+            }
+            fprintf(stdout, "%lf%c", 100.0 * alloc / mean_roundtrip[s][d], s<nsizes-1 ? ';' : '\n');
+        }
+    }
+}
+
+// Compare the page sizes of the pageable and registered buffers (BW_PAGES):
+// round trip time averaged over all cores per kind, its ratio to the first
+// measured page size and the registration time. Page sizes without buffers
+// are left out.
+static void print_pages(bench_context_t * ctx, bandwidth_data_t * data, const int * pages, int npages,
+                        const int * page_ok, const int * kinds, int nkinds, double *** mean_time,
+                        double ** mean_reg) {
+    int nsizes = data->nsizes;
+    int first = -1, last = 0;
+    for (int p = 0; p < npages; p++) {
+        if (page_ok[p]) {
+            first = first < 0 ? p : first;
+            last = p;
+        }
+    }
+    if (first < 0) {
+        return;
+    }
+    for (int k = 0; k < nkinds; k++) {
+        if (kind_is_pinned(kinds[k])) {
+            continue;
+        }
+        for (int rel = 0; rel < 2; rel++) {
+            fprintf(stdout, BENCH_SEPARATOR);
+            if (rel) {
+                fprintf(stdout, "Round trip time by page size relative to %s pages (%s memory)\n",
+                        bench_page_names[pages[first]], memory_kind_names[kinds[k]]);
+            } else {
+                fprintf(stdout, "Round trip time by page size, mean over cores (%s memory, us)\n",
+                        memory_kind_names[kinds[k]]);
+            }
+            fprintf(stdout, BENCH_SEPARATOR);
+            for (int s = 0; s < nsizes; s++) {
+                fprintf(stdout, "##### Problem Size: %.2f KB\n", data->array_sizes_bytes[s] / 1000.0);
+                fprintf(stdout, ";");
+                for (int p = 0; p < npages; p++) {
+                    if (page_ok[p]) {
+                        fprintf(stdout, "%s%c", bench_page_names[pages[p]], p<last ? ';' : '\n');
+                    }
+                }
+                for (int d = 0; d < ctx->ndev; d++) {
+                    fprintf(stdout, "GPU %d;", d);
+                    double base = mean_time[first * BW_MEM_NKINDS + kinds[k]][s][d];
+                    for (int p = 0; p < npages; p++) {
+                        if (!page_ok[p]) {
+                            continue;
+                        }
+                        double t = mean_time[p * BW_MEM_NKINDS + kinds[k]][s][d];
+                        fprintf(stdout, "%lf%c", rel ? (base > 0.0 ? t / base : 0.0) : t * 1e6, p<last ? ';' : '\n');
+                    }
+                }
+            }
+        }
+        if (kinds[k] != BW_MEM_REGISTERED) {
+            continue;
+        }
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Registration time by page size, mean over cores (us)\n");
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, ";");
+        for (int p = 0; p < npages; p++) {
+            if (page_ok[p]) {
+                fprintf(stdout, "%s%c", bench_page_names[pages[p]], p<last ? ';' : '\n');
+            }
+        }
+        for (int s = 0; s < nsizes; s++) {
+            fprintf(stdout, "%.2f KB;", data->array_sizes_bytes[s] / 1000.0);
+            for (int p = 0; p < npages; p++) {
+                if (page_ok[p]) {
+                    fprintf(stdout, "%lf%c", mean_reg[p][s] * 1e6, p<last ? ';' : '\n');
+                }
+            }
+        }
+    }
+}
+
+static int run(void) {
+    bench_context_t ctx;
+    bandwidth_data_t data;
+
+    size_t * array_sizes_bytes = NULL;
+    const int nsizes = setup_sizes(&array_sizes_bytes);
+    size_t MAX_BUF_SIZE = 1;
+    for (int s = 0; s < nsizes; s++) {
+        if (array_sizes_bytes[s] > MAX_BUF_SIZE) {
+            MAX_BUF_SIZE = array_sizes_bytes[s];
+        }
+    }
+
+    if (bench_placement_parse(getenv("BW_PLACEMENT"), &data.placement) != 0) {
+        return EXIT_FAILURE;
+    }
+    char placement_str[32];
+    bench_placement_format(&data.placement, placement_str, sizeof(placement_str));
+
+    // Page sizes of the pageable and registered buffers (BW_PAGES, default:
+    // whatever the system uses, recorded without a pages= variant).
+    const char * pages_env = getenv("BW_PAGES");
+    int pages[BENCH_PAGES_N] = { BENCH_PAGES_DEFAULT };
+    int npages = 1;
+    if (pages_env != NULL && pages_env[0] != '\0') {
+        npages = bench_page_parse(pages_env, pages);
+        if (npages < 0) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        pages_env = NULL;
+    }
+
+    bench_init(&ctx, "bandwidth", REPS);
+    int kinds[BW_MEM_NKINDS];
+    int nkinds = setup_memory_kinds(&ctx, kinds);
+    fprintf(stdout, "number of array sizes: %d\n", nsizes);
+    // The compile-time INCLUDE_ALLOC is the default of BW_INCLUDE_ALLOC.
+    const char * include_env = getenv("BW_INCLUDE_ALLOC");
+    data.include_alloc = include_env != NULL ? atoi(include_env) != 0 : INCLUDE_ALLOC;
+    fprintf(stdout, "include allocation: %d\n", data.include_alloc);
+    const char * alloc_env = getenv("BW_ALLOC_COST");
+    int alloc_cost = (alloc_env != NULL && atoi(alloc_env) != 0);
+    fprintf(stdout, "measure allocation cost: %d\n", alloc_cost);
+    fprintf(stdout, "host buffer placement: %s\n", placement_str);
+    if (data.placement.mode == BENCH_PLACE_DEVICE) {
+        for (int d = 0; d < ctx.ndev; d++) {
+            fprintf(stdout, "device %d NUMA domain: %d\n", d, bench_device_numa(&ctx, d));
+        }
+    }
+    fprintf(stdout, "host memory:");
+    for (int k = 0; k < nkinds; k++) {
+        fprintf(stdout, " %s", memory_kind_names[kinds[k]]);
+    }
+    fprintf(stdout, "\n");
+    if (pages_env != NULL) {
+        fprintf(stdout, "host pages:");
+        for (int p = 0; p < npages; p++) {
+            fprintf(stdout, " %s", bench_page_names[pages[p]]);
+        }
+        fprintf(stdout, "\n");
+        bench_page_print_info(stdout);
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // Allocate the memory to store the result data.
+    data.nsizes = nsizes;
+    data.array_sizes_bytes = array_sizes_bytes;
+    data.times_abs = (double ***)malloc(nsizes * sizeof(double **));
+    data.bandwidth = (double ***)malloc(nsizes * sizeof(double **));
+    data.stats = (bench_stats_t ***)malloc(nsizes * sizeof(bench_stats_t **));
+    data.reg_stats = bench_stats_matrix_alloc(nsizes, ctx.ncores);
+    data.alloc_stats = (bench_stats_t ***)malloc(nsizes * sizeof(bench_stats_t **));
+    double * ones = (double *)malloc(nsizes * sizeof(double));
+    for (int s = 0; s < nsizes; s++) {
+        data.times_abs[s] = bench_matrix_alloc(ctx.ncores, ctx.ndev);
+        data.bandwidth[s] = bench_matrix_alloc(ctx.ncores, ctx.ndev);
+        data.stats[s] = bench_stats_matrix_alloc(ctx.ncores, ctx.ndev);
+        data.alloc_stats[s] = bench_stats_matrix_alloc(ctx.ncores, ctx.ndev);
+        ones[s] = 1.0;
+    }
+    // Per page size and kind ([p * BW_MEM_NKINDS + kind]): best bandwidth
+    // over all cores and round trip time averaged over all cores, both
+    // indexed by [size][device]. Registration time averaged over all cores
+    // per page size and [size].
+    double *** best = (double ***)malloc(npages * BW_MEM_NKINDS * sizeof(double **));
+    double *** mean_time = (double ***)malloc(npages * BW_MEM_NKINDS * sizeof(double **));
+    for (int k = 0; k < npages * BW_MEM_NKINDS; k++) {
+        best[k] = bench_matrix_alloc(nsizes, ctx.ndev);
+        mean_time[k] = bench_matrix_alloc(nsizes, ctx.ndev);
+    }
+    double ** mean_reg = bench_matrix_alloc(npages, nsizes);
+    int page_ok[BENCH_PAGES_N];
+
+    bench_print_affinity(&ctx);
+
+    // Per thread buffers are allocated for every memory kind
+    data.per_thread_buffs = (char **)malloc(ctx.ncores * sizeof(char *));
+    data.buf_size = MAX_BUF_SIZE;
+    data.buf_node = (int *)malloc(ctx.ncores * sizeof(int));
+    data.buffer_numa = bench_matrix_alloc(ctx.ncores, ctx.ndev);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_warmup(&ctx);
+
+    // Perform the actual measurements.
+    const char * contention_cores = getenv("BW_CONTENTION_CORES");
+    const char * pipeline_chunks = getenv("BW_PIPELINE_CHUNKS");
+    const char * directions = getenv("BW_DIRECTIONS");
+    const char * layouts = getenv("BW_LAYOUTS");
+    if (pipeline_chunks != NULL && ctx.backend->pipeline == NULL) {
+        fprintf(stderr, "pipeline mode is not supported by the %s backend\n", ctx.backend->name);
+        pipeline_chunks = NULL;
+    }
+    // only the one-core-at-a-time sweep fills the per core result matrices
+    int sweep = (contention_cores == NULL && pipeline_chunks == NULL && directions == NULL && layouts == NULL);
+    if (alloc_cost) {
+        fprintf(stdout, "allocation...\n");
+        bench_sweep_cores(&ctx, measure_alloc, &data);
+        for (int s = 0; s < nsizes; s++) {
+            bench_sweep_fill_rows(&ctx, (void **)data.alloc_stats[s], ctx.ndev * sizeof(bench_stats_t));
+        }
+    }
+    for (int p = 0; p < npages; p++) {
+        data.pages = pages[p];
+        page_ok[p] = 0;
+        double *** page_best = best + p * BW_MEM_NKINDS;
+        double *** page_time = mean_time + p * BW_MEM_NKINDS;
+        for (int k = 0; k < nkinds; k++) {
+            data.kind = kinds[k];
+            // runtime allocated kinds do not depend on the page size
+            if (p > 0 && kind_is_pinned(data.kind)) {
+                continue;
+            }
+            if (pages_env != NULL) {
+                snprintf(data.variant, sizeof(data.variant), "memory=%s,pages=%s",
+                         memory_kind_names[data.kind], bench_page_names[data.pages]);
+            } else {
+                snprintf(data.variant, sizeof(data.variant), "memory=%s", memory_kind_names[data.kind]);
+            }
+            if (alloc_buffers(&ctx, &data) != 0) {
+                fprintf(stderr, "no %s pages available for %zu byte buffers, skipping\n",
+                        bench_page_names[data.pages], data.buf_size);
+                continue;
+            }
+            page_ok[p] |= !kind_is_pinned(data.kind);
+
+            if (nkinds > 1 || npages > 1) {
+                fprintf(stdout, BENCH_SEPARATOR);
+                if (npages > 1) {
+                    fprintf(stdout, "##### Host memory: %s, pages: %s\n", memory_kind_names[data.kind],
+                            kind_is_pinned(data.kind) ? "runtime" : bench_page_names[data.pages]);
+                } else {
+                    fprintf(stdout, "##### Host memory: %s\n", memory_kind_names[data.kind]);
+                }
+            }
+            if (pages_env != NULL && !kind_is_pinned(data.kind)) {
+                fprintf(stdout, "huge page backed: %.1f%%\n",
+                        100.0 * bench_buffer_huge_bytes(data.per_thread_buffs[0]) / data.buf_size);
+            }
+            if (data.kind == BW_MEM_REGISTERED) {
+                fprintf(stdout, "registration...\n");
+                bench_sweep_cores(&ctx, measure_registration, &data);
+                for (int s = 0; s < nsizes; s++) {
+                    bench_sweep_fill(&ctx, data.reg_stats[s], sizeof(bench_stats_t));
+                    for (int c = 0; c < ctx.ncores; c++) {
+                        mean_reg[p][s] += data.reg_stats[s][c].mean / ctx.ncores;
+                    }
+                }
+                #pragma omp parallel num_threads(ctx.ncores)
+                {
+                    int cur_thread = omp_get_thread_num();
+                    ctx.backend->host_register(data.per_thread_buffs[cur_thread], data.buf_size);
+                }
+            }
+
+            fprintf(stdout, "measurements...\n");
+            if (pipeline_chunks != NULL) {
+                run_pipeline(&ctx, pipeline_chunks, &data);
+            } else if (directions != NULL) {
+                run_directions(&ctx, directions, &data);
+            } else if (layouts != NULL) {
+                run_layouts(&ctx, layouts, &data);
+            } else if (contention_cores != NULL) {
+                run_contention(&ctx, contention_cores, &data);
+            } else {
+                bench_sweep_cores(&ctx, measure_core, &data);
+                for (int s = 0; s < nsizes; s++) {
+                    bench_sweep_fill_rows(&ctx, (void **)data.times_abs[s], ctx.ndev * sizeof(double));
+                    bench_sweep_fill_rows(&ctx, (void **)data.bandwidth[s], ctx.ndev * sizeof(double));
+                    bench_sweep_fill_rows(&ctx, (void **)data.stats[s], ctx.ndev * sizeof(bench_stats_t));
+                }
+                bench_sweep_fill_rows(&ctx, (void **)data.buffer_numa, ctx.ndev * sizeof(double));
+                fprintf(stdout, BENCH_SEPARATOR);
+                report_sweep(&ctx, &data, ones, placement_str);
+
+                for (int s = 0; s < nsizes; s++) {
+                    for (int d = 0; d < ctx.ndev; d++) {
+                        page_best[data.kind][s][d] = 0.0;
+                        page_time[data.kind][s][d] = 0.0;
+                        int measured = 0;
+                        for (int c = 0; c < ctx.ncores; c++) {
+                            if (data.bandwidth[s][c][d] > page_best[data.kind][s][d]) {
+                                page_best[data.kind][s][d] = data.bandwidth[s][c][d];
+                            }
+                            if (data.stats[s][c][d].n > 0) {
+                                page_time[data.kind][s][d] += data.stats[s][c][d].mean;
+                                measured++;
+                            }
+                        }
+                        page_time[data.kind][s][d] /= measured > 0 ? measured : 1;
+                    }
+                }
+
+                // The affinity is derived from the largest transfer size of the first kind.
+                if (k == 0 && p == 0) {
+                    int largest = 0;
+                    for (int s = 1; s < nsizes; s++) {
+                        if (array_sizes_bytes[s] > array_sizes_bytes[largest]) {
+                            largest = s;
+                        }
+                    }
+                    bench_sweep_check(&ctx, data.bandwidth[largest], "bandwidth of the largest size");
+                    bench_print_by_distance(&ctx, data.bandwidth[largest], "Bandwidth of the largest size (MB/s)");
+                    bench_affinity_report(&ctx, data.bandwidth[largest], 1);
+                }
+            }
+
+            if (data.kind == BW_MEM_REGISTERED) {
+                #pragma omp parallel num_threads(ctx.ncores)
+                {
+                    int cur_thread = omp_get_thread_num();
+                    ctx.backend->host_unregister(data.per_thread_buffs[cur_thread], data.buf_size);
+                }
+                int have_pageable = (kinds[0] == BW_MEM_PAGEABLE && sweep);
+                print_registration(&ctx, &data, have_pageable ? page_time[BW_MEM_PAGEABLE] : NULL,
+                                   page_time[BW_MEM_REGISTERED]);
+            }
+            free_buffers(&ctx, &data);
+        }
+    }
+
+    if (alloc_cost) {
+        // the share is relative to the first kind unless zero-copy, which
+        // allocates no device memory
+        int with_roundtrip = (data.include_alloc && sweep && kinds[0] != BW_MEM_ZEROCOPY);
+        print_alloc_cost(&ctx, &data, with_roundtrip ? mean_time[kinds[0]] : NULL);
+    }
+
+    if (nkinds > 1 && sweep) {
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Bandwidth by host memory kind, best core per device (MB/s)\n");
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < nsizes; s++) {
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", array_sizes_bytes[s] / 1000.0);
+            fprintf(stdout, ";");
+            for (int k = 0; k < nkinds; k++) {
+                fprintf(stdout, "%s%c", memory_kind_names[kinds[k]], k<nkinds-1 ? ';' : '\n');
+            }
+            for (int d = 0; d < ctx.ndev; d++) {
+                fprintf(stdout, "GPU %d;", d);
+                for (int k = 0; k < nkinds; k++) {
+                    fprintf(stdout, "%lf%c", best[kinds[k]][s][d], k<nkinds-1 ? ';' : '\n');
+                }
+            }
+        }
+    }
+
+    if (npages > 1 && sweep) {
+        print_pages(&ctx, &data, pages, npages, page_ok, kinds, nkinds, mean_time, mean_reg);
+    }
+
+    // free memory and cleanup
+    free(data.per_thread_buffs);
+    free(data.buf_node);
+    bench_matrix_free(data.buffer_numa, ctx.ncores);
+
+    for (int k = 0; k < npages * BW_MEM_NKINDS; k++) {
+        bench_matrix_free(best[k], nsizes);
+        bench_matrix_free(mean_time[k], nsizes);
+    }
+    bench_matrix_free(mean_reg, npages);
+    free(best);
+    free(mean_time);
+    for (int s = 0; s < nsizes; s++) {
+        bench_matrix_free(data.bandwidth[s], ctx.ncores);
+        bench_matrix_free(data.times_abs[s], ctx.ncores);
+        bench_stats_matrix_free(data.stats[s], ctx.ncores);
+        bench_stats_matrix_free(data.alloc_stats[s], ctx.ncores);
+    }
+    bench_stats_matrix_free(data.reg_stats, nsizes);
+    free(data.alloc_stats);
+    free(data.stats);
+    free(data.bandwidth);
+    free(data.times_abs);
+    free(ones);
+    free(array_sizes_bytes);
+    bench_finalize(&ctx);
+
+    return 0;
+}
+
+int main(int argc, char const * argv[]) {
+    return bench_config_main(argc, argv, "bandwidth", run);
+}
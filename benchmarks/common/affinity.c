@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+// closeness of a value to the best value of its device in (0, 1]
+static double closeness(double value, double best, int higher_is_better) {
+    if (value <= 0.0 || best <= 0.0) {
+        return 0.0;
+    }
+    return higher_is_better ? value / best : best / value;
+}
+
+// Format a list of ascending ids as ranges, e.g., "0-3,8".
+static void format_ranges(char * buf, size_t len, const int * ids, int n) {
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < n && pos < len; i++) {
+        int j = i;
+        while (j + 1 < n && ids[j + 1] == ids[j] + 1) {
+            j++;
+        }
+        if (j > i) {
+            pos += snprintf(buf + pos, len - pos, "%s%d-%d", pos ? "," : "", ids[i], ids[j]);
+        } else {
+            pos += snprintf(buf + pos, len - pos, "%s%d", pos ? "," : "", ids[i]);
+        }
+        i = j;
+    }
+}
+
+static int cmp_int(const void * a, const void * b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Format the CPUs of a set of cores as OMP_PLACES, e.g., "{0}:4,{8}".
+static void format_places(char * buf, size_t len, const bench_context_t * ctx, const int * cores, int n) {
+    int * cpus = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        cpus[i] = ctx->core_cpu[cores[i]];
+    }
+    qsort(cpus, n, sizeof(int), cmp_int);
+
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < n && pos < len; i++) {
+        int j = i;
+        while (j + 1 < n && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        if (j > i) {
+            pos += snprintf(buf + pos, len - pos, "%s{%d}:%d", pos ? "," : "", cpus[i], j - i + 1);
+        } else {
+            pos += snprintf(buf + pos, len - pos, "%s{%d}", pos ? "," : "", cpus[i]);
+        }
+        i = j;
+    }
+    free(cpus);
+}
+
+// Collect the distinct NUMA domains of a set of cores in ascending order.
+static int numa_of_cores(const bench_context_t * ctx, const int * cores, int n, int * domains) {
+    int nd = 0;
+    for (int i = 0; i < n; i++) {
+        int numa = ctx->core_numa[cores[i]];
+        int seen = 0;
+        for (int k = 0; k < nd; k++) {
+            seen |= domains[k] == numa;
+        }
+        if (!seen) {
+            domains[nd++] = numa;
+        }
+    }
+    qsort(domains, nd, sizeof(int), cmp_int);
+    return nd;
+}
+
+void bench_affinity_report(bench_context_t * ctx, double ** m, int higher_is_better) {
+    int ncores = ctx->ncores;
+    int ndev = ctx->ndev;
+    if (ndev == 0) {
+        return;
+    }
+    const char * env = getenv("BENCH_AFFINITY_TOLERANCE");
+    double tolerance = env ? atof(env) : 0.1;
+    double threshold = 1.0 / (1.0 + tolerance);
+
+    // Best value per device and closeness of every core.
+    double ** rel = bench_matrix_alloc(ncores, ndev);
+    for (int d = 0; d < ndev; d++) {
+        double best = m[0][d];
+        for (int c = 1; c < ncores; c++) {
+            if (higher_is_better ? m[c][d] > best : m[c][d] < best) {
+                best = m[c][d];
+            }
+        }
+        for (int c = 0; c < ncores; c++) {
+            rel[c][d] = closeness(m[c][d], best, higher_is_better);
+        }
+    }
+
+    // Assign every core to the closest near device, ties go to the device
+    // with fewer cores so far.
+    int * owner = (int *)malloc(ncores * sizeof(int));
+    int * nowned = (int *)calloc(ndev, sizeof(int));
+    for (int c = 0; c < ncores; c++) {
+        owner[c] = -1;
+        for (int d = 0; d < ndev; d++) {
+            if (rel[c][d] < threshold) {
+                continue;
+            }
+            if (owner[c] < 0 || rel[c][d] > rel[c][owner[c]]
+                    || (rel[c][d] == rel[c][owner[c]] && nowned[d] < nowned[owner[c]])) {
+                owner[c] = d;
+            }
+        }
+        if (owner[c] >= 0) {
+            nowned[owner[c]]++;
+        }
+    }
+
+    size_t len = (size_t)ncores * 16 + 16;
+    char * cores_str = (char *)malloc(len);
+    char * numa_str = (char *)malloc(len);
+    char * places_str = (char *)malloc(len);
+    int * cores = (int *)malloc(ncores * sizeof(int));
+    int * domains = (int *)malloc(ncores * sizeof(int));
+    int ** dev_cores = (int **)malloc(ndev * sizeof(int *));
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Device affinity (cores within %.0f%% of the best core per device)\n", tolerance * 100.0);
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Device;Near cores;Near NUMA domains;Assigned cores;OMP_PLACES\n");
+    for (int d = 0; d < ndev; d++) {
+        int n = 0;
+        for (int c = 0; c < ncores; c++) {
+            if (rel[c][d] >= threshold) {
+                cores[n++] = c;
+            }
+        }
+        format_ranges(cores_str, len, cores, n);
+        format_ranges(numa_str, len, domains, numa_of_cores(ctx, cores, n, domains));
+        fprintf(stdout, "GPU %d;%s;%s;", d, cores_str, numa_str);
+
+        // Devices that own no core fall back to their near cores.
+        dev_cores[d] = (int *)malloc(ncores * sizeof(int));
+        if (nowned[d] > 0) {
+            n = 0;
+            for (int c = 0; c < ncores; c++) {
+                if (owner[c] == d) {
+                    dev_cores[d][n++] = c;
+                }
+            }
+        } else {
+            memcpy(dev_cores[d], cores, n * sizeof(int));
+        }
+        nowned[d] = n;
+        format_ranges(cores_str, len, dev_cores[d], n);
+        format_places(places_str, len, ctx, dev_cores[d], n);
+        fprintf(stdout, "%s;%s\n", cores_str, places_str);
+
+        for (int c = 0; c < ncores; c++) {
+            bench_record_t rec;
+            bench_record_init(&rec, "affinity", c, d, 0);
+            bench_record_add(&rec, "closeness", rel[c][d]);
+            bench_record_add(&rec, "near", rel[c][d] >= threshold);
+            bench_record_add(&rec, "assigned", owner[c] == d);
+            bench_output_record(ctx, &rec);
+        }
+    }
+
+    const char * path = getenv("BENCH_AFFINITY_FILE");
+    if (path != NULL && path[0] != '\0') {
+        FILE * f = fopen(path, "w");
+        if (f == NULL) {
+            fprintf(stderr, "could not open affinity file '%s'\n", path);
+        } else {
+            env = getenv("BENCH_AFFINITY_RANKS");
+            int nranks = env ? atoi(env) : ndev;
+            if (nranks < 1) {
+                nranks = ndev;
+            }
+            fprintf(f, "# %s affinity on %s, backend %s, tolerance %g\n",
+                    ctx->benchmark, ctx->hostname, ctx->backend->name, tolerance);
+            fprintf(f, "# use device as OMP_DEFAULT_DEVICE or CUDA_VISIBLE_DEVICES/ROCR_VISIBLE_DEVICES\n");
+            fprintf(f, "rank;device;numa;omp_places\n");
+            for (int r = 0; r < nranks; r++) {
+                int d = r % ndev;
+                int k = r / ndev;
+                int nshare = nranks / ndev + (d < nranks % ndev ? 1 : 0);
+                int n = nowned[d];
+                int lo = k * n / nshare;
+                int hi = (k + 1) * n / nshare;
+                if (lo == hi && n > 0) {
+                    // more ranks than cores: share a single core
+                    lo = k % n;
+                    hi = lo + 1;
+                }
+                format_ranges(numa_str, len, domains, numa_of_cores(ctx, dev_cores[d] + lo, hi - lo, domains));
+                format_places(places_str, len, ctx, dev_cores[d] + lo, hi - lo);
+                fprintf(f, "%d;%d;%s;%s\n", r, d, numa_str, places_str);
+            }
+            fclose(f);
+            fprintf(stdout, "rank assignment for %d ranks written to %s\n", nranks, path);
+        }
+    }
+
+    for (int d = 0; d < ndev; d++) {
+        free(dev_cores[d]);
+    }
+    free(dev_cores);
+    free(domains);
+    free(cores);
+    free(places_str);
+    free(numa_str);
+    free(cores_str);
+    free(nowned);
+    free(owner);
+    bench_matrix_free(rel, ncores);
+}
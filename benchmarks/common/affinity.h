@@ -0,0 +1,19 @@
+#ifndef BENCH_AFFINITY_H
+#define BENCH_AFFINITY_H
+
+struct bench_context;
+
+// Turn a measured [core][device] matrix into a recommended core-to-device
+// mapping. A core is near a device if its value is within the tolerance
+// BENCH_AFFINITY_TOLERANCE (default 0.1, i.e., 10%) of the best core for
+// that device; higher_is_better selects bandwidth (1) or latency (0)
+// semantics. Every core is assigned to the near device it is closest to.
+//
+// Prints the near cores, their NUMA domains and an OMP_PLACES string for
+// every device. If BENCH_AFFINITY_FILE is set, a per-rank assignment file
+// (rank;device;numa;omp_places) is written for BENCH_AFFINITY_RANKS ranks
+// (default: one per device) that are distributed round-robin over the
+// devices and split the cores assigned to their device.
+void bench_affinity_report(struct bench_context * ctx, double ** m, int higher_is_better);
+
+#endif // BENCH_AFFINITY_H
@@ -0,0 +1,62 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "backend.h"
+#include "topology.h"
+
+// All compiled-in backends, the default (native) backend first.
+static const bench_backend_t * const bench_backends[] = {
+#ifdef BENCH_HAVE_CUDA
+    &bench_backend_cuda,
+#endif
+#ifdef BENCH_HAVE_HIP
+    &bench_backend_hip,
+#endif
+#ifdef BENCH_HAVE_OMP
+    &bench_backend_omp,
+#endif
+    &bench_backend_host,
+    &bench_backend_sim,
+    NULL
+};
+
+const bench_backend_t * bench_backend_find(const char * name) {
+    if (name == NULL || name[0] == '\0') {
+        return bench_backends[0];
+    }
+    for (int i = 0; bench_backends[i] != NULL; i++) {
+        if (strcmp(bench_backends[i]->name, name) == 0) {
+            return bench_backends[i];
+        }
+    }
+    return NULL;
+}
+
+void bench_backend_list(FILE * out) {
+    for (int i = 0; bench_backends[i] != NULL; i++) {
+        fprintf(out, "%s%s", i > 0 ? ", " : "", bench_backends[i]->name);
+    }
+    fprintf(out, "\n");
+}
+
+int bench_backend_pci_numa(const char * bus_id) {
+    // sysfs uses lower case hex digits
+    char id[64];
+    size_t n = 0;
+    for (; bus_id[n] && n < sizeof(id) - 1; n++) {
+        id[n] = (char)tolower((unsigned char)bus_id[n]);
+    }
+    id[n] = '\0';
+
+    FILE * f = bench_sysfs_open("/bus/pci/devices/%s/numa_node", id);
+    if (f == NULL) {
+        return -1;
+    }
+    int node = -1;
+    if (fscanf(f, "%d", &node) != 1) {
+        node = -1;
+    }
+    fclose(f);
+    return node;
+}
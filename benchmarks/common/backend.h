@@ -0,0 +1,201 @@
+#ifndef BENCH_BACKEND_H
+#define BENCH_BACKEND_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bound for the number of devices a backend keeps per-thread state for
+#define BENCH_MAX_DEVICES 64
+// Upper bound for the number of chunks in flight in pipelined transfers
+#define BENCH_MAX_PIPELINE_DEPTH 32
+
+// Upper bounds for the arguments of a shaped kernel launch
+#define BENCH_MAX_LAUNCH_SCALARS 16
+#define BENCH_MAX_LAUNCH_PTRS 8
+
+// Device buffer associated with a host buffer. The backend fills in ptr
+// (device memory) in alloc and may use it as it sees fit.
+typedef struct bench_devbuf {
+    int dev;
+    char * host;
+    size_t size;
+    void * ptr;
+} bench_devbuf_t;
+
+// Shape of a kernel launch for the launch overhead breakdown. The number of
+// scalars and pointers must be 0 or a power of two up to the maxima above.
+// Without an explicit grid the kernel runs on a single thread (an empty
+// OpenMP target region, a 1x1 grid otherwise); BENCH_LAUNCH_FULL selects the
+// grid the backend uses to fill the device.
+#define BENCH_LAUNCH_FULL (-1)
+
+typedef struct bench_launch {
+    int nscalars;           // firstprivate double arguments
+    int nptrs;              // pointer arguments (OpenMP: mapped, present on the device)
+    bench_devbuf_t * bufs;  // nptrs buffers, mapped or allocated by the caller
+    int teams;              // number of teams (blocks), 0 = single thread, or BENCH_LAUNCH_FULL
+    int threads;            // threads per team (block)
+    int nowait;             // deferred launch (OpenMP nowait), completed by sync
+} bench_launch_t;
+
+// Non-contiguous host data of the layout mode of the bandwidth benchmark.
+// Every layout moves count * width bytes.
+enum bench_layout_kind {
+    BENCH_LAYOUT_STRIDED = 0,   // 2D array section: count rows of width bytes, stride bytes apart
+    BENCH_LAYOUT_PIECES,        // count separate buffers in one construct (up to BENCH_MAX_LAYOUT_PIECES)
+    BENCH_LAYOUT_MAPPER,        // array of count structs, deep copy by a user-defined mapper
+    BENCH_LAYOUT_DEEP,          // the same structs, deep copy by one data directive per struct
+    BENCH_LAYOUT_N
+};
+
+#define BENCH_MAX_LAYOUT_PIECES 16
+
+// Struct with a pointer member, the unit of deep copies
+typedef struct bench_node {
+    size_t len;
+    char * data;
+} bench_node_t;
+
+typedef struct bench_layout {
+    int kind;
+    int dev;
+    size_t count;           // rows, pieces or structs
+    size_t width;           // bytes per row, piece or struct
+    size_t stride;          // bytes between the starts of two rows (strided)
+    char * host;            // first row (strided)
+    bench_node_t * nodes;   // count buffers of width bytes (pieces, mapper, deep)
+} bench_layout_t;
+
+// Interface every offloading backend (OpenMP, CUDA, HIP, host-only) implements.
+// Device-side operations are issued in order per thread and device; copies and
+// launches may be asynchronous until sync is called.
+typedef struct bench_backend {
+    const char * name;
+
+    // Initialize the runtime and return the number of devices.
+    int  (*init)(void);
+    void (*finalize)(void);
+    // Print backend specific information (optional, may be NULL).
+    void (*print_info)(FILE * out);
+
+    // Prepare the calling thread for using a device (set device, create
+    // stream, ...). Called once per thread and device during warm-up and
+    // before each measurement.
+    void (*init_device)(int dev);
+
+    // Allocate/free device memory for buf->size bytes on buf->dev.
+    void (*alloc)(bench_devbuf_t * buf);
+    void (*free)(bench_devbuf_t * buf);
+    // Copy the first size bytes between buf->host and the device memory.
+    void (*copy_h2d)(bench_devbuf_t * buf, size_t size);
+    void (*copy_d2h)(bench_devbuf_t * buf, size_t size);
+    // Launch an empty kernel on dev (buf may be NULL).
+    void (*launch)(int dev, bench_devbuf_t * buf);
+    // Wait until all operations of the calling thread on dev have finished.
+    void (*sync)(int dev);
+
+    // Allocate, copy to device, launch, copy back and free in one go, i.e.,
+    // the semantics of an OpenMP target region with map(tofrom:).
+    void (*roundtrip)(int dev, char * host, size_t size);
+
+    // NUMA domain the device is attached to, -1 if unknown (optional, may be NULL).
+    int  (*numa_node)(int dev);
+
+    // Host memory kinds besides pageable memory (optional, may be NULL).
+    // Allocate/free page-locked host memory that is accessible by all devices.
+    char * (*host_alloc_pinned)(size_t size);
+    void (*host_free_pinned)(char * ptr, size_t size);
+    // Page-lock (register) an existing host buffer and release it again.
+    void (*host_register)(char * ptr, size_t size);
+    void (*host_unregister)(char * ptr, size_t size);
+    // Read and write size bytes of page-locked host memory directly from a
+    // kernel on dev without staging copies (zero-copy) and wait for completion.
+    void (*zerocopy)(int dev, char * host, size_t size);
+
+    // Round trip of buf->size bytes split into chunks: copy every chunk to
+    // the device, launch an empty kernel on it and copy it back, with up to
+    // depth chunks in flight so that the stages of different chunks overlap.
+    // Uses the device memory of buf (from alloc) and waits for completion
+    // (optional, may be NULL).
+    void (*pipeline)(bench_devbuf_t * buf, size_t chunk, int depth);
+
+    // Directional transfers of buf->size bytes with the semantics of the
+    // OpenMP data directives, all synchronous (optional, may be NULL; the
+    // drivers fall back to alloc/copy/free):
+    //   map_to      target enter data map(to:)   allocate and copy to the device
+    //   unmap_from  target exit data map(from:)  copy back and free
+    //   update_to   target update to()           copy to the mapped buffer
+    //   update_from target update from()         copy from the mapped buffer
+    void (*map_to)(bench_devbuf_t * buf);
+    void (*unmap_from)(bench_devbuf_t * buf);
+    void (*update_to)(bench_devbuf_t * buf);
+    void (*update_from)(bench_devbuf_t * buf);
+    // Copy size bytes of the mapped buffer to to the device and of from back
+    // to the host at the same time and wait for both (optional, may be NULL).
+    void (*copy_bidir)(bench_devbuf_t * to, bench_devbuf_t * from, size_t size);
+
+    // Enable direct access of dev to the memory of peer if possible and
+    // return 1 if so, 0 if not (optional, may be NULL if unknown).
+    int  (*enable_peer)(int dev, int peer);
+    // Copy size bytes from the device memory of src to the device memory of
+    // dst without staging through host memory (if the devices have peer
+    // access) and wait for completion (optional, may be NULL).
+    void (*copy_peer)(bench_devbuf_t * dst, bench_devbuf_t * src, size_t size);
+
+    // Launch an empty kernel with the given arguments and grid on dev, like
+    // launch (optional, may be NULL).
+    void (*launch_shape)(int dev, const bench_launch_t * shape);
+    // Round trip of buf->size bytes on the device memory of buf (set up with
+    // map_to) like copy_h2d, launch and copy_d2h, but deferred: returns
+    // immediately and sync waits for completion (optional, may be NULL if
+    // those are asynchronous already).
+    void (*roundtrip_nowait)(bench_devbuf_t * buf);
+
+    // NUMA domain of a core (OpenMP thread) if the backend models the host
+    // topology itself, overriding the detected one (optional, may be NULL).
+    int  (*core_numa)(int core);
+
+    // Write the PCI bus id of dev (e.g. "0000:3b:00.0") to buf and return 0,
+    // or return -1 if unknown (optional, may be NULL).
+    int  (*pci_bus_id)(int dev, char * buf, size_t len);
+
+    // Map a non-contiguous layout to its device and back again (like map_to
+    // followed by unmap_from) and wait for completion. Returns -1 without
+    // doing anything if the backend has no dedicated path for the layout
+    // kind; the driver then copies it row by row or piece by piece
+    // (optional, may be NULL).
+    int  (*map_layout)(const bench_layout_t * layout);
+} bench_backend_t;
+
+#ifdef BENCH_HAVE_OMP
+extern const bench_backend_t bench_backend_omp;
+#endif
+#ifdef BENCH_HAVE_CUDA
+extern const bench_backend_t bench_backend_cuda;
+#endif
+#ifdef BENCH_HAVE_HIP
+extern const bench_backend_t bench_backend_hip;
+#endif
+extern const bench_backend_t bench_backend_host;
+extern const bench_backend_t bench_backend_sim;
+
+// Look up a compiled-in backend by name. NULL selects the default backend
+// (the native one if available, otherwise the host-only backend).
+const bench_backend_t * bench_backend_find(const char * name);
+
+// Print the names of all compiled-in backends.
+void bench_backend_list(FILE * out);
+
+// NUMA domain of a PCI device given its bus id (e.g. "0000:3b:00.0") as
+// reported by sysfs (below BENCH_SYSFS_ROOT), -1 if unknown.
+int bench_backend_pci_numa(const char * bus_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BENCH_BACKEND_H
@@ -0,0 +1,370 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <cuda_runtime.h>
+
+#include "backend.h"
+
+// Define macro to automate error handling of the CUDA API calls
+#define CUDACALL(func)                                                \
+    {                                                                 \
+        cudaError_t ret = func;                                       \
+        if (ret != cudaSuccess) {                                     \
+            fprintf(stderr,                                           \
+                    "CUDA error: '%s' at %s:%d\n",                    \
+                    cudaGetErrorString(ret), __FUNCTION__, __LINE__); \
+            abort();                                                  \
+        }                                                             \
+    }
+
+__global__ void empty(size_t n, char * array) {
+    // do nothing!
+}
+
+__global__ void touch(size_t n, char * array) {
+    // read and write every byte once
+    size_t stride = (size_t)gridDim.x * blockDim.x;
+    for (size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x; i < n; i += stride) {
+        array[i]++;
+    }
+}
+
+// representative grid to fill the device
+static int max_threads_per_block = 0;
+static int max_threads_per_mp = 0;
+static int mp_count = 0;
+static int n_blocks_to_start = 0;
+
+// Kernel arguments of the launch overhead breakdown, passed by value
+template <int N>
+struct scalar_args {
+    double v[N];
+};
+
+template <int N>
+struct pointer_args {
+    char * p[N];
+};
+
+template <typename T>
+__global__ void empty_args(T args) {
+    // do nothing!
+}
+
+// one stream per thread and device
+static thread_local cudaStream_t streams[BENCH_MAX_DEVICES];
+static thread_local bool stream_created[BENCH_MAX_DEVICES];
+
+// additional streams per thread and device for pipelined transfers
+static thread_local cudaStream_t pipeline_streams[BENCH_MAX_DEVICES][BENCH_MAX_PIPELINE_DEPTH];
+static thread_local int pipeline_nstreams[BENCH_MAX_DEVICES];
+
+// second stream per thread and device for the opposite copy direction
+static thread_local cudaStream_t bidir_streams[BENCH_MAX_DEVICES];
+static thread_local bool bidir_stream_created[BENCH_MAX_DEVICES];
+
+// device the calling thread selected last
+static thread_local int current_device = -1;
+
+// Allocations and launches go to the current device, so every operation on
+// a device selects it itself instead of relying on the last init_device.
+static void cuda_select(int dev) {
+    if (current_device != dev) {
+        CUDACALL(cudaSetDevice(dev));
+        current_device = dev;
+    }
+}
+
+static int cuda_init(void) {
+    int ndev = 0;
+    CUDACALL(cudaGetDeviceCount(&ndev));
+    if (ndev > 0) {
+        CUDACALL(cudaDeviceGetAttribute(&max_threads_per_block, cudaDevAttrMaxThreadsPerBlock, 0));
+        CUDACALL(cudaDeviceGetAttribute(&max_threads_per_mp, cudaDevAttrMaxThreadsPerMultiProcessor, 0));
+        CUDACALL(cudaDeviceGetAttribute(&mp_count, cudaDevAttrMultiProcessorCount, 0));
+        n_blocks_to_start = (max_threads_per_mp / max_threads_per_block) * mp_count;
+    }
+    // BENCH_KERNEL_GRID ("BLOCKSxTHREADS") replaces the representative grid
+    const char * grid = getenv("BENCH_KERNEL_GRID");
+    int blocks = 0, threads = 0;
+    if (grid != NULL && sscanf(grid, "%dx%d", &blocks, &threads) == 2 && blocks > 0 && threads > 0) {
+        n_blocks_to_start = blocks;
+        max_threads_per_block = threads;
+    }
+    return ndev < BENCH_MAX_DEVICES ? ndev : BENCH_MAX_DEVICES;
+}
+
+static void cuda_finalize(void) {
+}
+
+static void cuda_print_info(FILE * out) {
+    fprintf(out, "mp_count: %d\n", mp_count);
+    fprintf(out, "max_threads_per_block: %d\n", max_threads_per_block);
+    fprintf(out, "max_threads_per_mp: %d\n", max_threads_per_mp);
+    fprintf(out, "n_blocks_to_start: %d\n", n_blocks_to_start);
+}
+
+static void cuda_init_device(int dev) {
+    cuda_select(dev);
+    if (!stream_created[dev]) {
+        CUDACALL(cudaStreamCreate(&streams[dev]));
+        stream_created[dev] = true;
+    }
+}
+
+static void cuda_alloc(bench_devbuf_t * buf) {
+    cuda_select(buf->dev);
+    CUDACALL(cudaMalloc(&buf->ptr, buf->size));
+}
+
+static void cuda_free(bench_devbuf_t * buf) {
+    cuda_select(buf->dev);
+    CUDACALL(cudaFree(buf->ptr));
+    buf->ptr = NULL;
+}
+
+static void cuda_copy_h2d(bench_devbuf_t * buf, size_t size) {
+    cuda_select(buf->dev);
+    CUDACALL(cudaMemcpyAsync(buf->ptr, buf->host, size, cudaMemcpyHostToDevice, streams[buf->dev]));
+}
+
+static void cuda_copy_d2h(bench_devbuf_t * buf, size_t size) {
+    cuda_select(buf->dev);
+    CUDACALL(cudaMemcpyAsync(buf->host, buf->ptr, size, cudaMemcpyDeviceToHost, streams[buf->dev]));
+}
+
+static void cuda_launch(int dev, bench_devbuf_t * buf) {
+    cuda_select(dev);
+    if (buf == NULL) {
+        empty<<<n_blocks_to_start, max_threads_per_block, 0, streams[dev]>>>(0, NULL);
+        CUDACALL(cudaGetLastError());
+    } else {
+        empty<<<n_blocks_to_start, max_threads_per_block, 0, streams[dev]>>>(buf->size, (char *)buf->ptr);
+        CUDACALL(cudaGetLastError());
+    }
+}
+
+static void cuda_sync(int dev) {
+    CUDACALL(cudaStreamSynchronize(streams[dev]));
+}
+
+static void cuda_roundtrip(int dev, char * host, size_t size) {
+    bench_devbuf_t buf = { dev, host, size, NULL };
+    cuda_alloc(&buf);
+    cuda_copy_h2d(&buf, size);
+    cuda_launch(dev, &buf);
+    cuda_copy_d2h(&buf, size);
+    cuda_sync(dev);
+    cuda_free(&buf);
+}
+
+static int cuda_pci_bus_id(int dev, char * buf, size_t len) {
+    CUDACALL(cudaDeviceGetPCIBusId(buf, (int)len, dev));
+    return 0;
+}
+
+static int cuda_numa_node(int dev) {
+    char bus_id[32];
+    cuda_pci_bus_id(dev, bus_id, sizeof(bus_id));
+    return bench_backend_pci_numa(bus_id);
+}
+
+static char * cuda_host_alloc_pinned(size_t size) {
+    char * ptr = NULL;
+    CUDACALL(cudaHostAlloc((void **)&ptr, size, cudaHostAllocPortable | cudaHostAllocMapped));
+    return ptr;
+}
+
+static void cuda_host_free_pinned(char * ptr, size_t size) {
+    CUDACALL(cudaFreeHost(ptr));
+}
+
+static void cuda_host_register(char * ptr, size_t size) {
+    CUDACALL(cudaHostRegister(ptr, size, cudaHostRegisterPortable | cudaHostRegisterMapped));
+}
+
+static void cuda_host_unregister(char * ptr, size_t size) {
+    CUDACALL(cudaHostUnregister(ptr));
+}
+
+static void cuda_zerocopy(int dev, char * host, size_t size) {
+    cuda_select(dev);
+    char * dptr = NULL;
+    CUDACALL(cudaHostGetDevicePointer((void **)&dptr, host, 0));
+    touch<<<n_blocks_to_start, max_threads_per_block, 0, streams[dev]>>>(size, dptr);
+    CUDACALL(cudaGetLastError());
+    cuda_sync(dev);
+}
+
+// Chunk i is copied, processed and copied back in stream i % depth, so the
+// stages of chunks in different streams overlap.
+static void cuda_pipeline(bench_devbuf_t * buf, size_t chunk, int depth) {
+    int dev = buf->dev;
+    cuda_select(dev);
+    while (pipeline_nstreams[dev] < depth) {
+        CUDACALL(cudaStreamCreate(&pipeline_streams[dev][pipeline_nstreams[dev]]));
+        pipeline_nstreams[dev]++;
+    }
+    size_t i = 0;
+    for (size_t off = 0; off < buf->size; off += chunk, i++) {
+        size_t len = buf->size - off < chunk ? buf->size - off : chunk;
+        cudaStream_t stream = pipeline_streams[dev][i % depth];
+        CUDACALL(cudaMemcpyAsync((char *)buf->ptr + off, buf->host + off, len, cudaMemcpyHostToDevice, stream));
+        empty<<<n_blocks_to_start, max_threads_per_block, 0, stream>>>(len, (char *)buf->ptr + off);
+        CUDACALL(cudaGetLastError());
+        CUDACALL(cudaMemcpyAsync(buf->host + off, (char *)buf->ptr + off, len, cudaMemcpyDeviceToHost, stream));
+    }
+    for (int k = 0; k < depth; k++) {
+        CUDACALL(cudaStreamSynchronize(pipeline_streams[dev][k]));
+    }
+}
+
+static void cuda_copy_bidir(bench_devbuf_t * to, bench_devbuf_t * from, size_t size) {
+    // streams belong to the device current at their creation, so each copy
+    // is issued with the device of its stream selected
+    cuda_select(to->dev);
+    CUDACALL(cudaMemcpyAsync(to->ptr, to->host, size, cudaMemcpyHostToDevice, streams[to->dev]));
+    cuda_select(from->dev);
+    if (!bidir_stream_created[from->dev]) {
+        CUDACALL(cudaStreamCreate(&bidir_streams[from->dev]));
+        bidir_stream_created[from->dev] = true;
+    }
+    CUDACALL(cudaMemcpyAsync(from->host, from->ptr, size, cudaMemcpyDeviceToHost, bidir_streams[from->dev]));
+    CUDACALL(cudaStreamSynchronize(streams[to->dev]));
+    CUDACALL(cudaStreamSynchronize(bidir_streams[from->dev]));
+}
+
+static int cuda_enable_peer(int dev, int peer) {
+    int can_access = 0;
+    if (dev == peer) {
+        return 1;
+    }
+    CUDACALL(cudaDeviceCanAccessPeer(&can_access, dev, peer));
+    if (!can_access) {
+        return 0;
+    }
+    cuda_select(dev);
+    cudaError_t ret = cudaDeviceEnablePeerAccess(peer, 0);
+    if (ret == cudaErrorPeerAccessAlreadyEnabled) {
+        // clear the sticky error
+        cudaGetLastError();
+    } else {
+        CUDACALL(ret);
+    }
+    return 1;
+}
+
+static void cuda_copy_peer(bench_devbuf_t * dst, bench_devbuf_t * src, size_t size) {
+    cuda_select(src->dev);
+    CUDACALL(cudaMemcpyPeerAsync(dst->ptr, dst->dev, src->ptr, src->dev, size, streams[src->dev]));
+    CUDACALL(cudaStreamSynchronize(streams[src->dev]));
+}
+
+template <int N>
+static scalar_args<N> make_scalars() {
+    scalar_args<N> a;
+    for (int i = 0; i < N; i++) {
+        a.v[i] = 1.0;
+    }
+    return a;
+}
+
+template <int N>
+static pointer_args<N> make_pointers(const bench_launch_t * shape) {
+    pointer_args<N> a;
+    for (int i = 0; i < N; i++) {
+        a.p[i] = (char *)shape->bufs[i].ptr;
+    }
+    return a;
+}
+
+template <typename T>
+static void cuda_launch_args(int dev, int blocks, int threads, const T & args) {
+    empty_args<T><<<blocks, threads, 0, streams[dev]>>>(args);
+    CUDACALL(cudaGetLastError());
+}
+
+// Launches are asynchronous anyway, so nowait makes no difference.
+static void cuda_launch_shape(int dev, const bench_launch_t * shape) {
+    cuda_select(dev);
+    int blocks = 1;
+    int threads = 1;
+    if (shape->teams == BENCH_LAUNCH_FULL) {
+        blocks = n_blocks_to_start;
+        threads = max_threads_per_block;
+    } else if (shape->teams > 0) {
+        blocks = shape->teams;
+        threads = shape->threads;
+    }
+
+    if (shape->nscalars > 0) {
+        switch (shape->nscalars) {
+            case 1:  cuda_launch_args(dev, blocks, threads, make_scalars<1>()); break;
+            case 2:  cuda_launch_args(dev, blocks, threads, make_scalars<2>()); break;
+            case 4:  cuda_launch_args(dev, blocks, threads, make_scalars<4>()); break;
+            case 8:  cuda_launch_args(dev, blocks, threads, make_scalars<8>()); break;
+            default: cuda_launch_args(dev, blocks, threads, make_scalars<16>()); break;
+        }
+    } else if (shape->nptrs > 0) {
+        switch (shape->nptrs) {
+            case 1:  cuda_launch_args(dev, blocks, threads, make_pointers<1>(shape)); break;
+            case 2:  cuda_launch_args(dev, blocks, threads, make_pointers<2>(shape)); break;
+            case 4:  cuda_launch_args(dev, blocks, threads, make_pointers<4>(shape)); break;
+            default: cuda_launch_args(dev, blocks, threads, make_pointers<8>(shape)); break;
+        }
+    } else {
+        empty<<<blocks, threads, 0, streams[dev]>>>(0, NULL);
+        CUDACALL(cudaGetLastError());
+    }
+}
+
+// Strided rows are copied by the copy engine in one 2D transfer each way,
+// into a packed device buffer. The other layouts are left to the driver.
+static int cuda_map_layout(const bench_layout_t * layout) {
+    if (layout->kind != BENCH_LAYOUT_STRIDED) {
+        return -1;
+    }
+    bench_devbuf_t buf = { layout->dev, layout->host, layout->count * layout->width, NULL };
+    cuda_alloc(&buf);
+    CUDACALL(cudaMemcpy2DAsync(buf.ptr, layout->width, layout->host, layout->stride, layout->width, layout->count,
+                               cudaMemcpyHostToDevice, streams[layout->dev]));
+    CUDACALL(cudaMemcpy2DAsync(layout->host, layout->stride, buf.ptr, layout->width, layout->width, layout->count,
+                               cudaMemcpyDeviceToHost, streams[layout->dev]));
+    cuda_sync(layout->dev);
+    cuda_free(&buf);
+    return 0;
+}
+
+extern "C" const bench_backend_t bench_backend_cuda = {
+    /* .name        = */ "cuda",
+    /* .init        = */ cuda_init,
+    /* .finalize    = */ cuda_finalize,
+    /* .print_info  = */ cuda_print_info,
+    /* .init_device = */ cuda_init_device,
+    /* .alloc       = */ cuda_alloc,
+    /* .free        = */ cuda_free,
+    /* .copy_h2d    = */ cuda_copy_h2d,
+    /* .copy_d2h    = */ cuda_copy_d2h,
+    /* .launch      = */ cuda_launch,
+    /* .sync        = */ cuda_sync,
+    /* .roundtrip   = */ cuda_roundtrip,
+    /* .numa_node   = */ cuda_numa_node,
+    /* .host_alloc_pinned = */ cuda_host_alloc_pinned,
+    /* .host_free_pinned  = */ cuda_host_free_pinned,
+    /* .host_register     = */ cuda_host_register,
+    /* .host_unregister   = */ cuda_host_unregister,
+    /* .zerocopy          = */ cuda_zerocopy,
+    /* .pipeline          = */ cuda_pipeline,
+    /* .map_to            = */ NULL,
+    /* .unmap_from        = */ NULL,
+    /* .update_to         = */ NULL,
+    /* .update_from       = */ NULL,
+    /* .copy_bidir        = */ cuda_copy_bidir,
+    /* .enable_peer       = */ cuda_enable_peer,
+    /* .copy_peer         = */ cuda_copy_peer,
+    /* .launch_shape      = */ cuda_launch_shape,
+    /* .roundtrip_nowait  = */ NULL,   // copies and launches are asynchronous
+    /* .core_numa         = */ NULL,
+    /* .pci_bus_id        = */ cuda_pci_bus_id,
+    /* .map_layout        = */ cuda_map_layout,
+};
@@ -0,0 +1,370 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <hip/hip_runtime.h>
+
+#include "backend.h"
+
+// Define macro to automate error handling of the HIP API calls
+#define HIPCALL(func)                                                \
+    {                                                                \
+        hipError_t ret = func;                                       \
+        if (ret != hipSuccess) {                                     \
+            fprintf(stderr,                                          \
+                    "HIP error: '%s' at %s:%d\n",                    \
+                    hipGetErrorString(ret), __FUNCTION__, __LINE__); \
+            abort();                                                 \
+        }                                                            \
+    }
+
+__global__ void empty(size_t n, char * array) {
+    // do nothing!
+}
+
+__global__ void touch(size_t n, char * array) {
+    // read and write every byte once
+    size_t stride = (size_t)gridDim.x * blockDim.x;
+    for (size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x; i < n; i += stride) {
+        array[i]++;
+    }
+}
+
+// Kernel arguments of the launch overhead breakdown, passed by value
+template <int N>
+struct scalar_args {
+    double v[N];
+};
+
+template <int N>
+struct pointer_args {
+    char * p[N];
+};
+
+template <typename T>
+__global__ void empty_args(T args) {
+    // do nothing!
+}
+
+// representative grid to fill the device
+static int max_threads_per_block = 0;
+static int max_threads_per_mp = 0;
+static int mp_count = 0;
+static int n_blocks_to_start = 0;
+
+// one stream per thread and device
+static thread_local hipStream_t streams[BENCH_MAX_DEVICES];
+static thread_local bool stream_created[BENCH_MAX_DEVICES];
+
+// additional streams per thread and device for pipelined transfers
+static thread_local hipStream_t pipeline_streams[BENCH_MAX_DEVICES][BENCH_MAX_PIPELINE_DEPTH];
+static thread_local int pipeline_nstreams[BENCH_MAX_DEVICES];
+
+// second stream per thread and device for the opposite copy direction
+static thread_local hipStream_t bidir_streams[BENCH_MAX_DEVICES];
+static thread_local bool bidir_stream_created[BENCH_MAX_DEVICES];
+
+// device the calling thread selected last
+static thread_local int current_device = -1;
+
+// Allocations and launches go to the current device, so every operation on
+// a device selects it itself instead of relying on the last init_device.
+static void hip_select(int dev) {
+    if (current_device != dev) {
+        HIPCALL(hipSetDevice(dev));
+        current_device = dev;
+    }
+}
+
+static int hip_init(void) {
+    int ndev = 0;
+    HIPCALL(hipGetDeviceCount(&ndev));
+    if (ndev > 0) {
+        HIPCALL(hipDeviceGetAttribute(&max_threads_per_block, hipDeviceAttributeMaxThreadsPerBlock, 0));
+        HIPCALL(hipDeviceGetAttribute(&max_threads_per_mp, hipDeviceAttributeMaxThreadsPerMultiProcessor, 0));
+        HIPCALL(hipDeviceGetAttribute(&mp_count, hipDeviceAttributeMultiprocessorCount, 0));
+        n_blocks_to_start = (max_threads_per_mp / max_threads_per_block) * mp_count;
+    }
+    // BENCH_KERNEL_GRID ("BLOCKSxTHREADS") replaces the representative grid
+    const char * grid = getenv("BENCH_KERNEL_GRID");
+    int blocks = 0, threads = 0;
+    if (grid != NULL && sscanf(grid, "%dx%d", &blocks, &threads) == 2 && blocks > 0 && threads > 0) {
+        n_blocks_to_start = blocks;
+        max_threads_per_block = threads;
+    }
+    return ndev < BENCH_MAX_DEVICES ? ndev : BENCH_MAX_DEVICES;
+}
+
+static void hip_finalize(void) {
+}
+
+static void hip_print_info(FILE * out) {
+    fprintf(out, "mp_count: %d\n", mp_count);
+    fprintf(out, "max_threads_per_block: %d\n", max_threads_per_block);
+    fprintf(out, "max_threads_per_mp: %d\n", max_threads_per_mp);
+    fprintf(out, "n_blocks_to_start: %d\n", n_blocks_to_start);
+}
+
+static void hip_init_device(int dev) {
+    hip_select(dev);
+    if (!stream_created[dev]) {
+        HIPCALL(hipStreamCreate(&streams[dev]));
+        stream_created[dev] = true;
+    }
+}
+
+static void hip_alloc(bench_devbuf_t * buf) {
+    hip_select(buf->dev);
+    HIPCALL(hipMalloc(&buf->ptr, buf->size));
+}
+
+static void hip_free(bench_devbuf_t * buf) {
+    hip_select(buf->dev);
+    HIPCALL(hipFree(buf->ptr));
+    buf->ptr = nullptr;
+}
+
+static void hip_copy_h2d(bench_devbuf_t * buf, size_t size) {
+    hip_select(buf->dev);
+    HIPCALL(hipMemcpyHtoDAsync(buf->ptr, buf->host, size, streams[buf->dev]));
+}
+
+static void hip_copy_d2h(bench_devbuf_t * buf, size_t size) {
+    hip_select(buf->dev);
+    HIPCALL(hipMemcpyDtoHAsync(buf->host, buf->ptr, size, streams[buf->dev]));
+}
+
+static void hip_launch(int dev, bench_devbuf_t * buf) {
+    hip_select(dev);
+    if (buf == nullptr) {
+        empty<<<n_blocks_to_start, max_threads_per_block, 0, streams[dev]>>>(0, nullptr);
+        HIPCALL(hipGetLastError());
+    } else {
+        empty<<<n_blocks_to_start, max_threads_per_block, 0, streams[dev]>>>(buf->size, (char *)buf->ptr);
+        HIPCALL(hipGetLastError());
+    }
+}
+
+static void hip_sync(int dev) {
+    HIPCALL(hipStreamSynchronize(streams[dev]));
+}
+
+static void hip_roundtrip(int dev, char * host, size_t size) {
+    bench_devbuf_t buf = { dev, host, size, nullptr };
+    hip_alloc(&buf);
+    hip_copy_h2d(&buf, size);
+    hip_launch(dev, &buf);
+    hip_copy_d2h(&buf, size);
+    hip_sync(dev);
+    hip_free(&buf);
+}
+
+static int hip_pci_bus_id(int dev, char * buf, size_t len) {
+    HIPCALL(hipDeviceGetPCIBusId(buf, (int)len, dev));
+    return 0;
+}
+
+static int hip_numa_node(int dev) {
+    char bus_id[32];
+    hip_pci_bus_id(dev, bus_id, sizeof(bus_id));
+    return bench_backend_pci_numa(bus_id);
+}
+
+static char * hip_host_alloc_pinned(size_t size) {
+    char * ptr = nullptr;
+    HIPCALL(hipHostMalloc((void **)&ptr, size, hipHostMallocPortable | hipHostMallocMapped));
+    return ptr;
+}
+
+static void hip_host_free_pinned(char * ptr, size_t size) {
+    HIPCALL(hipHostFree(ptr));
+}
+
+static void hip_host_register(char * ptr, size_t size) {
+    HIPCALL(hipHostRegister(ptr, size, hipHostRegisterPortable | hipHostRegisterMapped));
+}
+
+static void hip_host_unregister(char * ptr, size_t size) {
+    HIPCALL(hipHostUnregister(ptr));
+}
+
+static void hip_zerocopy(int dev, char * host, size_t size) {
+    hip_select(dev);
+    char * dptr = nullptr;
+    HIPCALL(hipHostGetDevicePointer((void **)&dptr, host, 0));
+    touch<<<n_blocks_to_start, max_threads_per_block, 0, streams[dev]>>>(size, dptr);
+    HIPCALL(hipGetLastError());
+    hip_sync(dev);
+}
+
+// Chunk i is copied, processed and copied back in stream i % depth, so the
+// stages of chunks in different streams overlap.
+static void hip_pipeline(bench_devbuf_t * buf, size_t chunk, int depth) {
+    int dev = buf->dev;
+    hip_select(dev);
+    while (pipeline_nstreams[dev] < depth) {
+        HIPCALL(hipStreamCreate(&pipeline_streams[dev][pipeline_nstreams[dev]]));
+        pipeline_nstreams[dev]++;
+    }
+    size_t i = 0;
+    for (size_t off = 0; off < buf->size; off += chunk, i++) {
+        size_t len = buf->size - off < chunk ? buf->size - off : chunk;
+        hipStream_t stream = pipeline_streams[dev][i % depth];
+        HIPCALL(hipMemcpyHtoDAsync((char *)buf->ptr + off, buf->host + off, len, stream));
+        empty<<<n_blocks_to_start, max_threads_per_block, 0, stream>>>(len, (char *)buf->ptr + off);
+        HIPCALL(hipGetLastError());
+        HIPCALL(hipMemcpyDtoHAsync(buf->host + off, (char *)buf->ptr + off, len, stream));
+    }
+    for (int k = 0; k < depth; k++) {
+        HIPCALL(hipStreamSynchronize(pipeline_streams[dev][k]));
+    }
+}
+
+static void hip_copy_bidir(bench_devbuf_t * to, bench_devbuf_t * from, size_t size) {
+    // streams belong to the device current at their creation, so each copy
+    // is issued with the device of its stream selected
+    hip_select(to->dev);
+    HIPCALL(hipMemcpyHtoDAsync(to->ptr, to->host, size, streams[to->dev]));
+    hip_select(from->dev);
+    if (!bidir_stream_created[from->dev]) {
+        HIPCALL(hipStreamCreate(&bidir_streams[from->dev]));
+        bidir_stream_created[from->dev] = true;
+    }
+    HIPCALL(hipMemcpyDtoHAsync(from->host, from->ptr, size, bidir_streams[from->dev]));
+    HIPCALL(hipStreamSynchronize(streams[to->dev]));
+    HIPCALL(hipStreamSynchronize(bidir_streams[from->dev]));
+}
+
+static int hip_enable_peer(int dev, int peer) {
+    int can_access = 0;
+    if (dev == peer) {
+        return 1;
+    }
+    HIPCALL(hipDeviceCanAccessPeer(&can_access, dev, peer));
+    if (!can_access) {
+        return 0;
+    }
+    hip_select(dev);
+    hipError_t ret = hipDeviceEnablePeerAccess(peer, 0);
+    if (ret == hipErrorPeerAccessAlreadyEnabled) {
+        // clear the sticky error
+        hipGetLastError();
+    } else {
+        HIPCALL(ret);
+    }
+    return 1;
+}
+
+static void hip_copy_peer(bench_devbuf_t * dst, bench_devbuf_t * src, size_t size) {
+    hip_select(src->dev);
+    HIPCALL(hipMemcpyPeerAsync(dst->ptr, dst->dev, src->ptr, src->dev, size, streams[src->dev]));
+    HIPCALL(hipStreamSynchronize(streams[src->dev]));
+}
+
+template <int N>
+static scalar_args<N> make_scalars() {
+    scalar_args<N> a;
+    for (int i = 0; i < N; i++) {
+        a.v[i] = 1.0;
+    }
+    return a;
+}
+
+template <int N>
+static pointer_args<N> make_pointers(const bench_launch_t * shape) {
+    pointer_args<N> a;
+    for (int i = 0; i < N; i++) {
+        a.p[i] = (char *)shape->bufs[i].ptr;
+    }
+    return a;
+}
+
+template <typename T>
+static void hip_launch_args(int dev, int blocks, int threads, const T & args) {
+    empty_args<T><<<blocks, threads, 0, streams[dev]>>>(args);
+    HIPCALL(hipGetLastError());
+}
+
+// Launches are asynchronous anyway, so nowait makes no difference.
+static void hip_launch_shape(int dev, const bench_launch_t * shape) {
+    hip_select(dev);
+    int blocks = 1;
+    int threads = 1;
+    if (shape->teams == BENCH_LAUNCH_FULL) {
+        blocks = n_blocks_to_start;
+        threads = max_threads_per_block;
+    } else if (shape->teams > 0) {
+        blocks = shape->teams;
+        threads = shape->threads;
+    }
+
+    if (shape->nscalars > 0) {
+        switch (shape->nscalars) {
+            case 1:  hip_launch_args(dev, blocks, threads, make_scalars<1>()); break;
+            case 2:  hip_launch_args(dev, blocks, threads, make_scalars<2>()); break;
+            case 4:  hip_launch_args(dev, blocks, threads, make_scalars<4>()); break;
+            case 8:  hip_launch_args(dev, blocks, threads, make_scalars<8>()); break;
+            default: hip_launch_args(dev, blocks, threads, make_scalars<16>()); break;
+        }
+    } else if (shape->nptrs > 0) {
+        switch (shape->nptrs) {
+            case 1:  hip_launch_args(dev, blocks, threads, make_pointers<1>(shape)); break;
+            case 2:  hip_launch_args(dev, blocks, threads, make_pointers<2>(shape)); break;
+            case 4:  hip_launch_args(dev, blocks, threads, make_pointers<4>(shape)); break;
+            default: hip_launch_args(dev, blocks, threads, make_pointers<8>(shape)); break;
+        }
+    } else {
+        empty<<<blocks, threads, 0, streams[dev]>>>(0, nullptr);
+        HIPCALL(hipGetLastError());
+    }
+}
+
+// Strided rows are copied by the copy engine in one 2D transfer each way,
+// into a packed device buffer. The other layouts are left to the driver.
+static int hip_map_layout(const bench_layout_t * layout) {
+    if (layout->kind != BENCH_LAYOUT_STRIDED) {
+        return -1;
+    }
+    bench_devbuf_t buf = { layout->dev, layout->host, layout->count * layout->width, nullptr };
+    hip_alloc(&buf);
+    HIPCALL(hipMemcpy2DAsync(buf.ptr, layout->width, layout->host, layout->stride, layout->width, layout->count,
+                             hipMemcpyHostToDevice, streams[layout->dev]));
+    HIPCALL(hipMemcpy2DAsync(layout->host, layout->stride, buf.ptr, layout->width, layout->width, layout->count,
+                             hipMemcpyDeviceToHost, streams[layout->dev]));
+    hip_sync(layout->dev);
+    hip_free(&buf);
+    return 0;
+}
+
+extern "C" const bench_backend_t bench_backend_hip = {
+    /* .name        = */ "hip",
+    /* .init        = */ hip_init,
+    /* .finalize    = */ hip_finalize,
+    /* .print_info  = */ hip_print_info,
+    /* .init_device = */ hip_init_device,
+    /* .alloc       = */ hip_alloc,
+    /* .free        = */ hip_free,
+    /* .copy_h2d    = */ hip_copy_h2d,
+    /* .copy_d2h    = */ hip_copy_d2h,
+    /* .launch      = */ hip_launch,
+    /* .sync        = */ hip_sync,
+    /* .roundtrip   = */ hip_roundtrip,
+    /* .numa_node   = */ hip_numa_node,
+    /* .host_alloc_pinned = */ hip_host_alloc_pinned,
+    /* .host_free_pinned  = */ hip_host_free_pinned,
+    /* .host_register     = */ hip_host_register,
+    /* .host_unregister   = */ hip_host_unregister,
+    /* .zerocopy          = */ hip_zerocopy,
+    /* .pipeline          = */ hip_pipeline,
+    /* .map_to            = */ nullptr,
+    /* .unmap_from        = */ nullptr,
+    /* .update_to         = */ nullptr,
+    /* .update_from       = */ nullptr,
+    /* .copy_bidir        = */ hip_copy_bidir,
+    /* .enable_peer       = */ hip_enable_peer,
+    /* .copy_peer         = */ hip_copy_peer,
+    /* .launch_shape      = */ hip_launch_shape,
+    /* .roundtrip_nowait  = */ NULL,   // copies and launches are asynchronous
+    /* .core_numa         = */ NULL,
+    /* .pci_bus_id        = */ hip_pci_bus_id,
+    /* .map_layout        = */ hip_map_layout,
+};
@@ -0,0 +1,238 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "backend.h"
+
+// Host-only reference backend: every "device" is a worker thread that
+// executes the (empty) kernels, device memory is plain host memory and
+// copies are memcpy. This allows building and testing the harness on nodes
+// without GPUs. The number of devices is set via BENCH_HOST_DEVICES (default 1).
+
+typedef struct host_device {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned long posted;
+    unsigned long done;
+    int shutdown;
+} host_device_t;
+
+static host_device_t * host_devices = NULL;
+static int host_ndev = 0;
+
+static void * host_device_main(void * arg) {
+    host_device_t * hd = (host_device_t *)arg;
+    pthread_mutex_lock(&hd->lock);
+    while (1) {
+        while (hd->done == hd->posted && !hd->shutdown) {
+            pthread_cond_wait(&hd->cond, &hd->lock);
+        }
+        if (hd->done == hd->posted && hd->shutdown) {
+            break;
+        }
+        // "execute" the empty kernel
+        hd->done++;
+        pthread_cond_broadcast(&hd->cond);
+    }
+    pthread_mutex_unlock(&hd->lock);
+    return NULL;
+}
+
+static int host_init(void) {
+    const char * env = getenv("BENCH_HOST_DEVICES");
+    host_ndev = env ? atoi(env) : 1;
+    if (host_ndev < 0) {
+        host_ndev = 0;
+    }
+    if (host_ndev > BENCH_MAX_DEVICES) {
+        host_ndev = BENCH_MAX_DEVICES;
+    }
+    host_devices = (host_device_t *)calloc(host_ndev > 0 ? host_ndev : 1, sizeof(host_device_t));
+    for (int d = 0; d < host_ndev; d++) {
+        host_device_t * hd = &host_devices[d];
+        pthread_mutex_init(&hd->lock, NULL);
+        pthread_cond_init(&hd->cond, NULL);
+        if (pthread_create(&hd->thread, NULL, host_device_main, hd) != 0) {
+            fprintf(stderr, "host backend error: could not start worker for device %d\n", d);
+            abort();
+        }
+    }
+    return host_ndev;
+}
+
+static void host_finalize(void) {
+    for (int d = 0; d < host_ndev; d++) {
+        host_device_t * hd = &host_devices[d];
+        pthread_mutex_lock(&hd->lock);
+        hd->shutdown = 1;
+        pthread_cond_broadcast(&hd->cond);
+        pthread_mutex_unlock(&hd->lock);
+        pthread_join(hd->thread, NULL);
+        pthread_mutex_destroy(&hd->lock);
+        pthread_cond_destroy(&hd->cond);
+    }
+    free(host_devices);
+    host_devices = NULL;
+    host_ndev = 0;
+}
+
+static void host_init_device(int dev) {
+    // nothing to do, workers are started in init
+}
+
+static void host_sync(int dev) {
+    host_device_t * hd = &host_devices[dev];
+    pthread_mutex_lock(&hd->lock);
+    while (hd->done < hd->posted) {
+        pthread_cond_wait(&hd->cond, &hd->lock);
+    }
+    pthread_mutex_unlock(&hd->lock);
+}
+
+static void host_alloc(bench_devbuf_t * buf) {
+    buf->ptr = malloc(buf->size);
+    if (buf->ptr == NULL) {
+        fprintf(stderr, "host backend error: allocation of %zu bytes failed\n", buf->size);
+        abort();
+    }
+}
+
+static void host_free(bench_devbuf_t * buf) {
+    free(buf->ptr);
+    buf->ptr = NULL;
+}
+
+static void host_copy_h2d(bench_devbuf_t * buf, size_t size) {
+    // copies are ordered after previously launched kernels
+    host_sync(buf->dev);
+    memcpy(buf->ptr, buf->host, size);
+}
+
+static void host_copy_d2h(bench_devbuf_t * buf, size_t size) {
+    host_sync(buf->dev);
+    memcpy(buf->host, buf->ptr, size);
+}
+
+static void host_launch(int dev, bench_devbuf_t * buf) {
+    host_device_t * hd = &host_devices[dev];
+    pthread_mutex_lock(&hd->lock);
+    hd->posted++;
+    pthread_cond_broadcast(&hd->cond);
+    pthread_mutex_unlock(&hd->lock);
+}
+
+static void host_roundtrip(int dev, char * host, size_t size) {
+    bench_devbuf_t buf = { dev, host, size, NULL };
+    host_alloc(&buf);
+    host_copy_h2d(&buf, size);
+    host_launch(dev, &buf);
+    host_copy_d2h(&buf, size);
+    host_free(&buf);
+}
+
+// Pinned memory is emulated by locking the pages in memory.
+static char * host_alloc_pinned(size_t size) {
+    void * ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        fprintf(stderr, "host backend error: allocation of %zu bytes failed\n", size);
+        abort();
+    }
+    if (mlock(ptr, size) != 0) {
+        perror("host backend warning: mlock");
+    }
+    return (char *)ptr;
+}
+
+static void host_free_pinned(char * ptr, size_t size) {
+    munlock(ptr, size);
+    munmap(ptr, size);
+}
+
+static void host_register(char * ptr, size_t size) {
+    if (mlock(ptr, size) != 0) {
+        perror("host backend warning: mlock");
+    }
+}
+
+static void host_unregister(char * ptr, size_t size) {
+    munlock(ptr, size);
+}
+
+static void host_zerocopy(int dev, char * host, size_t size) {
+    // the emulated device accesses the host memory in place
+    host_launch(dev, NULL);
+    host_sync(dev);
+    for (size_t i = 0; i < size; i++) {
+        host[i]++;
+    }
+}
+
+static void host_pipeline(bench_devbuf_t * buf, size_t chunk, int depth) {
+    // the emulated device has a single queue, chunks are processed in order
+    for (size_t off = 0; off < buf->size; off += chunk) {
+        size_t len = buf->size - off < chunk ? buf->size - off : chunk;
+        memcpy((char *)buf->ptr + off, buf->host + off, len);
+        host_launch(buf->dev, buf);
+        host_sync(buf->dev);
+        memcpy(buf->host + off, (char *)buf->ptr + off, len);
+    }
+}
+
+static void host_copy_bidir(bench_devbuf_t * to, bench_devbuf_t * from, size_t size) {
+    // a single emulated copy engine: both directions one after another
+    host_copy_h2d(to, size);
+    host_copy_d2h(from, size);
+}
+
+static int host_enable_peer(int dev, int peer) {
+    // emulated devices share the host memory
+    return 1;
+}
+
+static void host_copy_peer(bench_devbuf_t * dst, bench_devbuf_t * src, size_t size) {
+    host_sync(src->dev);
+    host_sync(dst->dev);
+    memcpy(dst->ptr, src->ptr, size);
+}
+
+// Arguments and grid have no effect on the emulated devices.
+static void host_launch_shape(int dev, const bench_launch_t * shape) {
+    host_launch(dev, NULL);
+}
+
+const bench_backend_t bench_backend_host = {
+    .name        = "host",
+    .init        = host_init,
+    .finalize    = host_finalize,
+    .print_info  = NULL,
+    .init_device = host_init_device,
+    .alloc       = host_alloc,
+    .free        = host_free,
+    .copy_h2d    = host_copy_h2d,
+    .copy_d2h    = host_copy_d2h,
+    .launch      = host_launch,
+    .sync        = host_sync,
+    .roundtrip   = host_roundtrip,
+    .numa_node   = NULL,
+    .host_alloc_pinned = host_alloc_pinned,
+    .host_free_pinned  = host_free_pinned,
+    .host_register     = host_register,
+    .host_unregister   = host_unregister,
+    .zerocopy          = host_zerocopy,
+    .pipeline          = host_pipeline,
+    .map_to            = NULL,
+    .unmap_from        = NULL,
+    .update_to         = NULL,
+    .update_from       = NULL,
+    .copy_bidir        = host_copy_bidir,
+    .enable_peer       = host_enable_peer,
+    .copy_peer         = host_copy_peer,
+    .launch_shape      = host_launch_shape,
+    .roundtrip_nowait  = NULL,   // copies are synchronous anyway
+    .core_numa         = NULL,
+    .pci_bus_id        = NULL,
+    .map_layout        = NULL,
+};
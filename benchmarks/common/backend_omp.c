@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "backend.h"
+
+// With BENCH_OMP_HOST_FALLBACK=N the benchmark sees N devices that all
+// offload to the initial device, i.e. the host fallback of the runtime. This
+// measures the runtime overhead (and exercises OMPT tools) without a GPU.
+static int host_fallback = 0;
+
+static int target_device(int dev) {
+    return host_fallback ? omp_get_initial_device() : dev;
+}
+
+static int target_init(void) {
+    const char * env = getenv("BENCH_OMP_HOST_FALLBACK");
+    host_fallback = env ? atoi(env) : 0;
+    if (host_fallback > BENCH_MAX_DEVICES) {
+        host_fallback = BENCH_MAX_DEVICES;
+    }
+    if (host_fallback > 0) {
+        return host_fallback;
+    }
+    host_fallback = 0;
+    return omp_get_num_devices();
+}
+
+static void target_finalize(void) {
+}
+
+static void target_init_device(int dev) {
+    // nothing to do, the runtime initializes the device on first use
+}
+
+static void target_alloc(bench_devbuf_t * buf) {
+    buf->ptr = omp_target_alloc(buf->size, target_device(buf->dev));
+    if (buf->ptr == NULL) {
+        fprintf(stderr, "OpenMP error: omp_target_alloc of %zu bytes on device %d failed\n", buf->size, buf->dev);
+        abort();
+    }
+}
+
+static void target_free(bench_devbuf_t * buf) {
+    omp_target_free(buf->ptr, target_device(buf->dev));
+    buf->ptr = NULL;
+}
+
+static void target_copy_h2d(bench_devbuf_t * buf, size_t size) {
+    omp_target_memcpy(buf->ptr, buf->host, size, 0, 0, target_device(buf->dev), omp_get_initial_device());
+}
+
+static void target_copy_d2h(bench_devbuf_t * buf, size_t size) {
+    omp_target_memcpy(buf->host, buf->ptr, size, 0, 0, omp_get_initial_device(), target_device(buf->dev));
+}
+
+static void target_launch(int dev, bench_devbuf_t * buf) {
+    dev = target_device(dev);
+    if (buf == NULL) {
+        #pragma omp target device(dev)
+        {
+            // do nothing
+        }
+    } else {
+        char * ptr = (char *)buf->ptr;
+        #pragma omp target device(dev) is_device_ptr(ptr)
+        {
+            // only touch single element
+            ptr[0] = 1;
+        }
+    }
+}
+
+static void target_sync(int dev) {
+    // target constructs and omp_target_memcpy are synchronous, only deferred
+    // (nowait) launches have to be waited for
+    #pragma omp taskwait
+}
+
+static void target_roundtrip(int dev, char * host, size_t size) {
+    dev = target_device(dev);
+    #pragma omp target device(dev) map(tofrom:host[0:size])
+    {
+        // only touch single element
+        host[0] = 1;
+    }
+}
+
+// Page-locked memory via the pinned allocator trait. Without a null
+// fallback, an allocator that cannot pin would silently return pageable memory.
+static omp_allocator_handle_t pinned_allocator(void) {
+    static omp_allocator_handle_t allocator = omp_null_allocator;
+    #pragma omp critical (bench_omp_pinned)
+    {
+        if (allocator == omp_null_allocator) {
+            omp_alloctrait_t traits[] = {
+                { omp_atk_pinned, omp_atv_true },
+                { omp_atk_fallback, omp_atv_null_fb },
+            };
+            allocator = omp_init_allocator(omp_default_mem_space, 2, traits);
+        }
+    }
+    return allocator;
+}
+
+static char * target_host_alloc_pinned(size_t size) {
+    char * ptr = (char *)omp_alloc(size, pinned_allocator());
+    if (ptr == NULL) {
+        fprintf(stderr, "OpenMP error: pinned allocation of %zu bytes failed\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+static void target_host_free_pinned(char * ptr, size_t size) {
+    omp_free(ptr, pinned_allocator());
+}
+
+// The host buffer is associated with the device memory of buf, so that
+// every chunk moves into buf->ptr by deferred target updates and the kernel
+// touches it through the device pointer. The calling thread generates all
+// tasks in a team of its own, so no other thread of the benchmark team can
+// execute them and every transfer is issued from the measured core; the
+// overlap comes from the runtime completing deferred target tasks
+// asynchronously (hidden helper threads in LLVM). All stages of a chunk
+// depend on the same slot, so chunk i waits for chunk i - depth while chunks
+// in different slots overlap. The host fallback shares host memory, there is
+// nothing to associate and the updates do not move data.
+static void target_pipeline(bench_devbuf_t * buf, size_t chunk, int depth) {
+    int dev = target_device(buf->dev);
+    int associate = (dev != omp_get_initial_device());
+    char * host = buf->host;
+    char * ptr = (char *)buf->ptr;
+    if (associate && omp_target_associate_ptr(host, ptr, buf->size, 0, dev) != 0) {
+        fprintf(stderr, "OpenMP error: could not associate %zu bytes of host memory with device %d\n",
+                buf->size, buf->dev);
+        abort();
+    }
+    // dependence objects only, some compilers do not count depend clauses as use
+    char slots[BENCH_MAX_PIPELINE_DEPTH];
+    (void)slots;
+    #pragma omp parallel num_threads(1)
+    {
+        size_t i = 0;
+        for (size_t off = 0; off < buf->size; off += chunk, i++) {
+            size_t len = buf->size - off < chunk ? buf->size - off : chunk;
+            int slot = (int)(i % depth);
+            #pragma omp target update device(dev) to(host[off:len]) nowait depend(inout:slots[slot])
+            #pragma omp target device(dev) is_device_ptr(ptr) firstprivate(off) nowait depend(inout:slots[slot])
+            {
+                // only touch single element
+                ptr[off] = 1;
+            }
+            #pragma omp target update device(dev) from(host[off:len]) nowait depend(inout:slots[slot])
+        }
+        #pragma omp taskwait
+    }
+    if (associate) {
+        omp_target_disassociate_ptr(host, dev);
+    }
+}
+
+// Standalone data directives on host[0:size]. Host pointer and size are
+// passed as parameters since compilers without offloading support drop the
+// clauses and would warn about otherwise unused locals.
+enum target_data_op { TARGET_MAP_TO, TARGET_UNMAP_FROM, TARGET_UPDATE_TO, TARGET_UPDATE_FROM };
+
+static void target_data(int op, int dev, char * host, size_t size) {
+    dev = target_device(dev);
+    switch (op) {
+        case TARGET_MAP_TO: {
+            #pragma omp target enter data device(dev) map(to:host[0:size])
+        } break;
+        case TARGET_UNMAP_FROM: {
+            #pragma omp target exit data device(dev) map(from:host[0:size])
+        } break;
+        case TARGET_UPDATE_TO: {
+            #pragma omp target update device(dev) to(host[0:size])
+        } break;
+        case TARGET_UPDATE_FROM: {
+            #pragma omp target update device(dev) from(host[0:size])
+        } break;
+    }
+}
+
+static void target_map_to(bench_devbuf_t * buf) {
+    target_data(TARGET_MAP_TO, buf->dev, buf->host, buf->size);
+}
+
+static void target_unmap_from(bench_devbuf_t * buf) {
+    target_data(TARGET_UNMAP_FROM, buf->dev, buf->host, buf->size);
+}
+
+static void target_update_to(bench_devbuf_t * buf) {
+    target_data(TARGET_UPDATE_TO, buf->dev, buf->host, buf->size);
+}
+
+static void target_update_from(bench_devbuf_t * buf) {
+    target_data(TARGET_UPDATE_FROM, buf->dev, buf->host, buf->size);
+}
+
+static void target_update_bidir(int dev, char * host_to, char * host_from, size_t size) {
+    #pragma omp target update device(dev) to(host_to[0:size]) nowait
+    #pragma omp target update device(dev) from(host_from[0:size]) nowait
+    #pragma omp taskwait
+}
+
+static void target_copy_bidir(bench_devbuf_t * to, bench_devbuf_t * from, size_t size) {
+    target_update_bidir(target_device(to->dev), to->host, from->host, size);
+}
+
+static void target_copy_peer(bench_devbuf_t * dst, bench_devbuf_t * src, size_t size) {
+    omp_target_memcpy(dst->ptr, src->ptr, size, 0, 0, target_device(dst->dev), target_device(src->dev));
+}
+
+// Empty target region with the given clauses, deferred if nowait is set.
+#define TARGET_PRAGMA(x) _Pragma(#x)
+#define TARGET_EMPTY(deferred, clauses)             \
+    if (deferred) {                                 \
+        TARGET_PRAGMA(omp target clauses nowait)    \
+        {                                           \
+        }                                           \
+    } else {                                        \
+        TARGET_PRAGMA(omp target clauses)           \
+        {                                           \
+        }                                           \
+    }
+
+// Scalars and pointers are passed as parameters since compilers without
+// offloading support drop the clauses and would warn about unused locals.
+static void target_scalars(int dev, int n, int nowait,
+                           double a0, double a1, double a2, double a3,
+                           double a4, double a5, double a6, double a7,
+                           double a8, double a9, double a10, double a11,
+                           double a12, double a13, double a14, double a15) {
+    switch (n) {
+        case 1:  TARGET_EMPTY(nowait, device(dev) firstprivate(a0)) break;
+        case 2:  TARGET_EMPTY(nowait, device(dev) firstprivate(a0, a1)) break;
+        case 4:  TARGET_EMPTY(nowait, device(dev) firstprivate(a0, a1, a2, a3)) break;
+        case 8:  TARGET_EMPTY(nowait, device(dev) firstprivate(a0, a1, a2, a3, a4, a5, a6, a7)) break;
+        default: TARGET_EMPTY(nowait, device(dev) firstprivate(a0, a1, a2, a3, a4, a5, a6, a7,
+                                                               a8, a9, a10, a11, a12, a13, a14, a15)) break;
+    }
+}
+
+static void target_pointers(int dev, int n, int nowait,
+                            char * p0, char * p1, char * p2, char * p3,
+                            char * p4, char * p5, char * p6, char * p7) {
+    switch (n) {
+        case 1:  TARGET_EMPTY(nowait, device(dev) map(tofrom:p0[0:1])) break;
+        case 2:  TARGET_EMPTY(nowait, device(dev) map(tofrom:p0[0:1], p1[0:1])) break;
+        case 4:  TARGET_EMPTY(nowait, device(dev) map(tofrom:p0[0:1], p1[0:1], p2[0:1], p3[0:1])) break;
+        default: TARGET_EMPTY(nowait, device(dev) map(tofrom:p0[0:1], p1[0:1], p2[0:1], p3[0:1],
+                                                                p4[0:1], p5[0:1], p6[0:1], p7[0:1])) break;
+    }
+}
+
+static void target_grid(int dev, int teams, int threads, int nowait) {
+    if (teams == BENCH_LAUNCH_FULL) {
+        // the runtime picks the grid for a large loop
+        int n = 1 << 24;
+        if (nowait) {
+            #pragma omp target teams distribute parallel for device(dev) nowait
+            for (int i = 0; i < n; i++) {
+                // do nothing
+            }
+        } else {
+            #pragma omp target teams distribute parallel for device(dev)
+            for (int i = 0; i < n; i++) {
+                // do nothing
+            }
+        }
+    } else {
+        int n = teams * threads;
+        if (nowait) {
+            #pragma omp target teams distribute parallel for device(dev) num_teams(teams) thread_limit(threads) nowait
+            for (int i = 0; i < n; i++) {
+                // do nothing
+            }
+        } else {
+            #pragma omp target teams distribute parallel for device(dev) num_teams(teams) thread_limit(threads)
+            for (int i = 0; i < n; i++) {
+                // do nothing
+            }
+        }
+    }
+}
+
+// Only one component per launch: arguments are passed to a plain target
+// region, grids use an empty teams loop.
+static void target_launch_shape(int dev, const bench_launch_t * shape) {
+    dev = target_device(dev);
+    if (shape->nscalars > 0) {
+        double v = 1.0;
+        target_scalars(dev, shape->nscalars, shape->nowait,
+                       v, v, v, v, v, v, v, v, v, v, v, v, v, v, v, v);
+    } else if (shape->nptrs > 0) {
+        char * p[BENCH_MAX_LAUNCH_PTRS];
+        for (int i = 0; i < BENCH_MAX_LAUNCH_PTRS; i++) {
+            p[i] = shape->bufs[i < shape->nptrs ? i : 0].host;
+        }
+        target_pointers(dev, shape->nptrs, shape->nowait, p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+    } else if (shape->teams != 0) {
+        target_grid(dev, shape->teams, shape->threads, shape->nowait);
+    } else {
+        TARGET_EMPTY(shape->nowait, device(dev))
+    }
+}
+
+// The stages depend on the first byte of the buffer to keep them in order.
+static void target_roundtrip_deferred(int dev, char * host, size_t size) {
+    #pragma omp target update device(dev) to(host[0:size]) nowait depend(inout:host[0])
+    #pragma omp target device(dev) map(alloc:host[0:size]) nowait depend(inout:host[0])
+    {
+        // only touch single element
+        host[0] = 1;
+    }
+    #pragma omp target update device(dev) from(host[0:size]) nowait depend(inout:host[0])
+}
+
+static void target_roundtrip_nowait(bench_devbuf_t * buf) {
+    target_roundtrip_deferred(target_device(buf->dev), buf->host, buf->size);
+}
+
+// User-defined mappers are part of OpenMP 5.0. The struct itself is only
+// copied to the device (to and from decay to release on exit), its data
+// in both directions. The mapper is named, a default mapper would also
+// deep-copy the structs of the manual deep copy.
+#if defined(_OPENMP) && _OPENMP >= 201811
+#define TARGET_HAVE_MAPPER
+#pragma omp declare mapper(deep_copy: bench_node_t n) map(to:n) map(n.data[0:n.len])
+#endif
+
+// The rows are updated as non-contiguous array section of the mapped
+// storage since map clauses require contiguous sections. The array is a
+// parameter for the same reason as in target_data.
+static void target_layout_strided(int dev, size_t rows, size_t width, size_t stride, char (*a)[stride]) {
+    #pragma omp target enter data device(dev) map(alloc:a[0:rows][0:stride])
+    #pragma omp target update device(dev) to(a[0:rows][0:width])
+    #pragma omp target update device(dev) from(a[0:rows][0:width])
+    #pragma omp target exit data device(dev) map(release:a[0:rows][0:stride])
+}
+
+// Separate buffers of w bytes as list items of a single map clause.
+#define TARGET_MAP_PIECES(...)                                                  \
+    {                                                                           \
+        TARGET_PRAGMA(omp target enter data device(dev) map(to:__VA_ARGS__))    \
+        TARGET_PRAGMA(omp target exit data device(dev) map(from:__VA_ARGS__))   \
+    }
+
+static void target_layout_pieces(int dev, int n, size_t w,
+                                 char * p0, char * p1, char * p2, char * p3,
+                                 char * p4, char * p5, char * p6, char * p7,
+                                 char * p8, char * p9, char * p10, char * p11,
+                                 char * p12, char * p13, char * p14, char * p15) {
+    switch (n) {
+        case 1:  TARGET_MAP_PIECES(p0[0:w]) break;
+        case 2:  TARGET_MAP_PIECES(p0[0:w], p1[0:w]) break;
+        case 4:  TARGET_MAP_PIECES(p0[0:w], p1[0:w], p2[0:w], p3[0:w]) break;
+        case 8:  TARGET_MAP_PIECES(p0[0:w], p1[0:w], p2[0:w], p3[0:w], p4[0:w], p5[0:w], p6[0:w], p7[0:w]) break;
+        default: TARGET_MAP_PIECES(p0[0:w], p1[0:w], p2[0:w], p3[0:w], p4[0:w], p5[0:w], p6[0:w], p7[0:w],
+                                   p8[0:w], p9[0:w], p10[0:w], p11[0:w], p12[0:w], p13[0:w], p14[0:w], p15[0:w]) break;
+    }
+}
+
+#ifdef TARGET_HAVE_MAPPER
+static void target_layout_mapper(int dev, size_t n, bench_node_t * nodes) {
+    #pragma omp target enter data device(dev) map(mapper(deep_copy), to:nodes[0:n])
+    #pragma omp target exit data device(dev) map(mapper(deep_copy), from:nodes[0:n])
+}
+#endif
+
+// Manual deep copy: the structs first, then the data of every struct, which
+// attaches the device copy of the data to the pointer member.
+static void target_layout_deep(int dev, size_t n, bench_node_t * nodes) {
+    #pragma omp target enter data device(dev) map(to:nodes[0:n])
+    for (size_t i = 0; i < n; i++) {
+        #pragma omp target enter data device(dev) map(to:nodes[i].data[0:nodes[i].len])
+    }
+    for (size_t i = 0; i < n; i++) {
+        #pragma omp target exit data device(dev) map(from:nodes[i].data[0:nodes[i].len])
+    }
+    #pragma omp target exit data device(dev) map(release:nodes[0:n])
+}
+
+static int target_map_layout(const bench_layout_t * layout) {
+    int dev = target_device(layout->dev);
+    switch (layout->kind) {
+        case BENCH_LAYOUT_STRIDED:
+            target_layout_strided(dev, layout->count, layout->width, layout->stride,
+                                  (char (*)[layout->stride])layout->host);
+            return 0;
+        case BENCH_LAYOUT_PIECES: {
+            char * p[BENCH_MAX_LAYOUT_PIECES];
+            for (int i = 0; i < BENCH_MAX_LAYOUT_PIECES; i++) {
+                p[i] = layout->nodes[(size_t)i < layout->count ? i : 0].data;
+            }
+            target_layout_pieces(dev, (int)layout->count, layout->width, p[0], p[1], p[2], p[3], p[4], p[5],
+                                 p[6], p[7], p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
+            return 0;
+        }
+#ifdef TARGET_HAVE_MAPPER
+        case BENCH_LAYOUT_MAPPER:
+            target_layout_mapper(dev, layout->count, layout->nodes);
+            return 0;
+#endif
+        case BENCH_LAYOUT_DEEP:
+            target_layout_deep(dev, layout->count, layout->nodes);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+const bench_backend_t bench_backend_omp = {
+    .name        = "omp",
+    .init        = target_init,
+    .finalize    = target_finalize,
+    .print_info  = NULL,
+    .init_device = target_init_device,
+    .alloc       = target_alloc,
+    .free        = target_free,
+    .copy_h2d    = target_copy_h2d,
+    .copy_d2h    = target_copy_d2h,
+    .launch      = target_launch,
+    .sync        = target_sync,
+    .roundtrip   = target_roundtrip,
+    .numa_node   = NULL,
+    .host_alloc_pinned = target_host_alloc_pinned,
+    .host_free_pinned  = target_host_free_pinned,
+    .host_register     = NULL,   // no portable way to page-lock existing memory
+    .host_unregister   = NULL,
+    .zerocopy          = NULL,   // requires unified shared memory
+    .pipeline          = target_pipeline,
+    .map_to            = target_map_to,
+    .unmap_from        = target_unmap_from,
+    .update_to         = target_update_to,
+    .update_from       = target_update_from,
+    .copy_bidir        = target_copy_bidir,
+    .enable_peer       = NULL,   // up to the runtime
+    .copy_peer         = target_copy_peer,
+    .launch_shape      = target_launch_shape,
+    .roundtrip_nowait  = target_roundtrip_nowait,
+    .core_numa         = NULL,
+    .pci_bus_id        = NULL,
+    .map_layout        = target_map_layout,
+};
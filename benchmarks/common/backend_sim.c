@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "backend.h"
+
+// Simulated devices: operations take the time a topology model predicts, so
+// the harness produces synthetic but structured matrices on machines without
+// GPUs. Device memory is host memory, and copies only move the first and last
+// byte (so that wrong sizes still fault) and then spin until the modeled time
+// has passed. All operations complete synchronously.
+//
+// The topology is read from the file given by BENCH_SIM_TOPOLOGY, one
+// setting per line ('#' starts a comment):
+//   nodes 2                    number of simulated NUMA domains
+//   devices 4                  number of devices
+//   cores_per_node 12          core (OpenMP thread) c is in domain c / cores_per_node
+//   home 0 0 1 1               NUMA domain every device is attached to
+//   latency_local 5            launch latency from the home domain (us)
+//   latency_remote 8           launch latency from any other domain (us)
+//   latency 1 8 8 5 5          launch latency from domain 1 to every device (us)
+//   bandwidth_local 24         copy bandwidth from the home domain (GB/s)
+//   bandwidth_remote 16        copy bandwidth from any other domain (GB/s)
+//   bandwidth 0 24 24 16 16    copy bandwidth from domain 0 to every device (GB/s)
+//   link 24                    bandwidth of each device link, shared by concurrent copies (GB/s)
+//   copy_latency 2             fixed cost of every copy (us)
+//   alloc 10                   cost of a device allocation (us)
+//   noise 0.02                 relative uniform jitter of every operation
+// Without a file, the defaults below describe two domains with two devices each.
+
+#define SIM_MAX_NODES 16
+
+typedef struct sim_topology {
+    int nnodes;
+    int ndev;
+    int cores_per_node;
+    int home[BENCH_MAX_DEVICES];
+    double latency[SIM_MAX_NODES][BENCH_MAX_DEVICES];      // sec
+    double bandwidth[SIM_MAX_NODES][BENCH_MAX_DEVICES];    // bytes/sec
+    double latency_local, latency_remote;
+    double bandwidth_local, bandwidth_remote;
+    double link;
+    double copy_latency;
+    double alloc;
+    double noise;
+} sim_topology_t;
+
+static sim_topology_t sim;
+
+// concurrent copies per device link
+static int sim_active[BENCH_MAX_DEVICES];
+
+// per-thread state of the jitter generator
+static __thread unsigned int sim_seed;
+static __thread int sim_seeded;
+
+static void sim_defaults(void) {
+    memset(&sim, 0, sizeof(sim));
+    sim.nnodes = 2;
+    sim.ndev = 4;
+    sim.cores_per_node = 0;
+    for (int d = 0; d < BENCH_MAX_DEVICES; d++) {
+        sim.home[d] = -1;
+        for (int n = 0; n < SIM_MAX_NODES; n++) {
+            sim.latency[n][d] = -1.0;
+            sim.bandwidth[n][d] = -1.0;
+        }
+    }
+    sim.latency_local = 5e-6;
+    sim.latency_remote = 8e-6;
+    sim.bandwidth_local = 24e9;
+    sim.bandwidth_remote = 16e9;
+    sim.link = 24e9;
+    sim.copy_latency = 2e-6;
+    sim.alloc = 10e-6;
+    sim.noise = 0.02;
+}
+
+// Read the values of a line into v (at most max), return their number.
+static int sim_values(char * p, double * v, int max) {
+    int n = 0;
+    while (n < max) {
+        char * end;
+        double x = strtod(p, &end);
+        if (end == p) {
+            break;
+        }
+        v[n++] = x;
+        p = end;
+    }
+    return n;
+}
+
+static void sim_read_topology(const char * path) {
+    FILE * f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "sim backend error: could not open topology file '%s'\n", path);
+        exit(EXIT_FAILURE);
+    }
+    char line[1024];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        char * hash = strchr(line, '#');
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+        char key[64];
+        int len = 0;
+        if (sscanf(line, "%63s%n", key, &len) != 1) {
+            continue;
+        }
+        double v[BENCH_MAX_DEVICES + 1];
+        int n = sim_values(line + len, v, BENCH_MAX_DEVICES + 1);
+        if (n == 0) {
+            fprintf(stderr, "sim backend error: %s:%d: missing value for '%s'\n", path, lineno, key);
+            exit(EXIT_FAILURE);
+        }
+        if (strcmp(key, "nodes") == 0) {
+            sim.nnodes = (int)v[0];
+        } else if (strcmp(key, "devices") == 0) {
+            sim.ndev = (int)v[0];
+        } else if (strcmp(key, "cores_per_node") == 0) {
+            sim.cores_per_node = (int)v[0];
+        } else if (strcmp(key, "home") == 0) {
+            for (int d = 0; d < n && d < BENCH_MAX_DEVICES; d++) {
+                sim.home[d] = (int)v[d];
+            }
+        } else if (strcmp(key, "latency") == 0 || strcmp(key, "bandwidth") == 0) {
+            int node = (int)v[0];
+            if (node < 0 || node >= SIM_MAX_NODES) {
+                fprintf(stderr, "sim backend error: %s:%d: invalid NUMA domain %d\n", path, lineno, node);
+                exit(EXIT_FAILURE);
+            }
+            for (int d = 0; d + 1 < n; d++) {
+                if (key[0] == 'l') {
+                    sim.latency[node][d] = v[d + 1] * 1e-6;
+                } else {
+                    sim.bandwidth[node][d] = v[d + 1] * 1e9;
+                }
+            }
+        } else if (strcmp(key, "latency_local") == 0) {
+            sim.latency_local = v[0] * 1e-6;
+        } else if (strcmp(key, "latency_remote") == 0) {
+            sim.latency_remote = v[0] * 1e-6;
+        } else if (strcmp(key, "bandwidth_local") == 0) {
+            sim.bandwidth_local = v[0] * 1e9;
+        } else if (strcmp(key, "bandwidth_remote") == 0) {
+            sim.bandwidth_remote = v[0] * 1e9;
+        } else if (strcmp(key, "link") == 0) {
+            sim.link = v[0] * 1e9;
+        } else if (strcmp(key, "copy_latency") == 0) {
+            sim.copy_latency = v[0] * 1e-6;
+        } else if (strcmp(key, "alloc") == 0) {
+            sim.alloc = v[0] * 1e-6;
+        } else if (strcmp(key, "noise") == 0) {
+            sim.noise = v[0];
+        } else {
+            fprintf(stderr, "sim backend error: %s:%d: unknown setting '%s'\n", path, lineno, key);
+            exit(EXIT_FAILURE);
+        }
+    }
+    fclose(f);
+}
+
+static int sim_init(void) {
+    sim_defaults();
+    const char * path = getenv("BENCH_SIM_TOPOLOGY");
+    if (path != NULL && path[0] != '\0') {
+        sim_read_topology(path);
+    }
+    if (sim.nnodes < 1 || sim.nnodes > SIM_MAX_NODES) {
+        sim.nnodes = sim.nnodes < 1 ? 1 : SIM_MAX_NODES;
+    }
+    if (sim.ndev < 0 || sim.ndev > BENCH_MAX_DEVICES) {
+        sim.ndev = sim.ndev < 0 ? 0 : BENCH_MAX_DEVICES;
+    }
+    if (sim.cores_per_node < 1) {
+        int per_node = omp_get_num_procs() / sim.nnodes;
+        sim.cores_per_node = per_node > 0 ? per_node : 1;
+    }
+
+    // Fill in what the topology left open from the home domains.
+    for (int d = 0; d < sim.ndev; d++) {
+        if (sim.home[d] < 0 || sim.home[d] >= sim.nnodes) {
+            sim.home[d] = d * sim.nnodes / (sim.ndev > 0 ? sim.ndev : 1);
+        }
+        for (int n = 0; n < sim.nnodes; n++) {
+            if (sim.latency[n][d] < 0.0) {
+                sim.latency[n][d] = n == sim.home[d] ? sim.latency_local : sim.latency_remote;
+            }
+            if (sim.bandwidth[n][d] <= 0.0) {
+                sim.bandwidth[n][d] = n == sim.home[d] ? sim.bandwidth_local : sim.bandwidth_remote;
+            }
+        }
+        sim_active[d] = 0;
+    }
+    return sim.ndev;
+}
+
+static void sim_finalize(void) {
+}
+
+static void sim_print_info(FILE * out) {
+    fprintf(out, "simulated topology: %d NUMA domains, %d cores per domain, %d devices\n",
+            sim.nnodes, sim.cores_per_node, sim.ndev);
+    fprintf(out, "device home domains:");
+    for (int d = 0; d < sim.ndev; d++) {
+        fprintf(out, " %d", sim.home[d]);
+    }
+    fprintf(out, "\n");
+    fprintf(out, "link bandwidth: %.2f GB/s, copy latency: %.2f us, allocation: %.2f us, noise: %.2f\n",
+            sim.link / 1e9, sim.copy_latency * 1e6, sim.alloc * 1e6, sim.noise);
+}
+
+static void sim_init_device(int dev) {
+    // nothing to do
+}
+
+// Simulated NUMA domain of the calling thread
+static int sim_node(void) {
+    int node = omp_get_thread_num() / sim.cores_per_node;
+    return node < sim.nnodes ? node : node % sim.nnodes;
+}
+
+// Spin until duration (with jitter) has passed since start.
+static void sim_wait(double start, double duration) {
+    if (!sim_seeded) {
+        sim_seed = 12345u + 7919u * (unsigned int)omp_get_thread_num();
+        sim_seeded = 1;
+    }
+    double jitter = (double)rand_r(&sim_seed) / RAND_MAX * 2.0 - 1.0;
+    duration *= 1.0 + sim.noise * jitter;
+    while (omp_get_wtime() - start < duration) {
+        // busy wait like a runtime polling for completion
+    }
+}
+
+// Copy over the link of dev, sharing it with the copies already in flight.
+static void sim_copy(int dev, char * dst, const char * src, size_t size) {
+    double start = omp_get_wtime();
+    int active;
+    #pragma omp atomic capture
+    active = ++sim_active[dev];
+    double bw = sim.bandwidth[sim_node()][dev];
+    if (sim.link / active < bw) {
+        bw = sim.link / active;
+    }
+    if (size > 0) {
+        dst[0] = src[0];
+        dst[size - 1] = src[size - 1];
+    }
+    sim_wait(start, sim.copy_latency + size / bw);
+    #pragma omp atomic
+    sim_active[dev]--;
+}
+
+static void sim_alloc(bench_devbuf_t * buf) {
+    double start = omp_get_wtime();
+    buf->ptr = malloc(buf->size);
+    if (buf->ptr == NULL) {
+        fprintf(stderr, "sim backend error: allocation of %zu bytes failed\n", buf->size);
+        abort();
+    }
+    sim_wait(start, sim.alloc);
+}
+
+static void sim_free(bench_devbuf_t * buf) {
+    free(buf->ptr);
+    buf->ptr = NULL;
+}
+
+static void sim_copy_h2d(bench_devbuf_t * buf, size_t size) {
+    sim_copy(buf->dev, (char *)buf->ptr, buf->host, size);
+}
+
+static void sim_copy_d2h(bench_devbuf_t * buf, size_t size) {
+    sim_copy(buf->dev, buf->host, (const char *)buf->ptr, size);
+}
+
+static void sim_launch(int dev, bench_devbuf_t * buf) {
+    sim_wait(omp_get_wtime(), sim.latency[sim_node()][dev]);
+}
+
+static void sim_sync(int dev) {
+    // all operations are synchronous
+}
+
+static void sim_roundtrip(int dev, char * host, size_t size) {
+    bench_devbuf_t buf = { dev, host, size, NULL };
+    sim_alloc(&buf);
+    sim_copy_h2d(&buf, size);
+    sim_launch(dev, &buf);
+    sim_copy_d2h(&buf, size);
+    sim_free(&buf);
+}
+
+static int sim_numa_node(int dev) {
+    return sim.home[dev];
+}
+
+static void sim_launch_shape(int dev, const bench_launch_t * shape) {
+    sim_launch(dev, NULL);
+}
+
+static int sim_core_numa(int core) {
+    int node = core / sim.cores_per_node;
+    return node < sim.nnodes ? node : node % sim.nnodes;
+}
+
+const bench_backend_t bench_backend_sim = {
+    .name        = "sim",
+    .init        = sim_init,
+    .finalize    = sim_finalize,
+    .print_info  = sim_print_info,
+    .init_device = sim_init_device,
+    .alloc       = sim_alloc,
+    .free        = sim_free,
+    .copy_h2d    = sim_copy_h2d,
+    .copy_d2h    = sim_copy_d2h,
+    .launch      = sim_launch,
+    .sync        = sim_sync,
+    .roundtrip   = sim_roundtrip,
+    .numa_node   = sim_numa_node,
+    .host_alloc_pinned = NULL,
+    .host_free_pinned  = NULL,
+    .host_register     = NULL,
+    .host_unregister   = NULL,
+    .zerocopy          = NULL,
+    .pipeline          = NULL,
+    .map_to            = NULL,
+    .unmap_from        = NULL,
+    .update_to         = NULL,
+    .update_from       = NULL,
+    .copy_bidir        = NULL,
+    .enable_peer       = NULL,
+    .copy_peer         = NULL,
+    .launch_shape      = sim_launch_shape,
+    .roundtrip_nowait  = NULL,
+    .core_numa         = sim_core_numa,
+    .pci_bus_id        = NULL,
+    .map_layout        = NULL,
+};
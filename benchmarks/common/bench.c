@@ -0,0 +1,519 @@
+#define _GNU_SOURCE
+#include <float.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "bench.h"
+
+// Choose the cores the sweep measures (BENCH_SWEEP_CORES) and the
+// representative of every other core: the nearest chosen core of the same
+// NUMA domain or L3 cache.
+static void setup_sweep(bench_context_t * ctx, const char * spec) {
+    int ncores = ctx->ncores;
+    int * group = (int *)malloc(ncores * sizeof(int));
+    int * picked = (int *)calloc(ncores, sizeof(int));
+    int per_group = 1;
+    const char * colon = strchr(spec, ':');
+    if (colon != NULL) {
+        per_group = atoi(colon + 1) > 0 ? atoi(colon + 1) : 1;
+    }
+    // A group is identified by its first core. L3 groups never span NUMA
+    // domains; without cache information they are the NUMA domains.
+    int by_l3 = strncmp(spec, "l3", 2) == 0;
+    int * l3 = (int *)malloc(ncores * sizeof(int));
+    for (int c = 0; c < ncores; c++) {
+        l3[c] = by_l3 ? bench_l3_of_cpu(ctx->core_cpu[c]) : -1;
+        group[c] = c;
+        for (int o = c - 1; o >= 0; o--) {
+            if (ctx->core_numa[o] == ctx->core_numa[c] && l3[o] == l3[c]) {
+                group[c] = group[o];
+            }
+        }
+    }
+    free(l3);
+
+    if (strcmp(spec, "all") == 0) {
+        for (int c = 0; c < ncores; c++) {
+            picked[c] = 1;
+        }
+    } else if (by_l3 || strncmp(spec, "numa", 4) == 0) {
+        // per_group cores spread evenly over the members of every group
+        for (int c = 0; c < ncores; c++) {
+            int index = 0, size = 0;
+            for (int o = 0; o < ncores; o++) {
+                if (group[o] == group[c]) {
+                    index += o < c;
+                    size++;
+                }
+            }
+            int n = per_group < size ? per_group : size;
+            for (int i = 0; i < n; i++) {
+                if (index == i * size / n) {
+                    picked[c] = 1;
+                }
+            }
+        }
+    } else {
+        int * sel = (int *)malloc(ncores * sizeof(int));
+        int nsel = bench_select_cores(spec, ncores, ctx->core_numa, sel);
+        for (int i = 0; i < nsel; i++) {
+            picked[sel[i]] = 1;
+        }
+        free(sel);
+        // every NUMA domain needs at least one measured core
+        for (int c = 0; c < ncores; c++) {
+            int covered = 0;
+            for (int o = 0; o < ncores; o++) {
+                covered |= picked[o] && group[o] == group[c];
+            }
+            picked[c] |= !covered;
+        }
+    }
+
+    ctx->nsampled = 0;
+    for (int c = 0; c < ncores; c++) {
+        int best = c;
+        for (int o = 0; o < ncores && !picked[c]; o++) {
+            if (picked[o] && group[o] == group[c] && (best == c || abs(o - c) < abs(best - c))) {
+                best = o;
+            }
+        }
+        ctx->core_rep[c] = best;
+        ctx->nsampled += picked[c];
+    }
+    free(group);
+    free(picked);
+}
+
+void bench_init(bench_context_t * ctx, const char * benchmark, int reps) {
+    ctx->benchmark = benchmark;
+    ctx->run = getenv("BENCH_RUN");
+    const char * name = getenv("BENCH_BACKEND");
+    ctx->backend = bench_backend_find(name);
+    if (ctx->backend == NULL) {
+        fprintf(stderr, "unknown backend '%s', available backends: ", name);
+        bench_backend_list(stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    // Determine number of cores and devices.
+    ctx->ndev = ctx->backend->init();
+    ctx->ncores = omp_get_num_procs();
+    const char * env = getenv("BENCH_CORES");
+    if (env != NULL && atoi(env) > 0 && atoi(env) < ctx->ncores) {
+        ctx->ncores = atoi(env);
+    }
+    env = getenv("BENCH_DEVICES");
+    if (env != NULL && atoi(env) >= 0 && atoi(env) < ctx->ndev) {
+        ctx->ndev = atoi(env);
+    }
+    env = getenv("BENCH_REPS");
+    if (env != NULL && atoi(env) > 0) {
+        reps = atoi(env);
+    }
+    ctx->reps = reps;
+    env = getenv("BENCH_MIN_REPS");
+    ctx->min_reps = env ? atoi(env) : 10;
+    if (ctx->min_reps < 1 || ctx->min_reps > reps) {
+        ctx->min_reps = reps;
+    }
+    env = getenv("BENCH_CI_TARGET");
+    ctx->ci_target = env ? atof(env) : 0.0;
+
+    // Preallocate the sample buffers (first-touch by the owning thread) so
+    // that no allocation happens inside the timed region.
+    ctx->samples = (double **)malloc(ctx->ncores * sizeof(double *));
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        int cur_thread = omp_get_thread_num();
+        ctx->samples[cur_thread] = (double *)malloc(reps * sizeof(double));
+        memset(ctx->samples[cur_thread], 0, reps * sizeof(double));
+    }
+
+    ctx->core_numa = (int *)malloc(ctx->ncores * sizeof(int));
+    ctx->core_cpu = (int *)malloc(ctx->ncores * sizeof(int));
+    bench_thread_numa(ctx, ctx->core_numa);
+    if (ctx->backend->core_numa != NULL) {
+        for (int c = 0; c < ctx->ncores; c++) {
+            ctx->core_numa[c] = ctx->backend->core_numa(c);
+        }
+    }
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        ctx->core_cpu[omp_get_thread_num()] = sched_getcpu();
+    }
+    env = getenv("BENCH_SWEEP_VERIFY");
+    ctx->sweep_verify = env != NULL && atoi(env) != 0;
+    const char * sweep_spec = getenv("BENCH_SWEEP_CORES");
+    ctx->core_rep = (int *)malloc(ctx->ncores * sizeof(int));
+    setup_sweep(ctx, sweep_spec ? sweep_spec : "all");
+    if (gethostname(ctx->hostname, sizeof(ctx->hostname)) != 0) {
+        strcpy(ctx->hostname, "unknown");
+    }
+    ctx->hostname[sizeof(ctx->hostname) - 1] = '\0';
+    bench_topology_discover(ctx);
+    bench_output_open(ctx);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "hostname: %s\n", ctx->hostname);
+    if (ctx->run != NULL) {
+        fprintf(stdout, "run: %s\n", ctx->run);
+    }
+    fprintf(stdout, "backend: %s\n", ctx->backend->name);
+    fprintf(stdout, "number of cores:   %d\n", ctx->ncores);
+    fprintf(stdout, "number of devices: %d\n", ctx->ndev);
+    fprintf(stdout, "number of repetitions: %d\n", ctx->reps);
+    if (ctx->ci_target > 0.0) {
+        fprintf(stdout, "adaptive repetitions: min %d, stop at 95%% CI within %.2f%% of mean\n",
+                ctx->min_reps, ctx->ci_target * 100.0);
+    }
+    if (ctx->nsampled < ctx->ncores) {
+        fprintf(stdout, "sweep cores: %s (%d of %d cores:", sweep_spec, ctx->nsampled, ctx->ncores);
+        for (int c = 0; c < ctx->ncores; c++) {
+            if (ctx->core_rep[c] == c) {
+                fprintf(stdout, " %d", c);
+            }
+        }
+        fprintf(stdout, ")%s\n", ctx->sweep_verify ? ", all cores measured to verify" : "");
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+    if (ctx->backend->print_info != NULL) {
+        ctx->backend->print_info(stdout);
+        fprintf(stdout, BENCH_SEPARATOR);
+    }
+    bench_topology_print(ctx, stdout);
+    fprintf(stdout, BENCH_SEPARATOR);
+    ctx->counters = bench_counters_setup(getenv("BENCH_COUNTERS"), stdout);
+    if (ctx->counters != 0) {
+        fprintf(stdout, BENCH_SEPARATOR);
+    }
+}
+
+void bench_finalize(bench_context_t * ctx) {
+    for (int i = 0; i < ctx->ncores; i++) {
+        free(ctx->samples[i]);
+    }
+    free(ctx->samples);
+    free(ctx->core_numa);
+    free(ctx->core_cpu);
+    free(ctx->core_rep);
+    bench_topology_free(ctx);
+    bench_output_close(ctx);
+    ctx->backend->finalize();
+}
+
+void bench_progress(const char * fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fflush(stderr);
+}
+
+void bench_print_affinity(const bench_context_t * ctx) {
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        omp_display_affinity(NULL);
+    }
+}
+
+void bench_warmup(bench_context_t * ctx) {
+    const bench_backend_t * be = ctx->backend;
+    fprintf(stdout, "warm up...\n");
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        for (int c = 0; c < ctx->ncores; c++) {
+            if (omp_get_thread_num() == c) {
+                for (int d = 0; d < ctx->ndev; d++) {
+                    be->init_device(d);
+                    be->launch(d, NULL);
+                    be->sync(d);
+                }
+            }
+            #pragma omp barrier
+        }
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+}
+
+void bench_sweep_cores(bench_context_t * ctx, bench_core_fn fn, void * arg) {
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        for (int c = 0; c < ctx->ncores; c++) {
+            if (!bench_core_measured(ctx, c)) {
+                continue;
+            }
+            if (omp_get_thread_num() == c) {
+                fn(ctx, c, arg);
+            }
+            #pragma omp barrier
+        }
+    }
+}
+
+int bench_core_measured(const bench_context_t * ctx, int core) {
+    return ctx->sweep_verify || ctx->core_rep[core] == core;
+}
+
+void bench_sweep_fill(const bench_context_t * ctx, void * base, size_t elem_size) {
+    for (int c = 0; c < ctx->ncores; c++) {
+        if (!bench_core_measured(ctx, c)) {
+            memcpy((char *)base + c * elem_size, (char *)base + ctx->core_rep[c] * elem_size, elem_size);
+        }
+    }
+}
+
+void bench_sweep_fill_rows(const bench_context_t * ctx, void ** rows, size_t row_size) {
+    for (int c = 0; c < ctx->ncores; c++) {
+        if (!bench_core_measured(ctx, c)) {
+            memcpy(rows[c], rows[ctx->core_rep[c]], row_size);
+        }
+    }
+}
+
+void bench_sweep_check(const bench_context_t * ctx, double ** m, const char * label) {
+    if (!ctx->sweep_verify || ctx->nsampled == ctx->ncores) {
+        return;
+    }
+    double ** rel = bench_matrix_alloc(ctx->ncores, ctx->ndev);
+    double max_dev = 0.0;
+    int max_core = 0, max_dev_id = 0;
+    for (int c = 0; c < ctx->ncores; c++) {
+        for (int d = 0; d < ctx->ndev; d++) {
+            double ref = m[ctx->core_rep[c]][d];
+            rel[c][d] = ref != 0.0 ? m[c][d] / ref : 1.0;
+            double dev = rel[c][d] > 1.0 ? rel[c][d] - 1.0 : 1.0 - rel[c][d];
+            if (dev > max_dev) {
+                max_dev = dev;
+                max_core = c;
+                max_dev_id = d;
+            }
+        }
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Sampling check: %s relative to the representative core\n", label);
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_print_matrix(stdout, rel, ctx->ncores, ctx->ndev, 1.0);
+    fprintf(stdout, "maximum deviation: %.2f%% (core %d, device %d, represented by core %d)\n",
+            max_dev * 100.0, max_core, max_dev_id, ctx->core_rep[max_core]);
+    bench_matrix_free(rel, ctx->ncores);
+}
+
+void bench_sample(bench_context_t * ctx, bench_rep_fn fn, void * arg, int adaptive, bench_stats_t * st) {
+    bench_sample_phases(ctx, NULL, fn, NULL, arg, adaptive, st);
+}
+
+void bench_sample_phases(bench_context_t * ctx, bench_rep_fn pre, bench_rep_fn fn, bench_rep_fn post,
+                         void * arg, int adaptive, bench_stats_t * st) {
+    double * samples = ctx->samples[omp_get_thread_num()];
+    int check = adaptive && ctx->ci_target > 0.0;
+    bench_running_t running;
+    bench_running_reset(&running);
+
+    int r = 0;
+    if (ctx->counters != 0) {
+        // discard counts of operations outside of earlier cells
+        double discard[BENCH_NCOUNTERS];
+        bench_counters_read(ctx->counters, 1.0, discard);
+    }
+    while (r < ctx->reps) {
+        if (pre != NULL) {
+            pre(arg);
+        }
+        if (ctx->counters != 0) {
+            bench_counters_enable(ctx->counters);
+        }
+        double ts = omp_get_wtime();
+        fn(arg);
+        double te = omp_get_wtime();
+        if (ctx->counters != 0) {
+            bench_counters_disable(ctx->counters);
+        }
+        if (post != NULL) {
+            post(arg);
+        }
+        samples[r++] = te - ts;
+        if (check) {
+            bench_running_add(&running, te - ts);
+            if (r >= ctx->min_reps && bench_running_rel_ci95(&running) <= ctx->ci_target) {
+                break;
+            }
+        }
+    }
+    bench_stats_compute(samples, r, st);
+    if (ctx->counters != 0) {
+        bench_counters_read(ctx->counters, r, st->counters);
+    }
+}
+
+double ** bench_matrix_alloc(int ncores, int ndev) {
+    double ** m = (double **)malloc(ncores * sizeof(double *));
+    for (int c = 0; c < ncores; c++) {
+        m[c] = (double *)calloc(ndev > 0 ? ndev : 1, sizeof(double));
+    }
+    return m;
+}
+
+void bench_matrix_free(double ** m, int ncores) {
+    for (int c = 0; c < ncores; c++) {
+        free(m[c]);
+    }
+    free(m);
+}
+
+double bench_matrix_min(double ** m, int ncores, int ndev) {
+    double min = DBL_MAX;
+    for (int c = 0; c < ncores; c++) {
+        for (int d = 0; d < ndev; d++) {
+            if (m[c][d] < min) {
+                min = m[c][d];
+            }
+        }
+    }
+    return min;
+}
+
+void bench_print_matrix(FILE * out, double ** m, int ncores, int ndev, double divisor) {
+    fprintf(out, ";");
+    for (int c = 0; c < ncores; c++) {
+        fprintf(out, "Core %d%c", c, c<ncores-1 ? ';' : '\n');
+    }
+    for (int d = 0; d < ndev; d++) {
+        fprintf(out, "GPU %d;", d);
+        for (int c = 0; c < ncores; c++) {
+            fprintf(out, "%lf%c", m[c][d] / divisor, c<ncores-1 ? ';' : '\n');
+        }
+    }
+}
+
+size_t bench_parse_size(const char * str, char ** end) {
+    char * p;
+    size_t size = (size_t)strtoull(str, &p, 10);
+    switch (*p) {
+        case 'k': case 'K': size <<= 10; p++; break;
+        case 'm': case 'M': size <<= 20; p++; break;
+        case 'g': case 'G': size <<= 30; p++; break;
+        default: break;
+    }
+    if (end != NULL) {
+        *end = p;
+    }
+    return size;
+}
+
+int bench_parse_size_list(const char * str, size_t ** sizes) {
+    int count = 1;
+    for (const char * p = str; *p; p++) {
+        if (*p == ',') {
+            count++;
+        }
+    }
+    *sizes = (size_t *)malloc(count * sizeof(size_t));
+
+    int n = 0;
+    const char * p = str;
+    while (*p && n < count) {
+        char * end;
+        size_t size = bench_parse_size(p, &end);
+        if (end == p) {
+            break;
+        }
+        if (size > 0) {
+            (*sizes)[n++] = size;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+int bench_numa_node_of_cpu(int cpu) {
+    // look for the nodeX link in sysfs
+    for (int n = 0; n < 1024; n++) {
+        FILE * f = bench_sysfs_open("/devices/system/cpu/cpu%d/node%d/cpulist", cpu, n);
+        if (f != NULL) {
+            fclose(f);
+            return n;
+        }
+    }
+    return 0;
+}
+
+int bench_l3_of_cpu(int cpu) {
+    // the cache id, or the first CPU sharing the cache on older kernels
+    int id = -1;
+    FILE * f = bench_sysfs_open("/devices/system/cpu/cpu%d/cache/index3/id", cpu);
+    if (f == NULL) {
+        f = bench_sysfs_open("/devices/system/cpu/cpu%d/cache/index3/shared_cpu_list", cpu);
+    }
+    if (f != NULL) {
+        if (fscanf(f, "%d", &id) != 1) {
+            id = -1;
+        }
+        fclose(f);
+    }
+    return id;
+}
+
+void bench_thread_numa(const bench_context_t * ctx, int * thread_numa) {
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        thread_numa[omp_get_thread_num()] = bench_numa_node_of_cpu(sched_getcpu());
+    }
+}
+
+int bench_select_cores(const char * spec, int ncores, const int * thread_numa, int * sel_cores) {
+    int * selected = (int *)calloc(ncores, sizeof(int));
+    if (strcmp(spec, "all") == 0) {
+        for (int c = 0; c < ncores; c++) {
+            selected[c] = 1;
+        }
+    } else if (strcmp(spec, "numa") == 0) {
+        for (int c = 0; c < ncores; c++) {
+            int seen = 0;
+            for (int o = 0; o < c; o++) {
+                if (selected[o] && thread_numa[o] == thread_numa[c]) {
+                    seen = 1;
+                }
+            }
+            selected[c] = !seen;
+        }
+    } else {
+        // list of cores and core ranges, e.g., "0,4,8-11"
+        const char * p = spec;
+        while (*p) {
+            char * end;
+            long lo = strtol(p, &end, 10);
+            long hi = lo;
+            if (end == p) {
+                break;
+            }
+            p = end;
+            if (*p == '-') {
+                hi = strtol(p + 1, &end, 10);
+                p = end;
+            }
+            for (long c = lo; c <= hi; c++) {
+                if (c >= 0 && c < ncores) {
+                    selected[c] = 1;
+                }
+            }
+            if (*p == ',') {
+                p++;
+            }
+        }
+    }
+
+    int nsel = 0;
+    for (int c = 0; c < ncores; c++) {
+        if (selected[c]) {
+            sel_cores[nsel++] = c;
+        }
+    }
+    free(selected);
+    return nsel;
+}
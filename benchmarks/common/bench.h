@@ -0,0 +1,124 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stdio.h>
+
+#include "affinity.h"
+#include "backend.h"
+#include "output.h"
+#include "stats.h"
+#include "topology.h"
+
+#define BENCH_SEPARATOR "---------------------------------------------------------------\n"
+
+// State shared by all benchmark drivers.
+typedef struct bench_context {
+    const char * benchmark;
+    const char * run;   // name of the experiment run (BENCH_RUN), may be NULL
+    const bench_backend_t * backend;
+    char hostname[256];
+    int * core_numa;    // NUMA domain of every core (OpenMP thread)
+    int * core_cpu;     // CPU every core (OpenMP thread) is running on
+    int * core_rep;     // core whose sweep results stand for every core (BENCH_SWEEP_CORES)
+    int nsampled;       // number of cores the sweep measures
+    int sweep_verify;   // measure all cores anyway and compare (BENCH_SWEEP_VERIFY)
+    bench_topology_t * topo; // NUMA distances, caches and device PCI locations
+    int ncores;
+    int ndev;
+    int reps;           // maximum number of repetitions per cell
+    int min_reps;       // minimum number of repetitions (BENCH_MIN_REPS)
+    double ci_target;   // relative 95% CI half-width to stop at (BENCH_CI_TARGET, 0 = off)
+    unsigned counters;  // host counters recorded per cell (BENCH_COUNTERS), bit i for counter i
+    double ** samples;  // preallocated per-thread sample buffers of reps entries
+    FILE * out;         // structured result file (BENCH_OUTPUT), may be NULL
+    int out_format;
+} bench_context_t;
+
+// Select the backend (BENCH_BACKEND environment variable, default: native
+// backend), initialize it, open the result file and print the run header.
+// BENCH_REPS overrides reps, BENCH_CORES and BENCH_DEVICES limit the number
+// of cores and devices used.
+void bench_init(bench_context_t * ctx, const char * benchmark, int reps);
+void bench_finalize(bench_context_t * ctx);
+
+// Print a progress message to stderr, keeping stdout free for results.
+void bench_progress(const char * fmt, ...);
+
+// Print the OpenMP thread affinity info.
+void bench_print_affinity(const bench_context_t * ctx);
+
+// Make sure that all threads are up and running and the devices have been
+// properly initialized by every thread.
+void bench_warmup(bench_context_t * ctx);
+
+// One-core-at-a-time sweep: thread c calls fn(ctx, c, arg) while all other
+// threads wait at a barrier. With BENCH_SWEEP_CORES only the representative
+// cores are measured ("numa" or "l3" for one core per NUMA domain or L3
+// cache, "numa:N"/"l3:N" for N spread cores each, or a list like "0,4,8-11");
+// every other core is represented by the nearest measured core of its group.
+typedef void (*bench_core_fn)(bench_context_t * ctx, int core, void * arg);
+void bench_sweep_cores(bench_context_t * ctx, bench_core_fn fn, void * arg);
+
+// Whether the sweep measured core c itself (results of other cores are
+// copies and should not be written as records).
+int bench_core_measured(const bench_context_t * ctx, int core);
+
+// Copy the results of the representative cores to the cores they stand for:
+// per core elements of elem_size bytes, or per core rows of row_size bytes.
+void bench_sweep_fill(const bench_context_t * ctx, void * base, size_t elem_size);
+void bench_sweep_fill_rows(const bench_context_t * ctx, void ** rows, size_t row_size);
+
+// With BENCH_SWEEP_VERIFY, print every core relative to its representative
+// and the maximum deviation, i.e., how well the sampling would have done.
+void bench_sweep_check(const bench_context_t * ctx, double ** m, const char * label);
+
+// Per-repetition operation timed by bench_sample.
+typedef void (*bench_rep_fn)(void * arg);
+
+// Time every repetition of fn individually into the calling thread's sample
+// buffer and compute the statistics. Runs between ctx->min_reps and
+// ctx->reps repetitions; if adaptive is set and ctx->ci_target > 0, sampling
+// stops as soon as the 95% confidence interval of the mean is narrower than
+// ci_target relative to the mean. The host counters selected by
+// BENCH_COUNTERS count the timed part of every repetition only and are
+// stored per repetition in st->counters.
+void bench_sample(bench_context_t * ctx, bench_rep_fn fn, void * arg, int adaptive, bench_stats_t * st);
+
+// Like bench_sample, but calls pre before and post after every repetition
+// of fn without timing them (either may be NULL).
+void bench_sample_phases(bench_context_t * ctx, bench_rep_fn pre, bench_rep_fn fn, bench_rep_fn post,
+                         void * arg, int adaptive, bench_stats_t * st);
+
+// Result matrices indexed by [core][device].
+double ** bench_matrix_alloc(int ncores, int ndev);
+void bench_matrix_free(double ** m, int ncores);
+double bench_matrix_min(double ** m, int ncores, int ndev);
+
+// Print a matrix as semicolon separated table (one row per device) with all
+// values divided by divisor.
+void bench_print_matrix(FILE * out, double ** m, int ncores, int ndev, double divisor);
+
+// Parse a byte count with optional K, M or G suffix (powers of 1024). If end
+// is not NULL it is set to the first character after the parsed size.
+size_t bench_parse_size(const char * str, char ** end);
+
+// Parse a list of byte counts like "8,4K,1M" into a newly allocated array.
+// Returns the number of entries.
+int bench_parse_size_list(const char * str, size_t ** sizes);
+
+// Determine the NUMA domain of a CPU (0 if unknown).
+int bench_numa_node_of_cpu(int cpu);
+
+// Determine the L3 cache of a CPU (-1 if unknown).
+int bench_l3_of_cpu(int cpu);
+
+// Determine the NUMA domain of every OpenMP thread (threads are expected to
+// be bound via OMP_PLACES/OMP_PROC_BIND).
+void bench_thread_numa(const bench_context_t * ctx, int * thread_numa);
+
+// Select cores from a specification: "all", "numa" (first core of every NUMA
+// domain) or a list like "0,4,8-11". Writes the selected core ids in
+// ascending order to sel_cores and returns their number.
+int bench_select_cores(const char * spec, int ncores, const int * thread_numa, int * sel_cores);
+
+#endif // BENCH_BENCH_H
@@ -0,0 +1,286 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#define BENCH_CONFIG_MAX_SETTINGS 1024
+#define BENCH_CONFIG_MAX_RUNS 256
+
+typedef struct bench_run {
+    char * name;
+    int first;      // index of the first setting of the section
+    int count;      // number of settings of the section
+} bench_run_t;
+
+typedef struct bench_config {
+    char * settings[BENCH_CONFIG_MAX_SETTINGS];  // "KEY=VALUE"
+    int nsettings;
+    int nglobal;                                 // settings before the first section
+    bench_run_t runs[BENCH_CONFIG_MAX_RUNS];
+    int nruns;
+    const char * cli[BENCH_CONFIG_MAX_SETTINGS]; // "KEY=VALUE" from the command line
+    int ncli;
+} bench_config_t;
+
+// Command line aliases for frequently used variables
+static const char * const aliases[][2] = {
+    { "--backend", "BENCH_BACKEND" },
+    { "--reps",    "BENCH_REPS" },
+    { "--cores",   "BENCH_CORES" },
+    { "--devices", "BENCH_DEVICES" },
+    { "--output",  "BENCH_OUTPUT" },
+};
+
+static void usage(FILE * out, const char * prog) {
+    fprintf(out, "usage: %s [options] [KEY=VALUE ...]\n", prog);
+    fprintf(out, "  -c, --config FILE   experiment file with KEY=VALUE lines and [run] sections\n");
+    fprintf(out, "  -r, --run LIST      comma separated names of the runs to execute (default: all)\n");
+    fprintf(out, "  -l, --list          list the runs of the experiment file and exit\n");
+    for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++) {
+        char option[32];
+        snprintf(option, sizeof(option), "%s VALUE", aliases[i][0]);
+        fprintf(out, "  %-19s %s=VALUE\n", option, aliases[i][1]);
+    }
+    fprintf(out, "  -h, --help          print this help\n");
+    fprintf(out, "KEY=VALUE sets any environment variable the benchmark reads (BENCH_*, BW_*, LAT_*, ...)\n");
+}
+
+static char * trim(char * str) {
+    while (isspace((unsigned char)*str)) {
+        str++;
+    }
+    char * end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return str;
+}
+
+static int valid_setting(const char * str) {
+    const char * eq = strchr(str, '=');
+    return eq != NULL && eq != str;
+}
+
+static int read_config(const char * path, bench_config_t * cfg) {
+    FILE * f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "could not open experiment file '%s'\n", path);
+        return -1;
+    }
+    char line[4096];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        char * hash = strchr(line, '#');
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+        char * str = trim(line);
+        if (*str == '\0') {
+            continue;
+        }
+        if (*str == '[') {
+            char * close = strchr(str, ']');
+            if (close == NULL || cfg->nruns >= BENCH_CONFIG_MAX_RUNS) {
+                fprintf(stderr, "%s:%d: invalid or too many run sections\n", path, lineno);
+                fclose(f);
+                return -1;
+            }
+            *close = '\0';
+            bench_run_t * r = &cfg->runs[cfg->nruns++];
+            r->name = strdup(trim(str + 1));
+            r->first = cfg->nsettings;
+            r->count = 0;
+            continue;
+        }
+        if (!valid_setting(str) || cfg->nsettings >= BENCH_CONFIG_MAX_SETTINGS) {
+            fprintf(stderr, "%s:%d: expected KEY=VALUE\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        // remove blanks around '='
+        char * eq = strchr(str, '=');
+        *eq = '\0';
+        char * key = trim(str);
+        char * value = trim(eq + 1);
+        char * setting = (char *)malloc(strlen(key) + strlen(value) + 2);
+        sprintf(setting, "%s=%s", key, value);
+        cfg->settings[cfg->nsettings++] = setting;
+        if (cfg->nruns == 0) {
+            cfg->nglobal++;
+        } else {
+            cfg->runs[cfg->nruns - 1].count++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// Environment variables changed by a run, to be restored afterwards
+typedef struct saved_env {
+    char * key;
+    char * value;   // NULL if the variable was not set
+} saved_env_t;
+
+static void apply(const char * setting, saved_env_t * saved, int * nsaved) {
+    const char * eq = strchr(setting, '=');
+    size_t len = (size_t)(eq - setting);
+    char * key = (char *)malloc(len + 1);
+    memcpy(key, setting, len);
+    key[len] = '\0';
+    const char * old = getenv(key);
+    saved[*nsaved].key = key;
+    saved[*nsaved].value = old != NULL ? strdup(old) : NULL;
+    (*nsaved)++;
+    setenv(key, eq + 1, 1);
+}
+
+static void restore(saved_env_t * saved, int nsaved) {
+    // reverse order, so that a variable set twice gets its original value
+    for (int i = nsaved - 1; i >= 0; i--) {
+        if (saved[i].value != NULL) {
+            setenv(saved[i].key, saved[i].value, 1);
+        } else {
+            unsetenv(saved[i].key);
+        }
+        free(saved[i].key);
+        free(saved[i].value);
+    }
+}
+
+static int selected(const char * list, const char * name) {
+    if (list == NULL) {
+        return 1;
+    }
+    size_t len = strlen(name);
+    const char * p = list;
+    while ((p = strstr(p, name)) != NULL) {
+        if ((p == list || p[-1] == ',') && (p[len] == '\0' || p[len] == ',')) {
+            return 1;
+        }
+        p += len;
+    }
+    return 0;
+}
+
+static int execute(bench_config_t * cfg, const bench_run_t * r, bench_run_fn run) {
+    saved_env_t * saved = (saved_env_t *)malloc((cfg->nsettings + cfg->ncli + 1) * sizeof(saved_env_t));
+    int nsaved = 0;
+    for (int i = 0; i < cfg->nglobal; i++) {
+        apply(cfg->settings[i], saved, &nsaved);
+    }
+    if (r != NULL) {
+        for (int i = r->first; i < r->first + r->count; i++) {
+            apply(cfg->settings[i], saved, &nsaved);
+        }
+        char setting[512];
+        snprintf(setting, sizeof(setting), "BENCH_RUN=%s", r->name);
+        apply(setting, saved, &nsaved);
+    }
+    for (int i = 0; i < cfg->ncli; i++) {
+        apply(cfg->cli[i], saved, &nsaved);
+    }
+
+    if (r != NULL) {
+        fprintf(stdout, "##### Run: %s\n", r->name);
+        for (int i = 0; i < nsaved; i++) {
+            fprintf(stdout, "%s=%s\n", saved[i].key, getenv(saved[i].key));
+        }
+        fflush(stdout);
+    }
+    int ret = run();
+    fflush(stdout);
+
+    restore(saved, nsaved);
+    free(saved);
+    return ret;
+}
+
+int bench_config_main(int argc, char const * argv[], const char * benchmark, bench_run_fn run) {
+    bench_config_t * cfg = (bench_config_t *)calloc(1, sizeof(bench_config_t));
+    char ** alias_settings = (char **)calloc(argc, sizeof(char *));
+    const char * config_file = NULL;
+    const char * run_list = NULL;
+    int list = 0;
+    int ret = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char * arg = argv[i];
+        int alias = -1;
+        for (size_t a = 0; a < sizeof(aliases) / sizeof(aliases[0]); a++) {
+            if (strcmp(arg, aliases[a][0]) == 0) {
+                alias = (int)a;
+            }
+        }
+        int has_value = (i + 1 < argc);
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            usage(stdout, argv[0]);
+            goto done;
+        } else if ((strcmp(arg, "-c") == 0 || strcmp(arg, "--config") == 0) && has_value) {
+            config_file = argv[++i];
+        } else if ((strcmp(arg, "-r") == 0 || strcmp(arg, "--run") == 0) && has_value) {
+            run_list = argv[++i];
+        } else if (strcmp(arg, "-l") == 0 || strcmp(arg, "--list") == 0) {
+            list = 1;
+        } else if (alias >= 0 && has_value) {
+            const char * value = argv[++i];
+            alias_settings[i] = (char *)malloc(strlen(aliases[alias][1]) + strlen(value) + 2);
+            sprintf(alias_settings[i], "%s=%s", aliases[alias][1], value);
+            cfg->cli[cfg->ncli++] = alias_settings[i];
+        } else if (valid_setting(arg) && arg[0] != '-') {
+            cfg->cli[cfg->ncli++] = arg;
+        } else {
+            fprintf(stderr, "%s: invalid argument '%s'\n", benchmark, arg);
+            usage(stderr, argv[0]);
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+    }
+
+    if (config_file != NULL && read_config(config_file, cfg) != 0) {
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+
+    if (list) {
+        for (int r = 0; r < cfg->nruns; r++) {
+            fprintf(stdout, "%s\n", cfg->runs[r].name);
+        }
+        goto done;
+    }
+
+    if (cfg->nruns == 0) {
+        ret = execute(cfg, NULL, run);
+    } else {
+        int nexecuted = 0;
+        for (int r = 0; r < cfg->nruns; r++) {
+            if (selected(run_list, cfg->runs[r].name)) {
+                int rc = execute(cfg, &cfg->runs[r], run);
+                if (rc != 0 && ret == 0) {
+                    ret = rc;
+                }
+                nexecuted++;
+            }
+        }
+        if (nexecuted == 0) {
+            fprintf(stderr, "%s: no run matches '%s'\n", benchmark, run_list);
+            ret = EXIT_FAILURE;
+        }
+    }
+
+done:
+    for (int i = 0; i < cfg->nsettings; i++) {
+        free(cfg->settings[i]);
+    }
+    for (int r = 0; r < cfg->nruns; r++) {
+        free(cfg->runs[r].name);
+    }
+    for (int i = 0; i < argc; i++) {
+        free(alias_settings[i]);
+    }
+    free(alias_settings);
+    free(cfg);
+    return ret;
+}
@@ -0,0 +1,32 @@
+#ifndef BENCH_CONFIG_H
+#define BENCH_CONFIG_H
+
+// Runtime experiment specification. All settings of the benchmarks are
+// environment variables (BENCH_*, BW_*, LAT_*, ...); this layer sets them
+// from the command line and from an experiment file and runs the benchmark
+// once per experiment, so that one binary covers a whole experiment matrix:
+//
+//   bandwidth [options] [KEY=VALUE ...]
+//     -c, --config FILE   experiment file
+//     -r, --run LIST      comma separated names of the runs to execute (default: all)
+//     -l, --list          list the runs of the experiment file and exit
+//     --backend NAME      BENCH_BACKEND
+//     --reps N            BENCH_REPS
+//     --cores N           BENCH_CORES
+//     --devices N         BENCH_DEVICES
+//     --output FILE       BENCH_OUTPUT
+//     -h, --help          print the usage
+//
+// An experiment file holds KEY=VALUE lines ('#' starts a comment). Settings
+// before the first "[name]" line apply to all runs, every section defines
+// one run. Precedence: environment < file < section < command line.
+
+// Benchmark body, called once per run between setting and restoring the
+// environment. Returns the exit code of the run.
+typedef int (*bench_run_fn)(void);
+
+// Parse the command line and the experiment file and execute the selected
+// runs. Returns the first non-zero exit code of the runs, or 0.
+int bench_config_main(int argc, char const * argv[], const char * benchmark, bench_run_fn run);
+
+#endif // BENCH_CONFIG_H
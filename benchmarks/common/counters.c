@@ -0,0 +1,209 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "counters.h"
+
+const char * const bench_counter_names[BENCH_NCOUNTERS] = {
+    "cycles", "page_faults", "context_switches", "llc_misses", "remote_accesses",
+};
+
+#ifdef __linux__
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} counter_events[BENCH_NCOUNTERS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_NODE | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+// Count kernel time (page fault handling, driver calls) unless
+// perf_event_paranoid forbids it.
+static int exclude_kernel = 0;
+
+// Open a counter of the calling thread, disabled, as member of group
+// (-1 to start a new group).
+static int counter_open(int k, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter_events[k].type;
+    attr.config = counter_events[k].config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// Counter group of a thread, opened with the mask of the current run.
+typedef struct counter_group {
+    unsigned mask;
+    int leader;
+    int nopen;
+    int fd[BENCH_NCOUNTERS];
+    int index[BENCH_NCOUNTERS];     // counter of the i-th group member
+} counter_group_t;
+
+static __thread counter_group_t thread_group = { 0, -1, 0, { 0 }, { 0 } };
+
+static void group_close(counter_group_t * g) {
+    for (int i = 0; i < g->nopen; i++) {
+        close(g->fd[i]);
+    }
+    g->nopen = 0;
+    g->leader = -1;
+    g->mask = 0;
+}
+
+static counter_group_t * group_get(unsigned mask) {
+    counter_group_t * g = &thread_group;
+    if (g->mask == mask) {
+        return g->leader >= 0 ? g : NULL;
+    }
+    group_close(g);
+    g->mask = mask;
+    for (int k = 0; k < BENCH_NCOUNTERS; k++) {
+        if (!(mask & (1u << k))) {
+            continue;
+        }
+        int fd = counter_open(k, g->leader);
+        if (fd < 0) {
+            continue;
+        }
+        if (g->leader < 0) {
+            g->leader = fd;
+        }
+        g->fd[g->nopen] = fd;
+        g->index[g->nopen] = k;
+        g->nopen++;
+    }
+    return g->leader >= 0 ? g : NULL;
+}
+
+unsigned bench_counters_setup(const char * spec, FILE * out) {
+    if (spec == NULL || spec[0] == '\0' || strcmp(spec, "0") == 0) {
+        return 0;
+    }
+    unsigned selected = 0;
+    for (int k = 0; k < BENCH_NCOUNTERS; k++) {
+        size_t len = strlen(bench_counter_names[k]);
+        for (const char * p = spec; *p; ) {
+            size_t n = strcspn(p, ",");
+            if ((n == 3 && strncmp(p, "all", 3) == 0) || (n == 1 && *p == '1')
+                || (n == len && strncmp(p, bench_counter_names[k], len) == 0)) {
+                selected |= 1u << k;
+            }
+            p += n;
+            if (*p == ',') {
+                p++;
+            }
+        }
+    }
+
+    // probe every counter on its own, without kernel counting if not permitted
+    unsigned mask = 0;
+    exclude_kernel = 0;
+    for (int k = 0; k < BENCH_NCOUNTERS; k++) {
+        if (!(selected & (1u << k))) {
+            continue;
+        }
+        int fd = counter_open(k, -1);
+        if (fd < 0 && (errno == EACCES || errno == EPERM) && !exclude_kernel) {
+            exclude_kernel = 1;
+            fd = counter_open(k, -1);
+        }
+        if (fd >= 0) {
+            mask |= 1u << k;
+            close(fd);
+        }
+    }
+
+    fprintf(out, "host counters:");
+    for (int k = 0; k < BENCH_NCOUNTERS; k++) {
+        if (mask & (1u << k)) {
+            fprintf(out, " %s", bench_counter_names[k]);
+        }
+    }
+    if (mask != 0 && exclude_kernel) {
+        fprintf(out, " (user space only)");
+    }
+    if (mask != selected) {
+        fprintf(out, ", not available:");
+        for (int k = 0; k < BENCH_NCOUNTERS; k++) {
+            if ((selected & ~mask) & (1u << k)) {
+                fprintf(out, " %s", bench_counter_names[k]);
+            }
+        }
+    }
+    fprintf(out, "\n");
+    return mask;
+}
+
+void bench_counters_enable(unsigned mask) {
+    counter_group_t * g = group_get(mask);
+    if (g != NULL) {
+        ioctl(g->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void bench_counters_disable(unsigned mask) {
+    counter_group_t * g = group_get(mask);
+    if (g != NULL) {
+        ioctl(g->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void bench_counters_read(unsigned mask, double n, double * values) {
+    memset(values, 0, BENCH_NCOUNTERS * sizeof(double));
+    counter_group_t * g = group_get(mask);
+    if (g == NULL) {
+        return;
+    }
+    // nr, time enabled, time running, one value per member
+    uint64_t buf[3 + BENCH_NCOUNTERS];
+    if (read(g->leader, buf, sizeof(buf)) < (ssize_t)(3 * sizeof(uint64_t))) {
+        return;
+    }
+    // scale if the group was multiplexed with other events
+    double scale = (buf[2] > 0 && buf[2] < buf[1]) ? (double)buf[1] / (double)buf[2] : 1.0;
+    for (uint64_t i = 0; i < buf[0] && i < (uint64_t)g->nopen; i++) {
+        values[g->index[i]] = (double)buf[3 + i] * scale / (n > 0.0 ? n : 1.0);
+    }
+    ioctl(g->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+}
+
+#else // !__linux__
+
+unsigned bench_counters_setup(const char * spec, FILE * out) {
+    if (spec != NULL && spec[0] != '\0' && strcmp(spec, "0") != 0) {
+        fprintf(out, "host counters: not available on this platform\n");
+    }
+    return 0;
+}
+
+void bench_counters_enable(unsigned mask) {
+}
+
+void bench_counters_disable(unsigned mask) {
+}
+
+void bench_counters_read(unsigned mask, double n, double * values) {
+    memset(values, 0, BENCH_NCOUNTERS * sizeof(double));
+}
+
+#endif // __linux__
@@ -0,0 +1,34 @@
+#ifndef BENCH_COUNTERS_H
+#define BENCH_COUNTERS_H
+
+#include <stdio.h>
+
+// Host performance counters of the thread issuing the transfers, counted
+// with perf_event_open while the timed operation runs.
+enum bench_counter {
+    BENCH_CTR_CYCLES = 0,           // CPU cycles, user and (if permitted) kernel
+    BENCH_CTR_PAGE_FAULTS,          // minor and major page faults
+    BENCH_CTR_CONTEXT_SWITCHES,
+    BENCH_CTR_LLC_MISSES,           // last level cache misses
+    BENCH_CTR_REMOTE_ACCESSES,      // loads served by another NUMA domain
+    BENCH_NCOUNTERS
+};
+
+extern const char * const bench_counter_names[BENCH_NCOUNTERS];
+
+// Select the counters given as comma separated list of names or "all"
+// (BENCH_COUNTERS) and check which of them can be opened on this machine.
+// Prints the selection and the unavailable counters to out. Returns the mask
+// of usable counters (bit i for counter i), 0 if spec is NULL.
+unsigned bench_counters_setup(const char * spec, FILE * out);
+
+// Count on the calling thread. The counters are opened on first use per
+// thread and keep counting across enable/disable pairs until read.
+void bench_counters_enable(unsigned mask);
+void bench_counters_disable(unsigned mask);
+
+// Store the counts since the last read divided by n (e.g. per repetition)
+// in values and restart from zero. Unselected counters are set to 0.
+void bench_counters_read(unsigned mask, double n, double * values);
+
+#endif // BENCH_COUNTERS_H
@@ -0,0 +1,34 @@
+#include "fit.h"
+
+int bench_fit_hockney(const double * bytes, const double * time, int count, bench_hockney_t * fit) {
+    // weighted linear least squares with weights 1/t^2
+    double sw = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    for (int i = 0; i < count; i++) {
+        if (time[i] <= 0.0) {
+            continue;
+        }
+        double w = 1.0 / (time[i] * time[i]);
+        sw  += w;
+        sx  += w * bytes[i];
+        sy  += w * time[i];
+        sxx += w * bytes[i] * bytes[i];
+        sxy += w * bytes[i] * time[i];
+    }
+
+    fit->alpha = 0.0;
+    fit->beta = 0.0;
+    fit->n_half = 0.0;
+    double det = sw * sxx - sx * sx;
+    if (count < 2 || det <= 0.0) {
+        return -1;
+    }
+    double slope = (sw * sxy - sx * sy) / det;
+    double intercept = (sy - slope * sx) / sw;
+    if (slope <= 0.0) {
+        return -1;
+    }
+    fit->alpha = intercept;
+    fit->beta = 1.0 / slope;
+    fit->n_half = intercept > 0.0 ? intercept * fit->beta : 0.0;
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef BENCH_FIT_H
+#define BENCH_FIT_H
+
+// Hockney model t(n) = alpha + n / beta for the time t of transferring n bytes
+typedef struct bench_hockney {
+    double alpha;   // latency (sec)
+    double beta;    // asymptotic bandwidth (bytes/sec)
+    double n_half;  // half-performance size alpha * beta (bytes)
+} bench_hockney_t;
+
+// Fit the Hockney model to count (bytes, time) pairs. Uses least squares on
+// the relative error so that small and large transfers are weighted equally
+// across a geometric size sweep. Returns 0 on success and -1 if the data does
+// not allow a meaningful fit (less than two sizes or non-positive slope).
+int bench_fit_hockney(const double * bytes, const double * time, int count, bench_hockney_t * fit);
+
+#endif // BENCH_FIT_H
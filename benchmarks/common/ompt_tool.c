@@ -0,0 +1,261 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ompt_tool.h"
+
+// The tool is part of the OpenMP builds if the compiler provides the OMPT
+// interface; the runtime finds ompt_start_tool in the executable, so no
+// OMP_TOOL_LIBRARIES is needed.
+#if defined(BENCH_HAVE_OMP) && defined(__has_include)
+#if __has_include(<omp-tools.h>)
+#define BENCH_HAVE_OMPT
+#endif
+#endif
+
+const char * const bench_ompt_phase_names[BENCH_OMPT_NPHASES] = {
+    "setup", "alloc", "to_device", "from_device", "delete", "submit", "completion",
+};
+
+// names of the per-construct times in result records
+static const char * const ompt_value_names[BENCH_OMPT_NPHASES] = {
+    "setup_us", "alloc_us", "to_device_us", "from_device_us", "delete_us", "submit_us", "completion_us",
+};
+
+#ifdef BENCH_HAVE_OMPT
+
+#include <omp-tools.h>
+
+// Totals of all completed target constructs in ns, updated atomically.
+static uint64_t ompt_regions = 0;
+static uint64_t ompt_totals[BENCH_OMPT_NPHASES];
+static int ompt_started = 0;
+static const char * ompt_callbacks = "none";
+
+// State of the target construct the calling thread is in. The time since the
+// last callback is charged to the current phase at every callback.
+typedef struct ompt_thread_state {
+    int in_region;
+    int submitted;
+    int phase;
+    uint64_t t_last;
+    uint64_t time[BENCH_OMPT_NPHASES];
+} ompt_thread_state_t;
+
+static __thread ompt_thread_state_t ompt_state;
+
+static uint64_t ompt_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void ompt_charge(ompt_thread_state_t * st, int next_phase) {
+    uint64_t now = ompt_now();
+    st->time[st->phase] += now - st->t_last;
+    st->t_last = now;
+    st->phase = next_phase;
+}
+
+static int ompt_data_phase(ompt_target_data_op_t optype) {
+    // the asynchronous variants are the synchronous ones plus 16
+    switch ((int)optype & 0x0f) {
+        case ompt_target_data_alloc:                return BENCH_OMPT_ALLOC;
+        case ompt_target_data_transfer_to_device:   return BENCH_OMPT_TO_DEVICE;
+        case ompt_target_data_transfer_from_device: return BENCH_OMPT_FROM_DEVICE;
+        case ompt_target_data_delete:               return BENCH_OMPT_DELETE;
+        default:                                    return -1;
+    }
+}
+
+// phase between operations: before the kernel submission setup, afterwards completion
+static int ompt_idle_phase(const ompt_thread_state_t * st) {
+    return st->submitted ? BENCH_OMPT_COMPLETION : BENCH_OMPT_SETUP;
+}
+
+static void ompt_flush(ompt_thread_state_t * st, int region) {
+    for (int p = 0; p < BENCH_OMPT_NPHASES; p++) {
+        __atomic_fetch_add(&ompt_totals[p], st->time[p], __ATOMIC_RELAXED);
+        st->time[p] = 0;
+    }
+    if (region) {
+        __atomic_fetch_add(&ompt_regions, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void ompt_target_begin_end(ompt_scope_endpoint_t endpoint) {
+    ompt_thread_state_t * st = &ompt_state;
+    if (endpoint == ompt_scope_begin) {
+        memset(st, 0, sizeof(*st));
+        st->in_region = 1;
+        st->phase = BENCH_OMPT_SETUP;
+        st->t_last = ompt_now();
+    } else if (st->in_region) {
+        ompt_charge(st, BENCH_OMPT_SETUP);
+        ompt_flush(st, 1);
+        st->in_region = 0;
+    }
+}
+
+// Data operations outside of target constructs (omp_target_alloc,
+// omp_target_memcpy, ...) are timed on their own if the runtime reports both
+// endpoints, they do not count as constructs.
+static void ompt_data_op(ompt_scope_endpoint_t endpoint, ompt_target_data_op_t optype) {
+    ompt_thread_state_t * st = &ompt_state;
+    int phase = ompt_data_phase(optype);
+    if (!st->in_region) {
+        if (phase < 0) {
+            return;
+        }
+        if (endpoint == ompt_scope_begin) {
+            st->phase = phase;
+            st->t_last = ompt_now();
+        } else if (endpoint == ompt_scope_end && st->t_last != 0) {
+            ompt_charge(st, BENCH_OMPT_SETUP);
+            ompt_flush(st, 0);
+            st->t_last = 0;
+        }
+        return;
+    }
+    if (phase < 0) {
+        phase = ompt_idle_phase(st);
+    }
+    ompt_charge(st, endpoint == ompt_scope_end ? ompt_idle_phase(st) : phase);
+}
+
+static void ompt_submit(ompt_scope_endpoint_t endpoint) {
+    ompt_thread_state_t * st = &ompt_state;
+    if (!st->in_region) {
+        return;
+    }
+    st->submitted = 1;
+    ompt_charge(st, endpoint == ompt_scope_end ? BENCH_OMPT_COMPLETION : BENCH_OMPT_SUBMIT);
+}
+
+// OpenMP 5.1 callbacks report both endpoints of every operation.
+static void ompt_on_target_emi(ompt_target_t kind, ompt_scope_endpoint_t endpoint, int device_num,
+                               ompt_data_t * task_data, ompt_data_t * target_task_data,
+                               ompt_data_t * target_data, const void * codeptr_ra) {
+    ompt_target_begin_end(endpoint);
+}
+
+static void ompt_on_target_data_op_emi(ompt_scope_endpoint_t endpoint, ompt_data_t * target_task_data,
+                                       ompt_data_t * target_data, ompt_id_t * host_op_id,
+                                       ompt_target_data_op_t optype, void * src_addr, int src_device_num,
+                                       void * dest_addr, int dest_device_num, size_t bytes,
+                                       const void * codeptr_ra) {
+    ompt_data_op(endpoint, optype);
+}
+
+static void ompt_on_target_submit_emi(ompt_scope_endpoint_t endpoint, ompt_data_t * target_data,
+                                      ompt_id_t * host_op_id, unsigned int requested_num_teams) {
+    ompt_submit(endpoint);
+}
+
+// OpenMP 5.0 callbacks: data operations and submissions are reported once,
+// at their start, so an operation lasts until the next callback.
+static void ompt_on_target(ompt_target_t kind, ompt_scope_endpoint_t endpoint, int device_num,
+                           ompt_data_t * task_data, ompt_id_t target_id, const void * codeptr_ra) {
+    ompt_target_begin_end(endpoint);
+}
+
+static void ompt_on_target_data_op(ompt_id_t target_id, ompt_id_t host_op_id, ompt_target_data_op_t optype,
+                                   void * src_addr, int src_device_num, void * dest_addr,
+                                   int dest_device_num, size_t bytes, const void * codeptr_ra) {
+    if (ompt_state.in_region) {
+        ompt_data_op(ompt_scope_begin, optype);
+    }
+}
+
+static void ompt_on_target_submit(ompt_id_t target_id, ompt_id_t host_op_id, unsigned int requested_num_teams) {
+    ompt_submit(ompt_scope_begin);
+}
+
+static int ompt_registered(ompt_set_result_t result) {
+    return result != ompt_set_error && result != ompt_set_never;
+}
+
+static int ompt_tool_initialize(ompt_function_lookup_t lookup, int initial_device_num, ompt_data_t * tool_data) {
+    ompt_set_callback_t set_callback = (ompt_set_callback_t)lookup("ompt_set_callback");
+    if (set_callback == NULL) {
+        return 0;
+    }
+    if (ompt_registered(set_callback(ompt_callback_target_emi, (ompt_callback_t)ompt_on_target_emi))) {
+        set_callback(ompt_callback_target_data_op_emi, (ompt_callback_t)ompt_on_target_data_op_emi);
+        set_callback(ompt_callback_target_submit_emi, (ompt_callback_t)ompt_on_target_submit_emi);
+        ompt_callbacks = "OpenMP 5.1 (emi)";
+    } else if (ompt_registered(set_callback(ompt_callback_target, (ompt_callback_t)ompt_on_target))) {
+        set_callback(ompt_callback_target_data_op, (ompt_callback_t)ompt_on_target_data_op);
+        set_callback(ompt_callback_target_submit, (ompt_callback_t)ompt_on_target_submit);
+        ompt_callbacks = "OpenMP 5.0";
+    } else {
+        // the runtime does not trace target constructs
+        return 0;
+    }
+    ompt_started = 1;
+    return 1;
+}
+
+static void ompt_tool_finalize(ompt_data_t * tool_data) {
+    ompt_started = 0;
+}
+
+ompt_start_tool_result_t * ompt_start_tool(unsigned int omp_version, const char * runtime_version) {
+    static ompt_start_tool_result_t result = { ompt_tool_initialize, ompt_tool_finalize, { 0 } };
+    const char * env = getenv("BENCH_OMPT");
+    if (env == NULL || atoi(env) == 0) {
+        return NULL;
+    }
+    return &result;
+}
+
+int bench_ompt_active(void) {
+    return ompt_started;
+}
+
+void bench_ompt_print_info(FILE * out) {
+    fprintf(out, "OMPT tracing: %s\n", ompt_started ? ompt_callbacks : "inactive");
+}
+
+void bench_ompt_reset(void) {
+    __atomic_store_n(&ompt_regions, 0, __ATOMIC_RELAXED);
+    for (int p = 0; p < BENCH_OMPT_NPHASES; p++) {
+        __atomic_store_n(&ompt_totals[p], 0, __ATOMIC_RELAXED);
+    }
+}
+
+void bench_ompt_read(bench_ompt_phases_t * phases) {
+    phases->regions = (unsigned long)__atomic_load_n(&ompt_regions, __ATOMIC_RELAXED);
+    for (int p = 0; p < BENCH_OMPT_NPHASES; p++) {
+        phases->time[p] = (double)__atomic_load_n(&ompt_totals[p], __ATOMIC_RELAXED) * 1e-9;
+    }
+}
+
+#else // !BENCH_HAVE_OMPT
+
+int bench_ompt_active(void) {
+    return 0;
+}
+
+void bench_ompt_print_info(FILE * out) {
+    fprintf(out, "OMPT tracing: not available in this build\n");
+}
+
+void bench_ompt_reset(void) {
+}
+
+void bench_ompt_read(bench_ompt_phases_t * phases) {
+    memset(phases, 0, sizeof(*phases));
+}
+
+#endif // BENCH_HAVE_OMPT
+
+void bench_ompt_record_add(bench_record_t * rec, const bench_ompt_phases_t * phases) {
+    double n = phases->regions > 0 ? (double)phases->regions : 1.0;
+    bench_record_add(rec, "regions", (double)phases->regions);
+    for (int p = 0; p < BENCH_OMPT_NPHASES; p++) {
+        bench_record_add(rec, ompt_value_names[p], phases->time[p] / n * 1e6);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef BENCH_OMPT_TOOL_H
+#define BENCH_OMPT_TOOL_H
+
+#include <stdio.h>
+
+#include "output.h"
+
+// Phases of a target construct as seen by the OMPT target callbacks. The
+// time of a construct is split at its callbacks: everything before the first
+// data operation or the kernel submission is setup (device lookup, mapping
+// table search, argument packing), everything after the submission that is
+// no data operation is completion (synchronization, unmapping).
+enum bench_ompt_phase {
+    BENCH_OMPT_SETUP = 0,
+    BENCH_OMPT_ALLOC,
+    BENCH_OMPT_TO_DEVICE,
+    BENCH_OMPT_FROM_DEVICE,
+    BENCH_OMPT_DELETE,
+    BENCH_OMPT_SUBMIT,
+    BENCH_OMPT_COMPLETION,
+    BENCH_OMPT_NPHASES
+};
+
+extern const char * const bench_ompt_phase_names[BENCH_OMPT_NPHASES];
+
+typedef struct bench_ompt_phases {
+    unsigned long regions;              // completed target constructs
+    double time[BENCH_OMPT_NPHASES];    // total time per phase in sec
+} bench_ompt_phases_t;
+
+// Non-zero if the OMPT tool was started by the OpenMP runtime, which requires
+// BENCH_OMPT=1 in the environment of the process and a runtime with OMPT
+// support for target constructs.
+int bench_ompt_active(void);
+
+// Print whether tracing is active and which callbacks are used.
+void bench_ompt_print_info(FILE * out);
+
+// Clear the accumulated phases and read them. Only target constructs that
+// completed since the last reset are included.
+void bench_ompt_reset(void);
+void bench_ompt_read(bench_ompt_phases_t * phases);
+
+// Add the per-construct time of every phase in us to a record.
+void bench_ompt_record_add(bench_record_t * rec, const bench_ompt_phases_t * phases);
+
+#endif // BENCH_OMPT_TOOL_H
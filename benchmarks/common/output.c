@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "output.h"
+
+static const char * compiler_version(void) {
+#if defined(__VERSION__)
+    return __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+// Print a JSON string literal with minimal escaping.
+static void json_string(FILE * out, const char * str) {
+    fputc('"', out);
+    for (const char * p = str ? str : ""; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if ((unsigned char)*p < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// CSV fields are quoted only if necessary.
+static void csv_string(FILE * out, const char * str) {
+    if (str == NULL) {
+        return;
+    }
+    if (strpbrk(str, ",\"\n") == NULL) {
+        fputs(str, out);
+        return;
+    }
+    fputc('"', out);
+    for (const char * p = str; *p; p++) {
+        if (*p == '"') {
+            fputc('"', out);
+        }
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+// Print n integers separated by sep.
+static void write_ints(FILE * out, const int * v, int n, const char * sep) {
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "%s%d", i > 0 ? sep : "", v[i]);
+    }
+}
+
+// Print the NUMA distance matrix of the domains found in sysfs, rows
+// separated by row_sep.
+static void write_distances(FILE * out, const bench_topology_t * topo, const char * row_begin,
+                            const char * row_end, const char * row_sep, const char * sep) {
+    int first_row = 1;
+    for (int n = 0; n < BENCH_TOPO_MAX_NODES; n++) {
+        if (!topo->node_present[n]) {
+            continue;
+        }
+        fprintf(out, "%s%s", first_row ? "" : row_sep, row_begin);
+        int first = 1;
+        for (int k = 0; k < BENCH_TOPO_MAX_NODES; k++) {
+            if (topo->node_present[k]) {
+                fprintf(out, "%s%d", first ? "" : sep, topo->distance[n][k]);
+                first = 0;
+            }
+        }
+        fprintf(out, "%s", row_end);
+        first_row = 0;
+    }
+}
+
+void bench_record_init(bench_record_t * rec, const char * mode, int core, int device, size_t size) {
+    memset(rec, 0, sizeof(*rec));
+    rec->mode = mode;
+    rec->core = core;
+    rec->device = device;
+    rec->size = size;
+}
+
+void bench_record_add(bench_record_t * rec, const char * name, double value) {
+    if (rec->nvalues < BENCH_RECORD_MAX_VALUES) {
+        rec->names[rec->nvalues] = name;
+        rec->values[rec->nvalues] = value;
+        rec->nvalues++;
+    } else {
+        // dropped values are a driver bug, report the first one
+        static int dropped = 0;
+        int first;
+        #pragma omp atomic capture
+        first = dropped++;
+        if (first == 0) {
+            fprintf(stderr, "record of mode %s has more than %d values, dropping '%s' (reported once)\n",
+                    rec->mode, BENCH_RECORD_MAX_VALUES, name);
+        }
+    }
+}
+
+void bench_output_open(bench_context_t * ctx) {
+    const char * path = getenv("BENCH_OUTPUT");
+    const char * format = getenv("BENCH_OUTPUT_FORMAT");
+    ctx->out = NULL;
+    if (path == NULL || path[0] == '\0') {
+        return;
+    }
+    size_t len = strlen(path);
+    if (format != NULL) {
+        ctx->out_format = strcmp(format, "csv") == 0 ? BENCH_OUTPUT_CSV : BENCH_OUTPUT_JSONL;
+    } else {
+        ctx->out_format = (len > 4 && strcmp(path + len - 4, ".csv") == 0) ? BENCH_OUTPUT_CSV : BENCH_OUTPUT_JSONL;
+    }
+    // Runs of one experiment that write to the same file append to it, also
+    // if other files were written in between: every path opened by this
+    // process is truncated only the first time.
+    static char ** opened_paths = NULL;
+    static int nopened = 0;
+    int append = 0;
+    for (int i = 0; i < nopened && !append; i++) {
+        append = strcmp(opened_paths[i], path) == 0;
+    }
+    if (!append) {
+        opened_paths = (char **)realloc(opened_paths, (nopened + 1) * sizeof(char *));
+        opened_paths[nopened++] = strdup(path);
+    }
+    ctx->out = fopen(path, append ? "a" : "w");
+    if (ctx->out == NULL) {
+        perror("could not open result file");
+        exit(EXIT_FAILURE);
+    }
+
+    char timestamp[64];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    const char * places = getenv("OMP_PLACES");
+    const char * bind = getenv("OMP_PROC_BIND");
+    int nnuma = 0;
+    for (int c = 0; c < ctx->ncores; c++) {
+        if (ctx->core_numa[c] + 1 > nnuma) {
+            nnuma = ctx->core_numa[c] + 1;
+        }
+    }
+
+    FILE * out = ctx->out;
+    if (ctx->out_format == BENCH_OUTPUT_JSONL) {
+        fprintf(out, "{\"type\":\"meta\",\"benchmark\":");
+        json_string(out, ctx->benchmark);
+        fprintf(out, ",\"backend\":");
+        json_string(out, ctx->backend->name);
+        fprintf(out, ",\"run\":");
+        json_string(out, ctx->run);
+        fprintf(out, ",\"hostname\":");
+        json_string(out, ctx->hostname);
+        fprintf(out, ",\"timestamp\":");
+        json_string(out, timestamp);
+        fprintf(out, ",\"compiler\":");
+        json_string(out, compiler_version());
+        fprintf(out, ",\"reps\":%d,\"min_reps\":%d,\"ci_target\":%g", ctx->reps, ctx->min_reps, ctx->ci_target);
+        fprintf(out, ",\"omp_places\":");
+        json_string(out, places);
+        fprintf(out, ",\"omp_proc_bind\":");
+        json_string(out, bind);
+        fprintf(out, ",\"ncores\":%d,\"ndev\":%d,\"numa_nodes\":%d,\"core_numa\":[", ctx->ncores, ctx->ndev, nnuma);
+        write_ints(out, ctx->core_numa, ctx->ncores, ",");
+        const bench_topology_t * topo = ctx->topo;
+        fprintf(out, "],\"core_cpu\":[");
+        write_ints(out, ctx->core_cpu, ctx->ncores, ",");
+        fprintf(out, "],\"core_package\":[");
+        write_ints(out, topo->core_package, ctx->ncores, ",");
+        fprintf(out, "],\"core_l3\":[");
+        write_ints(out, topo->core_l3, ctx->ncores, ",");
+        fprintf(out, "],\"numa_distance\":[");
+        write_distances(out, topo, "[", "]", ",", ",");
+        fprintf(out, "],\"devices\":[");
+        for (int d = 0; d < ctx->ndev; d++) {
+            fprintf(out, "%s{\"pci\":", d > 0 ? "," : "");
+            json_string(out, topo->dev_pci[d]);
+            fprintf(out, ",\"numa\":%d,\"link\":", topo->dev_numa[d]);
+            json_string(out, topo->dev_link[d]);
+            fprintf(out, "}");
+        }
+        fprintf(out, "]}\n");
+    } else {
+        // metadata as comment lines followed by the header
+        fprintf(out, "# benchmark=%s\n", ctx->benchmark);
+        fprintf(out, "# backend=%s\n", ctx->backend->name);
+        fprintf(out, "# run=%s\n", ctx->run ? ctx->run : "");
+        fprintf(out, "# hostname=%s\n", ctx->hostname);
+        fprintf(out, "# timestamp=%s\n", timestamp);
+        fprintf(out, "# compiler=%s\n", compiler_version());
+        fprintf(out, "# reps=%d\n# min_reps=%d\n# ci_target=%g\n", ctx->reps, ctx->min_reps, ctx->ci_target);
+        fprintf(out, "# omp_places=%s\n# omp_proc_bind=%s\n", places ? places : "", bind ? bind : "");
+        fprintf(out, "# ncores=%d\n# ndev=%d\n# numa_nodes=%d\n# core_numa=", ctx->ncores, ctx->ndev, nnuma);
+        write_ints(out, ctx->core_numa, ctx->ncores, " ");
+        const bench_topology_t * topo = ctx->topo;
+        fprintf(out, "\n# core_cpu=");
+        write_ints(out, ctx->core_cpu, ctx->ncores, " ");
+        fprintf(out, "\n# core_package=");
+        write_ints(out, topo->core_package, ctx->ncores, " ");
+        fprintf(out, "\n# core_l3=");
+        write_ints(out, topo->core_l3, ctx->ncores, " ");
+        fprintf(out, "\n# numa_distance=");
+        write_distances(out, topo, "", "", ";", " ");
+        fprintf(out, "\n");
+        for (int d = 0; d < ctx->ndev; d++) {
+            fprintf(out, "# device%d=pci:%s numa:%d link:%s\n", d, topo->dev_pci[d], topo->dev_numa[d], topo->dev_link[d]);
+        }
+        if (!append) {
+            fprintf(out, "hostname,benchmark,backend,run,mode,variant,core,numa,device,size,"
+                         "n,min,median,mean,p90,p99,stddev,ci95,metric,value\n");
+        }
+    }
+    fflush(out);
+}
+
+void bench_output_close(bench_context_t * ctx) {
+    if (ctx->out != NULL) {
+        fclose(ctx->out);
+        ctx->out = NULL;
+    }
+}
+
+static void write_jsonl(const bench_context_t * ctx, const bench_record_t * rec, int numa) {
+    FILE * out = ctx->out;
+    fprintf(out, "{\"type\":\"result\",\"hostname\":");
+    json_string(out, ctx->hostname);
+    fprintf(out, ",\"benchmark\":");
+    json_string(out, ctx->benchmark);
+    fprintf(out, ",\"backend\":");
+    json_string(out, ctx->backend->name);
+    if (ctx->run != NULL) {
+        fprintf(out, ",\"run\":");
+        json_string(out, ctx->run);
+    }
+    fprintf(out, ",\"mode\":");
+    json_string(out, rec->mode);
+    if (rec->variant != NULL) {
+        fprintf(out, ",\"variant\":");
+        json_string(out, rec->variant);
+    }
+    fprintf(out, ",\"core\":%d,\"numa\":%d,\"device\":%d,\"size\":%zu", rec->core, numa, rec->device, rec->size);
+    if (rec->stats != NULL) {
+        const bench_stats_t * st = rec->stats;
+        fprintf(out, ",\"time_s\":{\"n\":%d,\"min\":%.9g,\"median\":%.9g,\"mean\":%.9g,\"p90\":%.9g,"
+                     "\"p99\":%.9g,\"stddev\":%.9g,\"ci95\":%.9g}",
+                st->n, st->min, st->median, st->mean, st->p90, st->p99, st->stddev, st->ci95);
+    }
+    for (int i = 0; i < rec->nvalues; i++) {
+        fprintf(out, ",");
+        json_string(out, rec->names[i]);
+        fprintf(out, ":%.9g", rec->values[i]);
+    }
+    fprintf(out, "}\n");
+}
+
+static void write_csv_row(const bench_context_t * ctx, const bench_record_t * rec, int numa, int value) {
+    FILE * out = ctx->out;
+    csv_string(out, ctx->hostname);
+    fputc(',', out);
+    csv_string(out, ctx->benchmark);
+    fputc(',', out);
+    csv_string(out, ctx->backend->name);
+    fputc(',', out);
+    csv_string(out, ctx->run);
+    fputc(',', out);
+    csv_string(out, rec->mode);
+    fputc(',', out);
+    csv_string(out, rec->variant);
+    fprintf(out, ",%d,%d,%d,%zu,", rec->core, numa, rec->device, rec->size);
+    if (rec->stats != NULL) {
+        const bench_stats_t * st = rec->stats;
+        fprintf(out, "%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,",
+                st->n, st->min, st->median, st->mean, st->p90, st->p99, st->stddev, st->ci95);
+    } else {
+        fprintf(out, ",,,,,,,,");
+    }
+    if (value >= 0) {
+        csv_string(out, rec->names[value]);
+        fprintf(out, ",%.9g\n", rec->values[value]);
+    } else {
+        fprintf(out, ",\n");
+    }
+}
+
+void bench_output_record(const bench_context_t * ctx, const bench_record_t * rec) {
+    if (ctx->out == NULL) {
+        return;
+    }
+    int numa = (rec->core >= 0 && rec->core < ctx->ncores) ? ctx->core_numa[rec->core] : -1;
+    // host counters of the timed cell next to its derived values
+    bench_record_t with_counters;
+    if (ctx->counters != 0 && rec->stats != NULL) {
+        with_counters = *rec;
+        for (int k = 0; k < BENCH_NCOUNTERS; k++) {
+            if (ctx->counters & (1u << k)) {
+                bench_record_add(&with_counters, bench_counter_names[k], rec->stats->counters[k]);
+            }
+        }
+        rec = &with_counters;
+    }
+    #pragma omp critical (bench_output)
+    {
+        if (ctx->out_format == BENCH_OUTPUT_JSONL) {
+            write_jsonl(ctx, rec, numa);
+        } else if (rec->nvalues == 0) {
+            write_csv_row(ctx, rec, numa, -1);
+        } else {
+            // long format: one row per derived value
+            for (int i = 0; i < rec->nvalues; i++) {
+                write_csv_row(ctx, rec, numa, i);
+            }
+        }
+    }
+}
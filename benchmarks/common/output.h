@@ -0,0 +1,44 @@
+#ifndef BENCH_OUTPUT_H
+#define BENCH_OUTPUT_H
+
+#include <stddef.h>
+
+#include "stats.h"
+
+struct bench_context;
+
+#define BENCH_RECORD_MAX_VALUES 16
+
+enum bench_output_format {
+    BENCH_OUTPUT_JSONL = 0,
+    BENCH_OUTPUT_CSV = 1,
+};
+
+// One self-describing result record. Host name, backend and benchmark are
+// added from the context when the record is written.
+typedef struct bench_record {
+    const char * mode;              // e.g. "sweep", "contention"
+    const char * variant;           // optional mode specific parameters, may be NULL
+    int core;                       // -1 if not applicable
+    int device;                     // -1 if not applicable
+    size_t size;                    // transfer size in bytes, 0 if not applicable
+    const bench_stats_t * stats;    // per-repetition time statistics in sec, may be NULL
+    int nvalues;                    // derived values, e.g. bandwidth
+    const char * names[BENCH_RECORD_MAX_VALUES];
+    double values[BENCH_RECORD_MAX_VALUES];
+} bench_record_t;
+
+void bench_record_init(bench_record_t * rec, const char * mode, int core, int device, size_t size);
+void bench_record_add(bench_record_t * rec, const char * name, double value);
+
+// Open the result file given by BENCH_OUTPUT (if set) and write the run
+// metadata. The format is CSV if BENCH_OUTPUT_FORMAT is "csv" or the file
+// name ends with ".csv", JSON Lines otherwise. A file opened before by the
+// same process (an earlier run of an experiment) is appended to.
+void bench_output_open(struct bench_context * ctx);
+void bench_output_close(struct bench_context * ctx);
+
+// Write a record (no-op if no result file is open). Thread-safe.
+void bench_output_record(const struct bench_context * ctx, const bench_record_t * rec);
+
+#endif // BENCH_OUTPUT_H
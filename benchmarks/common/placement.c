@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef BENCH_HAVE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+#include "bench.h"
+#include "placement.h"
+
+int bench_placement_parse(const char * spec, bench_placement_t * pl) {
+    pl->mode = BENCH_PLACE_LOCAL;
+    pl->node = -1;
+    if (spec == NULL || spec[0] == '\0' || strcmp(spec, "local") == 0) {
+        return 0;
+    }
+    if (strcmp(spec, "interleave") == 0) {
+        pl->mode = BENCH_PLACE_INTERLEAVE;
+    } else if (strcmp(spec, "device") == 0) {
+        pl->mode = BENCH_PLACE_DEVICE;
+    } else {
+        const char * p = strncmp(spec, "node:", 5) == 0 ? spec + 5 : spec;
+        char * end;
+        long node = strtol(p, &end, 10);
+        if (end == p || *end != '\0' || node < 0 || node >= bench_numa_num_nodes()) {
+            fprintf(stderr, "invalid placement '%s', expected local, interleave, device or a NUMA domain (0-%d)\n",
+                    spec, bench_numa_num_nodes() - 1);
+            return -1;
+        }
+        pl->mode = BENCH_PLACE_NODE;
+        pl->node = (int)node;
+    }
+#ifndef BENCH_HAVE_NUMA
+    fprintf(stderr, "placement '%s' requires libnuma, rebuild with NUMA=1\n", spec);
+    return -1;
+#else
+    if (numa_available() < 0) {
+        fprintf(stderr, "placement '%s' requires NUMA support of the kernel\n", spec);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+void bench_placement_format(const bench_placement_t * pl, char * buf, size_t len) {
+    switch (pl->mode) {
+        case BENCH_PLACE_NODE:       snprintf(buf, len, "node:%d", pl->node); break;
+        case BENCH_PLACE_INTERLEAVE: snprintf(buf, len, "interleave"); break;
+        case BENCH_PLACE_DEVICE:     snprintf(buf, len, "device"); break;
+        default:                     snprintf(buf, len, "local"); break;
+    }
+}
+
+int bench_numa_num_nodes(void) {
+#ifdef BENCH_HAVE_NUMA
+    if (numa_available() >= 0) {
+        return numa_num_configured_nodes();
+    }
+#endif
+    return 1;
+}
+
+int bench_placement_node(const bench_context_t * ctx, const bench_placement_t * pl, int core, int dev) {
+    int local = ctx->core_numa[core];
+    switch (pl->mode) {
+        case BENCH_PLACE_NODE:
+            return pl->node;
+        case BENCH_PLACE_INTERLEAVE:
+            return -1;
+        case BENCH_PLACE_DEVICE: {
+            int node = bench_device_numa(ctx, dev);
+            return node >= 0 ? node : local;
+        }
+        default:
+            return local;
+    }
+}
+
+const char * const bench_page_names[BENCH_PAGES_N] = { "default", "4k", "thp", "2m", "1g" };
+
+int bench_page_parse(const char * spec, int * modes) {
+    int n = 0;
+    for (const char * p = spec; *p; ) {
+        size_t len = strcspn(p, ",");
+        int found = 0;
+        for (int m = 0; m < BENCH_PAGES_N; m++) {
+            int all = (len == 3 && strncmp(p, "all", 3) == 0 && m != BENCH_PAGES_DEFAULT);
+            if (all || (len == strlen(bench_page_names[m]) && strncmp(p, bench_page_names[m], len) == 0)) {
+                if (n < BENCH_PAGES_N) {
+                    modes[n++] = m;
+                }
+                found = 1;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "invalid page size '%.*s', expected default, 4k, thp, 2m, 1g or all\n", (int)len, p);
+            return -1;
+        }
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return n;
+}
+
+void bench_page_print_info(FILE * out) {
+    char line[128];
+    FILE * f = bench_sysfs_open("/kernel/mm/transparent_hugepage/enabled");
+    if (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        fprintf(out, "transparent huge pages: %s\n", line);
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+    const char * sizes[2] = { "2048kB", "1048576kB" };
+    for (int i = 0; i < 2; i++) {
+        long total = -1, free_pages = -1;
+        f = bench_sysfs_open("/kernel/mm/hugepages/hugepages-%s/nr_hugepages", sizes[i]);
+        if (f != NULL) {
+            if (fscanf(f, "%ld", &total) != 1) {
+                total = -1;
+            }
+            fclose(f);
+        }
+        f = bench_sysfs_open("/kernel/mm/hugepages/hugepages-%s/free_hugepages", sizes[i]);
+        if (f != NULL) {
+            if (fscanf(f, "%ld", &free_pages) != 1) {
+                free_pages = -1;
+            }
+            fclose(f);
+        }
+        if (total >= 0) {
+            fprintf(out, "hugetlbfs %s pages: %ld reserved, %ld free\n", i == 0 ? "2 MB" : "1 GB", total, free_pages);
+        }
+    }
+}
+
+// Mapping length of a buffer: hugetlbfs mappings are multiples of the page size.
+static size_t buffer_length(size_t size, int pages) {
+    size_t align = pages == BENCH_PAGES_1G ? (1ul << 30) : (pages == BENCH_PAGES_2M ? (2ul << 20) : 1);
+    return (size + align - 1) / align * align;
+}
+
+char * bench_buffer_alloc_pages(size_t size, int pages) {
+    size_t len = buffer_length(size, pages);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (pages == BENCH_PAGES_2M || pages == BENCH_PAGES_1G) {
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+        flags |= MAP_HUGETLB | ((pages == BENCH_PAGES_1G ? 30 : 21) << MAP_HUGE_SHIFT);
+#else
+        return NULL;
+#endif
+    }
+    if (pages == BENCH_PAGES_THP) {
+        // over-allocate to start at a 2 MB boundary, huge pages need aligned ranges
+        size_t huge = 2ul << 20;
+        char * raw = (char *)mmap(NULL, len + huge, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (raw == MAP_FAILED) {
+            return NULL;
+        }
+        char * buf = (char *)(((unsigned long)raw + huge - 1) & ~(huge - 1));
+        if (buf > raw) {
+            munmap(raw, buf - raw);
+        }
+        munmap(buf + len, raw + len + huge - (buf + len));
+#ifdef MADV_HUGEPAGE
+        madvise(buf, len, MADV_HUGEPAGE);
+#endif
+        return buf;
+    }
+    void * buf = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (buf == MAP_FAILED) {
+        return NULL;
+    }
+#ifdef MADV_NOHUGEPAGE
+    if (pages == BENCH_PAGES_4K) {
+        madvise(buf, len, MADV_NOHUGEPAGE);
+    }
+#endif
+    return (char *)buf;
+}
+
+void bench_buffer_free_pages(char * buf, size_t size, int pages) {
+    munmap(buf, buffer_length(size, pages));
+}
+
+char * bench_buffer_alloc(size_t size) {
+    char * buf = bench_buffer_alloc_pages(size, BENCH_PAGES_DEFAULT);
+    if (buf == NULL) {
+        fprintf(stderr, "could not allocate host buffer of %zu bytes\n", size);
+        abort();
+    }
+    return buf;
+}
+
+void bench_buffer_free(char * buf, size_t size) {
+    bench_buffer_free_pages(buf, size, BENCH_PAGES_DEFAULT);
+}
+
+long bench_buffer_huge_bytes(const char * buf) {
+    FILE * f = fopen("/proc/self/smaps", "r");
+    if (f == NULL) {
+        return -1;
+    }
+    // find the mapping that contains buf, then sum its huge page lines
+    char line[256];
+    int inside = 0;
+    long bytes = -1;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            if (inside) {
+                break;
+            }
+            inside = (unsigned long)buf >= start && (unsigned long)buf < end;
+            if (inside) {
+                bytes = 0;
+            }
+            continue;
+        }
+        long kb;
+        if (inside && (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1
+                       || sscanf(line, "Private_Hugetlb: %ld kB", &kb) == 1)) {
+            bytes += kb * 1024;
+        }
+    }
+    fclose(f);
+    return bytes;
+}
+
+int bench_buffer_place(char * buf, size_t size, int pages, int node) {
+#ifdef BENCH_HAVE_NUMA
+    // hugetlbfs mappings only accept ranges of whole huge pages
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = (buffer_length(size, pages) + page - 1) / page * page;
+    long ret;
+    if (node < 0) {
+        ret = mbind(buf, len, MPOL_INTERLEAVE, numa_all_nodes_ptr->maskp,
+                    numa_all_nodes_ptr->size + 1, MPOL_MF_MOVE);
+    } else {
+        struct bitmask * mask = numa_allocate_nodemask();
+        numa_bitmask_setbit(mask, node);
+        ret = mbind(buf, len, MPOL_BIND, mask->maskp, mask->size + 1, MPOL_MF_MOVE);
+        numa_bitmask_free(mask);
+    }
+    if (ret != 0) {
+        perror("mbind");
+        return -1;
+    }
+    // populate pages that have not been touched yet
+    for (size_t i = 0; i < size; i += page) {
+        buf[i] = 0;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int bench_buffer_node(const char * buf) {
+#ifdef BENCH_HAVE_NUMA
+    int node = -1;
+    if (get_mempolicy(&node, NULL, 0, (void *)buf, MPOL_F_NODE | MPOL_F_ADDR) == 0) {
+        return node;
+    }
+#endif
+    return -1;
+}
@@ -0,0 +1,77 @@
+#ifndef BENCH_PLACEMENT_H
+#define BENCH_PLACEMENT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct bench_context;
+
+// Placement of host buffers relative to the measuring core and the device.
+enum bench_placement_mode {
+    BENCH_PLACE_LOCAL = 0,      // first-touch by the measuring core
+    BENCH_PLACE_NODE,           // a specific NUMA domain
+    BENCH_PLACE_INTERLEAVE,     // interleaved over all NUMA domains
+    BENCH_PLACE_DEVICE,         // the NUMA domain the device is attached to
+};
+
+typedef struct bench_placement {
+    int mode;
+    int node;   // NUMA domain for BENCH_PLACE_NODE
+} bench_placement_t;
+
+// Parse "local", "interleave", "device" or a NUMA domain ("3" or "node:3").
+// Returns 0 on success and -1 if the specification is invalid or the mode
+// is not supported (anything but local requires libnuma).
+int bench_placement_parse(const char * spec, bench_placement_t * pl);
+void bench_placement_format(const bench_placement_t * pl, char * buf, size_t len);
+
+// Number of NUMA domains of the system.
+int bench_numa_num_nodes(void);
+
+// NUMA domain the buffer of core should be placed on when transferring to
+// dev: -1 for interleaved placement. Devices of unknown NUMA domain fall
+// back to local placement.
+int bench_placement_node(const struct bench_context * ctx, const bench_placement_t * pl, int core, int dev);
+
+// Pages backing host buffers
+enum bench_page_mode {
+    BENCH_PAGES_DEFAULT = 0,    // whatever the system policy gives an anonymous mapping
+    BENCH_PAGES_4K,             // base pages, transparent huge pages disabled (MADV_NOHUGEPAGE)
+    BENCH_PAGES_THP,            // transparent huge pages (MADV_HUGEPAGE, 2 MB aligned)
+    BENCH_PAGES_2M,             // hugetlbfs 2 MB pages (MAP_HUGETLB)
+    BENCH_PAGES_1G,             // hugetlbfs 1 GB pages (MAP_HUGETLB)
+    BENCH_PAGES_N
+};
+
+extern const char * const bench_page_names[BENCH_PAGES_N];
+
+// Parse a comma separated list of page modes ("default", "4k", "thp", "2m",
+// "1g" or "all" for all but default) into modes (BENCH_PAGES_N entries).
+// Returns the number of modes or -1 if an entry is invalid.
+int bench_page_parse(const char * spec, int * modes);
+
+// Print the transparent huge page policy and the reserved hugetlbfs pages.
+void bench_page_print_info(FILE * out);
+
+// Page aligned host buffers that can be moved between NUMA domains.
+char * bench_buffer_alloc(size_t size);
+void bench_buffer_free(char * buf, size_t size);
+
+// Host buffer backed by the given pages. Returns NULL if the pages are not
+// available, e.g. no hugetlbfs pages of that size are reserved.
+char * bench_buffer_alloc_pages(size_t size, int pages);
+void bench_buffer_free_pages(char * buf, size_t size, int pages);
+
+// Bytes of a buffer backed by huge pages (transparent or hugetlbfs)
+// according to /proc/self/smaps, -1 if unknown.
+long bench_buffer_huge_bytes(const char * buf);
+
+// Bind the pages of a buffer from bench_buffer_alloc_pages with the given
+// pages to a NUMA domain (-1: interleave over all domains), migrating pages
+// that are already populated, and touch them. Returns 0 on success.
+int bench_buffer_place(char * buf, size_t size, int pages, int node);
+
+// NUMA domain of the first page of a buffer, -1 if unknown.
+int bench_buffer_node(const char * buf);
+
+#endif // BENCH_PLACEMENT_H
@@ -0,0 +1,142 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "stats.h"
+
+void bench_running_reset(bench_running_t * r) {
+    r->n = 0;
+    r->mean = 0.0;
+    r->m2 = 0.0;
+}
+
+void bench_running_add(bench_running_t * r, double x) {
+    r->n++;
+    double delta = x - r->mean;
+    r->mean += delta / r->n;
+    r->m2 += delta * (x - r->mean);
+}
+
+double bench_running_rel_ci95(const bench_running_t * r) {
+    if (r->n < 2 || r->mean <= 0.0) {
+        return INFINITY;
+    }
+    double stddev = sqrt(r->m2 / (r->n - 1));
+    return bench_t95(r->n - 1) * stddev / sqrt((double)r->n) / r->mean;
+}
+
+double bench_t95(int dof) {
+    static const double t_table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+         2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+         2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (dof < 1) {
+        return INFINITY;
+    }
+    if (dof <= 30) {
+        return t_table[dof - 1];
+    }
+    return 1.96;
+}
+
+static int compare_double(const void * a, const void * b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// linear interpolation between closest ranks of sorted samples
+static double quantile(const double * sorted, int n, double q) {
+    double pos = q * (n - 1);
+    int lo = (int)pos;
+    int hi = lo + 1 < n ? lo + 1 : lo;
+    return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+}
+
+void bench_stats_compute(double * samples, int n, bench_stats_t * st) {
+    st->n = n;
+    memset(st->counters, 0, sizeof(st->counters));
+    if (n == 0) {
+        st->min = st->max = st->mean = st->median = 0.0;
+        st->p90 = st->p99 = st->stddev = st->ci95 = st->sum = 0.0;
+        return;
+    }
+    qsort(samples, n, sizeof(double), compare_double);
+
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    double mean = sum / n;
+    double sq = 0.0;
+    for (int i = 0; i < n; i++) {
+        sq += (samples[i] - mean) * (samples[i] - mean);
+    }
+
+    st->sum    = sum;
+    st->mean   = mean;
+    st->min    = samples[0];
+    st->max    = samples[n - 1];
+    st->median = quantile(samples, n, 0.5);
+    st->p90    = quantile(samples, n, 0.9);
+    st->p99    = quantile(samples, n, 0.99);
+    st->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0.0;
+    st->ci95   = n > 1 ? bench_t95(n - 1) * st->stddev / sqrt((double)n) : 0.0;
+}
+
+bench_stats_t ** bench_stats_matrix_alloc(int ncores, int ndev) {
+    bench_stats_t ** m = (bench_stats_t **)malloc(ncores * sizeof(bench_stats_t *));
+    for (int c = 0; c < ncores; c++) {
+        m[c] = (bench_stats_t *)calloc(ndev > 0 ? ndev : 1, sizeof(bench_stats_t));
+    }
+    return m;
+}
+
+void bench_stats_matrix_free(bench_stats_t ** m, int ncores) {
+    for (int c = 0; c < ncores; c++) {
+        free(m[c]);
+    }
+    free(m);
+}
+
+void bench_stats_extract(bench_stats_t ** m, int ncores, int ndev, size_t field, double scale, double ** out) {
+    for (int c = 0; c < ncores; c++) {
+        for (int d = 0; d < ndev; d++) {
+            const char * cell = (const char *)&m[c][d];
+            if (field == offsetof(bench_stats_t, n)) {
+                out[c][d] = m[c][d].n;
+            } else {
+                out[c][d] = *(const double *)(cell + field) * scale;
+            }
+        }
+    }
+}
+
+void bench_print_stats(FILE * out, const char * title, const char * unit,
+                       bench_stats_t ** m, int ncores, int ndev, double scale) {
+    static const struct {
+        const char * name;
+        size_t field;
+    } columns[] = {
+        { "min",                 offsetof(bench_stats_t, min) },
+        { "median",              offsetof(bench_stats_t, median) },
+        { "mean",                offsetof(bench_stats_t, mean) },
+        { "p90",                 offsetof(bench_stats_t, p90) },
+        { "p99",                 offsetof(bench_stats_t, p99) },
+        { "standard deviation",  offsetof(bench_stats_t, stddev) },
+        { "95% CI half-width",   offsetof(bench_stats_t, ci95) },
+        { "repetitions",         offsetof(bench_stats_t, n) },
+    };
+    double ** tmp = bench_matrix_alloc(ncores, ndev);
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++) {
+        int is_count = columns[i].field == offsetof(bench_stats_t, n);
+        bench_stats_extract(m, ncores, ndev, columns[i].field, scale, tmp);
+        fprintf(out, "##### %s: %s%s%s%s\n", title, columns[i].name,
+                is_count ? "" : " (", is_count ? "" : unit, is_count ? "" : ")");
+        bench_print_matrix(out, tmp, ncores, ndev, 1.0);
+    }
+    bench_matrix_free(tmp, ncores);
+}
@@ -0,0 +1,54 @@
+#ifndef BENCH_STATS_H
+#define BENCH_STATS_H
+
+#include <stdio.h>
+
+#include "counters.h"
+
+// Statistics of the per-repetition samples of one measurement cell
+typedef struct bench_stats {
+    int n;
+    double min;
+    double max;
+    double mean;
+    double median;
+    double p90;
+    double p99;
+    double stddev;
+    double ci95;    // half-width of the 95% confidence interval of the mean
+    double sum;
+    double counters[BENCH_NCOUNTERS];   // host counters per repetition (BENCH_COUNTERS), 0 if not counted
+} bench_stats_t;
+
+// Running mean/variance (Welford) used to decide when to stop sampling.
+typedef struct bench_running {
+    int n;
+    double mean;
+    double m2;
+} bench_running_t;
+
+void bench_running_reset(bench_running_t * r);
+void bench_running_add(bench_running_t * r, double x);
+// Half-width of the 95% confidence interval of the mean relative to the mean.
+double bench_running_rel_ci95(const bench_running_t * r);
+
+// Two-sided 95% quantile of Student's t-distribution.
+double bench_t95(int dof);
+
+// Compute the statistics of n samples. Sorts the samples in place.
+void bench_stats_compute(double * samples, int n, bench_stats_t * st);
+
+// Result matrices of statistics indexed by [core][device].
+bench_stats_t ** bench_stats_matrix_alloc(int ncores, int ndev);
+void bench_stats_matrix_free(bench_stats_t ** m, int ncores);
+
+// Copy one statistic (e.g. offsetof(bench_stats_t, median)) of every cell
+// into a plain [core][device] matrix, multiplied by scale.
+void bench_stats_extract(bench_stats_t ** m, int ncores, int ndev, size_t field, double scale, double ** out);
+
+// Print min, median, mean, p90, p99, standard deviation, confidence
+// interval and number of repetitions as semicolon separated tables.
+void bench_print_stats(FILE * out, const char * title, const char * unit,
+                       bench_stats_t ** m, int ncores, int ndev, double scale);
+
+#endif // BENCH_STATS_H
@@ -0,0 +1,240 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "topology.h"
+
+FILE * bench_sysfs_open(const char * fmt, ...) {
+    const char * root = getenv("BENCH_SYSFS_ROOT");
+    char rel[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(rel, sizeof(rel), fmt, args);
+    va_end(args);
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", root != NULL ? root : "/sys", rel);
+    return fopen(path, "r");
+}
+
+// Read the first line of a sysfs file without the newline. Returns 0 on success.
+static int read_line(char * buf, size_t len, const char * fmt, const char * arg) {
+    FILE * f = bench_sysfs_open(fmt, arg);
+    buf[0] = '\0';
+    if (f == NULL) {
+        return -1;
+    }
+    if (fgets(buf, (int)len, f) == NULL) {
+        buf[0] = '\0';
+    }
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return buf[0] != '\0' ? 0 : -1;
+}
+
+static int read_int(const char * fmt, int arg) {
+    FILE * f = bench_sysfs_open(fmt, arg);
+    int value = -1;
+    if (f != NULL) {
+        if (fscanf(f, "%d", &value) != 1) {
+            value = -1;
+        }
+        fclose(f);
+    }
+    return value;
+}
+
+// Device PCI bus id from the backend or the BENCH_DEVICE_PCI list, in the
+// lower case form sysfs uses.
+static void device_pci(const bench_context_t * ctx, int dev, char * buf, size_t len) {
+    buf[0] = '\0';
+    const char * list = getenv("BENCH_DEVICE_PCI");
+    if (list != NULL) {
+        const char * p = list;
+        for (int d = 0; *p && d <= dev; d++) {
+            size_t n = strcspn(p, ",");
+            if (d == dev && n < len) {
+                memcpy(buf, p, n);
+                buf[n] = '\0';
+            }
+            p += n;
+            if (*p == ',') {
+                p++;
+            }
+        }
+    } else if (ctx->backend->pci_bus_id != NULL) {
+        ctx->backend->pci_bus_id(dev, buf, len);
+    }
+    for (char * c = buf; *c; c++) {
+        *c = (char)tolower((unsigned char)*c);
+    }
+}
+
+int bench_device_numa(const bench_context_t * ctx, int dev) {
+    const char * list = getenv("BENCH_DEVICE_NUMA");
+    if (list != NULL) {
+        const char * p = list;
+        for (int d = 0; *p; d++) {
+            char * end;
+            long node = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            if (d == dev) {
+                return (int)node;
+            }
+            p = (*end == ',') ? end + 1 : end;
+        }
+    }
+    if (ctx->backend->numa_node != NULL) {
+        return ctx->backend->numa_node(dev);
+    }
+    return -1;
+}
+
+void bench_topology_discover(bench_context_t * ctx) {
+    bench_topology_t * topo = (bench_topology_t *)calloc(1, sizeof(bench_topology_t));
+    ctx->topo = topo;
+
+    for (int n = 0; n < BENCH_TOPO_MAX_NODES; n++) {
+        char node[16];
+        snprintf(node, sizeof(node), "%d", n);
+        if (read_line(topo->node_cpus[n], sizeof(topo->node_cpus[n]), "/devices/system/node/node%s/cpulist", node) == 0) {
+            topo->node_present[n] = 1;
+            topo->nnodes++;
+        }
+    }
+    for (int n = 0; n < BENCH_TOPO_MAX_NODES; n++) {
+        FILE * f = topo->node_present[n] ? bench_sysfs_open("/devices/system/node/node%d/distance", n) : NULL;
+        if (f == NULL) {
+            continue;
+        }
+        // distances to all domains in ascending order of their ids
+        int dist;
+        for (int k = 0; k < BENCH_TOPO_MAX_NODES && fscanf(f, "%d", &dist) == 1; k++) {
+            while (k < BENCH_TOPO_MAX_NODES - 1 && !topo->node_present[k]) {
+                k++;
+            }
+            topo->distance[n][k] = dist;
+        }
+        fclose(f);
+    }
+
+    topo->core_package = (int *)malloc(ctx->ncores * sizeof(int));
+    topo->core_l3 = (int *)malloc(ctx->ncores * sizeof(int));
+    for (int c = 0; c < ctx->ncores; c++) {
+        topo->core_package[c] = read_int("/devices/system/cpu/cpu%d/topology/physical_package_id", ctx->core_cpu[c]);
+        topo->core_l3[c] = bench_l3_of_cpu(ctx->core_cpu[c]);
+    }
+
+    for (int d = 0; d < ctx->ndev; d++) {
+        device_pci(ctx, d, topo->dev_pci[d], sizeof(topo->dev_pci[d]));
+        topo->dev_numa[d] = bench_device_numa(ctx, d);
+        if (topo->dev_pci[d][0] == '\0') {
+            continue;
+        }
+        if (topo->dev_numa[d] < 0) {
+            topo->dev_numa[d] = bench_backend_pci_numa(topo->dev_pci[d]);
+        }
+        char speed[32], width[16];
+        if (read_line(speed, sizeof(speed), "/bus/pci/devices/%s/current_link_speed", topo->dev_pci[d]) == 0
+            && read_line(width, sizeof(width), "/bus/pci/devices/%s/current_link_width", topo->dev_pci[d]) == 0) {
+            snprintf(topo->dev_link[d], sizeof(topo->dev_link[d]), "%s x%s", speed, width);
+        }
+    }
+}
+
+void bench_topology_free(bench_context_t * ctx) {
+    if (ctx->topo != NULL) {
+        free(ctx->topo->core_package);
+        free(ctx->topo->core_l3);
+        free(ctx->topo);
+        ctx->topo = NULL;
+    }
+}
+
+void bench_topology_print(const bench_context_t * ctx, FILE * out) {
+    const bench_topology_t * topo = ctx->topo;
+    fprintf(out, "NUMA domains: %d\n", topo->nnodes);
+    for (int n = 0; n < BENCH_TOPO_MAX_NODES; n++) {
+        if (!topo->node_present[n]) {
+            continue;
+        }
+        fprintf(out, "NUMA domain %d: cpus %s, distances", n, topo->node_cpus[n]);
+        for (int k = 0; k < BENCH_TOPO_MAX_NODES; k++) {
+            if (topo->node_present[k]) {
+                fprintf(out, " %d", topo->distance[n][k]);
+            }
+        }
+        fprintf(out, "\n");
+    }
+    for (int d = 0; d < ctx->ndev; d++) {
+        fprintf(out, "device %d: pci %s, NUMA domain %d, link %s\n", d,
+                topo->dev_pci[d][0] ? topo->dev_pci[d] : "unknown", topo->dev_numa[d],
+                topo->dev_link[d][0] ? topo->dev_link[d] : "unknown");
+    }
+}
+
+int bench_topology_distance(const bench_context_t * ctx, int node_a, int node_b) {
+    if (node_a < 0 || node_b < 0) {
+        return -1;
+    }
+    if (node_a < BENCH_TOPO_MAX_NODES && node_b < BENCH_TOPO_MAX_NODES
+        && ctx->topo->distance[node_a][node_b] > 0) {
+        return ctx->topo->distance[node_a][node_b];
+    }
+    return node_a == node_b ? 10 : 20;
+}
+
+void bench_print_by_distance(const bench_context_t * ctx, double ** m, const char * label) {
+    // distinct distances between the cores and the devices, ascending
+    int * dist = (int *)malloc((size_t)ctx->ncores * (ctx->ndev > 0 ? ctx->ndev : 1) * sizeof(int));
+    int ndist = 0;
+    for (int d = 0; d < ctx->ndev; d++) {
+        for (int c = 0; c < ctx->ncores; c++) {
+            int x = bench_topology_distance(ctx, ctx->core_numa[c], ctx->topo->dev_numa[d]);
+            int i = 0;
+            while (i < ndist && dist[i] < x) {
+                i++;
+            }
+            if (x >= 0 && (i == ndist || dist[i] != x)) {
+                memmove(&dist[i + 1], &dist[i], (ndist - i) * sizeof(int));
+                dist[i] = x;
+                ndist++;
+            }
+        }
+    }
+    if (ndist == 0) {
+        free(dist);
+        return;
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "%s by NUMA distance between core and device\n", label);
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, ";");
+    for (int i = 0; i < ndist; i++) {
+        fprintf(stdout, "distance %d%c", dist[i], i<ndist-1 ? ';' : '\n');
+    }
+    for (int d = 0; d < ctx->ndev; d++) {
+        fprintf(stdout, "GPU %d (NUMA %d);", d, ctx->topo->dev_numa[d]);
+        for (int i = 0; i < ndist; i++) {
+            double sum = 0.0;
+            int n = 0;
+            for (int c = 0; c < ctx->ncores; c++) {
+                if (bench_topology_distance(ctx, ctx->core_numa[c], ctx->topo->dev_numa[d]) == dist[i]) {
+                    sum += m[c][d];
+                    n++;
+                }
+            }
+            // empty if no core is at that distance from the device
+            if (n > 0) {
+                fprintf(stdout, "%lf", sum / n);
+            }
+            fprintf(stdout, "%c", i<ndist-1 ? ';' : '\n');
+        }
+    }
+    free(dist);
+}
@@ -0,0 +1,49 @@
+#ifndef BENCH_TOPOLOGY_H
+#define BENCH_TOPOLOGY_H
+
+#include <stdio.h>
+
+#include "backend.h"
+
+struct bench_context;
+
+#define BENCH_TOPO_MAX_NODES 64
+
+// Node topology as found in sysfs (below BENCH_SYSFS_ROOT, default "/sys",
+// so that it can be read from a copy of another machine's sysfs).
+typedef struct bench_topology {
+    int nnodes;                                             // NUMA domains found, 0 if none
+    int node_present[BENCH_TOPO_MAX_NODES];
+    char node_cpus[BENCH_TOPO_MAX_NODES][256];              // cpulist of every domain
+    int distance[BENCH_TOPO_MAX_NODES][BENCH_TOPO_MAX_NODES]; // ACPI SLIT distances, 0 if unknown
+    int * core_package;                                     // socket of every core, -1 if unknown
+    int * core_l3;                                          // L3 cache of every core, -1 if unknown
+    char dev_pci[BENCH_MAX_DEVICES][32];                    // PCI bus id, "" if unknown
+    int dev_numa[BENCH_MAX_DEVICES];                        // NUMA domain, -1 if unknown
+    char dev_link[BENCH_MAX_DEVICES][64];                   // PCIe link speed and width, "" if unknown
+} bench_topology_t;
+
+// Open a file below the sysfs root, path given as printf format.
+FILE * bench_sysfs_open(const char * fmt, ...);
+
+// Discover the topology of the cores and devices of ctx. Device PCI bus ids
+// come from the backend or from BENCH_DEVICE_PCI (comma separated list
+// indexed by device).
+void bench_topology_discover(struct bench_context * ctx);
+void bench_topology_free(struct bench_context * ctx);
+void bench_topology_print(const struct bench_context * ctx, FILE * out);
+
+// NUMA domain a device is attached to: BENCH_DEVICE_NUMA (comma separated
+// list indexed by device) if set, otherwise as reported by the backend.
+// Returns -1 if unknown.
+int bench_device_numa(const struct bench_context * ctx, int dev);
+
+// NUMA distance between two domains: the SLIT distance if known, otherwise
+// 10 within a domain and 20 between domains, -1 if a domain is unknown.
+int bench_topology_distance(const struct bench_context * ctx, int node_a, int node_b);
+
+// Print the mean of a [core][device] matrix over the cores at every NUMA
+// distance from the device, one row per device.
+void bench_print_by_distance(const struct bench_context * ctx, double ** m, const char * label);
+
+#endif // BENCH_TOPOLOGY_H
@@ -0,0 +1,300 @@
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "bench.h"
+#include "config.h"
+
+#ifndef REPS
+#define REPS 100
+#endif
+
+// How the target regions of a batch are distributed over the devices
+enum fanout_dispatch {
+    FANOUT_ROUNDROBIN = 0,  // region i goes to device i mod n
+    FANOUT_BLOCK,           // every device gets its share of regions at once
+    FANOUT_NDISPATCH
+};
+
+static const char * const dispatch_names[FANOUT_NDISPATCH] = { "roundrobin", "block" };
+
+typedef struct fanout_arg {
+    const bench_backend_t * be;
+    int dispatch;
+    int ndev;               // number of devices used
+    int batch;              // target regions per repetition
+    int offset;             // first device of the calling thread
+    bench_devbuf_t * bufs;  // one buffer per device, NULL for empty regions
+} fanout_arg_t;
+
+// one repetition: dispatch a batch of deferred target regions to the
+// devices, then wait for all of them
+static void fanout_rep(void * arg) {
+    fanout_arg_t * a = (fanout_arg_t *)arg;
+    const bench_backend_t * be = a->be;
+    for (int i = 0; i < a->batch; i++) {
+        int k = a->dispatch == FANOUT_ROUNDROBIN ? i % a->ndev : (int)((long)i * a->ndev / a->batch);
+        int d = (k + a->offset) % a->ndev;
+        if (a->bufs == NULL) {
+            if (be->launch_shape != NULL) {
+                bench_launch_t shape = { 0, 0, NULL, 0, 0, 1 };
+                be->launch_shape(d, &shape);
+            } else {
+                be->launch(d, NULL);
+            }
+        } else if (be->roundtrip_nowait != NULL) {
+            be->roundtrip_nowait(&a->bufs[d]);
+        } else {
+            be->copy_h2d(&a->bufs[d], a->bufs[d].size);
+            be->launch(d, &a->bufs[d]);
+            be->copy_d2h(&a->bufs[d], a->bufs[d].size);
+        }
+    }
+    for (int d = 0; d < a->ndev; d++) {
+        be->sync(d);
+    }
+}
+
+// Device counts 1, 2, 4, ... and finally all devices.
+static int device_counts(int ndev, int * counts) {
+    int n = 0;
+    for (int k = 1; k < ndev; k *= 2) {
+        counts[n++] = k;
+    }
+    counts[n++] = ndev;
+    return n;
+}
+
+// Print a table with one row per thread count and one column per device count.
+static void print_fanout_table(FILE * out, const double * m, const int * threads, int nthreads,
+                               const int * devs, int ndevs) {
+    fprintf(out, ";");
+    for (int j = 0; j < ndevs; j++) {
+        fprintf(out, "%d GPUs%c", devs[j], j<ndevs-1 ? ';' : '\n');
+    }
+    for (int i = 0; i < nthreads; i++) {
+        fprintf(out, "%d threads;", threads[i]);
+        for (int j = 0; j < ndevs; j++) {
+            fprintf(out, "%lf%c", m[i * ndevs + j], j<ndevs-1 ? ';' : '\n');
+        }
+    }
+}
+
+static int run(void) {
+    bench_context_t ctx;
+    bench_init(&ctx, "fanout", REPS);
+    const bench_backend_t * be = ctx.backend;
+    int ndev = ctx.ndev;
+
+    // Host thread counts (FANOUT_THREADS, default "1,2,4"), limited to the
+    // number of cores.
+    const char * env = getenv("FANOUT_THREADS");
+    size_t * thread_list = NULL;
+    int nthreads_in = bench_parse_size_list(env ? env : "1,2,4", &thread_list);
+    int * threads = (int *)malloc((nthreads_in > 0 ? nthreads_in : 1) * sizeof(int));
+    int nthreads = 0;
+    for (int i = 0; i < nthreads_in; i++) {
+        if (thread_list[i] <= (size_t)ctx.ncores) {
+            threads[nthreads++] = (int)thread_list[i];
+        }
+    }
+    free(thread_list);
+
+    // Target regions per thread and repetition (FANOUT_BATCH, default 64).
+    env = getenv("FANOUT_BATCH");
+    int batch = env ? atoi(env) : 64;
+    if (batch < 1) {
+        batch = 1;
+    }
+
+    // Empty target regions first, then round trips of every size in
+    // FANOUT_SIZES (default "1M").
+    env = getenv("FANOUT_SIZES");
+    size_t * size_list = NULL;
+    int nsizes_in = bench_parse_size_list(env ? env : "1M", &size_list);
+    int nsizes = nsizes_in + 1;
+    size_t * sizes = (size_t *)malloc(nsizes * sizeof(size_t));
+    size_t max_size = 1;
+    sizes[0] = 0;
+    for (int s = 0; s < nsizes_in; s++) {
+        sizes[s + 1] = size_list[s];
+        if (size_list[s] > max_size) {
+            max_size = size_list[s];
+        }
+    }
+    free(size_list);
+
+    // Dispatch modes (FANOUT_DISPATCH, default both).
+    env = getenv("FANOUT_DISPATCH");
+    int dispatch[FANOUT_NDISPATCH];
+    int ndispatch = 0;
+    for (int k = 0; k < FANOUT_NDISPATCH; k++) {
+        if (env == NULL || strstr(env, dispatch_names[k]) != NULL) {
+            dispatch[ndispatch++] = k;
+        }
+    }
+
+    int * devs = (int *)malloc((ndev > 0 ? ndev : 1) * sizeof(int));
+    int ndevs = ndev > 0 ? device_counts(ndev, devs) : 0;
+
+    fprintf(stdout, "thread counts:");
+    for (int i = 0; i < nthreads; i++) {
+        fprintf(stdout, " %d", threads[i]);
+    }
+    fprintf(stdout, "\n");
+    fprintf(stdout, "target regions per thread and repetition: %d\n", batch);
+    fprintf(stdout, BENCH_SEPARATOR);
+    if (ndev == 0 || nthreads == 0 || ndispatch == 0) {
+        fprintf(stdout, "nothing to measure (devices=%d, thread counts=%d, dispatch modes=%d)\n",
+                ndev, nthreads, ndispatch);
+        free(threads);
+        free(sizes);
+        free(devs);
+        bench_finalize(&ctx);
+        return 0;
+    }
+
+    bench_print_affinity(&ctx);
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_warmup(&ctx);
+
+    // Aggregate target regions per second indexed by [dispatch][size][threads][devices].
+    size_t ncells = (size_t)ndispatch * nsizes * nthreads * ndevs;
+    double * rate = (double *)calloc(ncells, sizeof(double));
+    double * t_start = (double *)malloc(ctx.ncores * sizeof(double));
+    double * t_end = (double *)malloc(ctx.ncores * sizeof(double));
+
+    // Perform the actual measurements.
+    fprintf(stdout, "measurements...\n");
+    for (int i = 0; i < nthreads; i++) {
+        #pragma omp parallel num_threads(threads[i])
+        {
+            int cur_thread = omp_get_thread_num();
+
+            // Every thread has its own host buffer and device memory per device.
+            char * host = (char *)malloc(ndev * max_size);
+            memset(host, 0, ndev * max_size);
+            bench_devbuf_t * bufs = (bench_devbuf_t *)malloc(ndev * sizeof(bench_devbuf_t));
+            for (int d = 0; d < ndev; d++) {
+                be->init_device(d);
+            }
+
+            for (int s = 0; s < nsizes; s++) {
+                for (int d = 0; d < ndev && sizes[s] > 0; d++) {
+                    bench_devbuf_t buf = { d, host + d * max_size, sizes[s], NULL };
+                    bufs[d] = buf;
+                    if (be->map_to != NULL) {
+                        be->map_to(&bufs[d]);
+                    } else {
+                        be->alloc(&bufs[d]);
+                    }
+                }
+
+                for (int p = 0; p < ndispatch; p++) {
+                    for (int j = 0; j < ndevs; j++) {
+                        #pragma omp single
+                        {
+                            bench_progress("running for %3d threads, size=%7.2fMB, %2d devices and %s dispatch\n",
+                                           threads[i], sizes[s] / 1e6, devs[j], dispatch_names[dispatch[p]]);
+                        }
+                        // implicit barrier of single: all threads start together
+                        fanout_arg_t a = { be, dispatch[p], devs[j], batch, cur_thread % devs[j],
+                                           sizes[s] > 0 ? bufs : NULL };
+                        bench_stats_t st;
+                        double ts = omp_get_wtime();
+                        bench_sample(&ctx, fanout_rep, &a, 0, &st);
+                        double te = omp_get_wtime();
+                        t_start[cur_thread] = ts;
+                        t_end[cur_thread] = te;
+                        #pragma omp barrier
+                        #pragma omp single
+                        {
+                            double first = DBL_MAX, last = 0.0;
+                            for (int t = 0; t < threads[i]; t++) {
+                                first = t_start[t] < first ? t_start[t] : first;
+                                last = t_end[t] > last ? t_end[t] : last;
+                            }
+                            double regions = (double)threads[i] * batch * ctx.reps;
+                            size_t idx = (((size_t)p * nsizes + s) * nthreads + i) * ndevs + j;
+                            rate[idx] = regions / (last - first);
+
+                            char variant[64];
+                            snprintf(variant, sizeof(variant), "dispatch=%s,threads=%d,devices=%d",
+                                     dispatch_names[dispatch[p]], threads[i], devs[j]);
+                            bench_record_t rec;
+                            bench_record_init(&rec, "fanout", -1, -1, sizes[s]);
+                            rec.variant = variant;
+                            bench_record_add(&rec, "threads", threads[i]);
+                            bench_record_add(&rec, "devices", devs[j]);
+                            bench_record_add(&rec, "regions_per_sec", rate[idx]);
+                            bench_record_add(&rec, "bandwidth_mbs", rate[idx] * sizes[s] * 2 / 1e6);
+                            bench_output_record(&ctx, &rec);
+                        }
+                    }
+                }
+
+                for (int d = 0; d < ndev && sizes[s] > 0; d++) {
+                    if (be->unmap_from != NULL) {
+                        be->unmap_from(&bufs[d]);
+                    } else {
+                        be->free(&bufs[d]);
+                    }
+                }
+            }
+            free(bufs);
+            free(host);
+        }
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    double * tmp = (double *)malloc((size_t)nthreads * ndevs * sizeof(double));
+    for (int p = 0; p < ndispatch; p++) {
+        for (int s = 0; s < nsizes; s++) {
+            const double * r = &rate[((size_t)p * nsizes + s) * nthreads * ndevs];
+            fprintf(stdout, BENCH_SEPARATOR);
+            if (sizes[s] == 0) {
+                fprintf(stdout, "Aggregate launches per second, %s dispatch, empty target regions\n",
+                        dispatch_names[dispatch[p]]);
+                fprintf(stdout, BENCH_SEPARATOR);
+                print_fanout_table(stdout, r, threads, nthreads, devs, ndevs);
+            } else {
+                fprintf(stdout, "Aggregate bandwidth, %s dispatch (MB/s)\n", dispatch_names[dispatch[p]]);
+                fprintf(stdout, BENCH_SEPARATOR);
+                fprintf(stdout, "##### Problem Size: %.2f KB\n", sizes[s] / 1000.0);
+                for (int k = 0; k < nthreads * ndevs; k++) {
+                    tmp[k] = r[k] * sizes[s] * 2 / 1e6;
+                }
+                print_fanout_table(stdout, tmp, threads, nthreads, devs, ndevs);
+            }
+
+            // Scaling with the number of devices: ideally the number of
+            // devices, flat if dispatch serializes.
+            fprintf(stdout, BENCH_SEPARATOR);
+            fprintf(stdout, "Speedup over 1 GPU, %s dispatch, size %.2f KB\n",
+                    dispatch_names[dispatch[p]], sizes[s] / 1000.0);
+            fprintf(stdout, BENCH_SEPARATOR);
+            for (int k = 0; k < nthreads * ndevs; k++) {
+                tmp[k] = r[k] / r[(k / ndevs) * ndevs];
+            }
+            print_fanout_table(stdout, tmp, threads, nthreads, devs, ndevs);
+        }
+    }
+
+    // cleanup
+    free(tmp);
+    free(rate);
+    free(t_start);
+    free(t_end);
+    free(threads);
+    free(sizes);
+    free(devs);
+    bench_finalize(&ctx);
+
+    return 0;
+}
+
+int main(int argc, char const * argv[]) {
+    return bench_config_main(argc, argv, "fanout", run);
+}
@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "bench.h"
+#include "config.h"
+#include "placement.h"
+
+#ifndef REPS
+#define REPS 10
+#endif
+
+// Host-only reference for the offload bandwidths: copies between buffers on
+// every pair of NUMA domains, executed by every core, and all cores at once
+// (STREAM copy). Bandwidths count the bytes read and written (2 x size) like
+// STREAM and the round trips of the bandwidth benchmark.
+
+// Copy kernels (HOSTMEM_KERNELS)
+enum hostmem_kernel {
+    HM_MEMCPY = 0,  // C library memcpy
+    HM_SIMD,        // vector loads and stores
+    HM_NT,          // vector loads and non-temporal stores that bypass the caches
+    HM_NKERNELS
+};
+
+static const char * const kernel_names[HM_NKERNELS] = { "memcpy", "simd", "nt" };
+
+#if defined(__AVX__)
+typedef __m256i hm_vec_t;
+#define HM_LOAD(p)      _mm256_loadu_si256((const __m256i *)(p))
+#define HM_STORE(p, v)  _mm256_store_si256((__m256i *)(p), v)
+#define HM_STREAM(p, v) _mm256_stream_si256((__m256i *)(p), v)
+#elif defined(__SSE2__)
+typedef __m128i hm_vec_t;
+#define HM_LOAD(p)      _mm_loadu_si128((const __m128i *)(p))
+#define HM_STORE(p, v)  _mm_store_si128((__m128i *)(p), v)
+#define HM_STREAM(p, v) _mm_stream_si128((__m128i *)(p), v)
+#endif
+
+// Vector copy with regular or non-temporal stores, dst aligned to the
+// vector size. Without vector instructions both fall back to memcpy.
+static void copy_vec(char * dst, const char * src, size_t size, int nontemporal) {
+#ifdef HM_LOAD
+    size_t n = size / (4 * sizeof(hm_vec_t)) * (4 * sizeof(hm_vec_t));
+    if (nontemporal) {
+        for (size_t i = 0; i < n; i += 4 * sizeof(hm_vec_t)) {
+            hm_vec_t v0 = HM_LOAD(src + i);
+            hm_vec_t v1 = HM_LOAD(src + i + sizeof(hm_vec_t));
+            hm_vec_t v2 = HM_LOAD(src + i + 2 * sizeof(hm_vec_t));
+            hm_vec_t v3 = HM_LOAD(src + i + 3 * sizeof(hm_vec_t));
+            HM_STREAM(dst + i, v0);
+            HM_STREAM(dst + i + sizeof(hm_vec_t), v1);
+            HM_STREAM(dst + i + 2 * sizeof(hm_vec_t), v2);
+            HM_STREAM(dst + i + 3 * sizeof(hm_vec_t), v3);
+        }
+        _mm_sfence();
+    } else {
+        for (size_t i = 0; i < n; i += 4 * sizeof(hm_vec_t)) {
+            hm_vec_t v0 = HM_LOAD(src + i);
+            hm_vec_t v1 = HM_LOAD(src + i + sizeof(hm_vec_t));
+            hm_vec_t v2 = HM_LOAD(src + i + 2 * sizeof(hm_vec_t));
+            hm_vec_t v3 = HM_LOAD(src + i + 3 * sizeof(hm_vec_t));
+            HM_STORE(dst + i, v0);
+            HM_STORE(dst + i + sizeof(hm_vec_t), v1);
+            HM_STORE(dst + i + 2 * sizeof(hm_vec_t), v2);
+            HM_STORE(dst + i + 3 * sizeof(hm_vec_t), v3);
+        }
+    }
+    memcpy(dst + n, src + n, size - n);
+#else
+    memcpy(dst, src, size);
+#endif
+}
+
+static int kernel_available(int k) {
+#ifdef HM_LOAD
+    return 1;
+#else
+    return k == HM_MEMCPY;
+#endif
+}
+
+static void copy_kernel(int k, char * dst, const char * src, size_t size) {
+    if (k == HM_MEMCPY) {
+        memcpy(dst, src, size);
+    } else {
+        copy_vec(dst, src, size, k == HM_NT);
+    }
+}
+
+typedef struct copy_arg {
+    int kernel;
+    char * dst;
+    const char * src;
+    size_t size;
+    int nthreads;           // > 0: all threads copy a slice each (STREAM)
+} copy_arg_t;
+
+// one repetition: copy size bytes from src to dst
+static void copy_rep(void * arg) {
+    copy_arg_t * a = (copy_arg_t *)arg;
+    copy_kernel(a->kernel, a->dst, a->src, a->size);
+}
+
+// one repetition of the STREAM copy: every thread copies its slice,
+// aligned to 4 KB so that the vector stores stay aligned
+static void stream_rep(void * arg) {
+    copy_arg_t * a = (copy_arg_t *)arg;
+    #pragma omp parallel num_threads(a->nthreads)
+    {
+        int t = omp_get_thread_num();
+        size_t chunk = (a->size / a->nthreads + 4095) / 4096 * 4096;
+        size_t begin = (size_t)t * chunk;
+        if (begin < a->size) {
+            size_t len = a->size - begin < chunk ? a->size - begin : chunk;
+            copy_kernel(a->kernel, a->dst + begin, a->src + begin, len);
+        }
+    }
+}
+
+typedef struct hostmem_data {
+    int nnodes;             // NUMA domains used, 1 without NUMA support
+    int * nodes;            // their ids, -1 for first-touch (local) placement
+    int npairs;             // source and destination domain of every pair
+    int * pair_src;
+    int * pair_dst;
+    char ** src;            // source and destination buffer per domain
+    char ** dst;
+    int nkernels;
+    int * kernels;
+    int nsizes;
+    size_t * sizes;
+    bench_stats_t **** stats;   // [kernel][size][core][pair]
+} hostmem_data_t;
+
+static void measure_core(bench_context_t * ctx, int c, void * arg) {
+    hostmem_data_t * data = (hostmem_data_t *)arg;
+    for (int p = 0; p < data->npairs; p++) {
+        copy_arg_t a = { 0, data->dst[data->pair_dst[p]], data->src[data->pair_src[p]], 0, 0 };
+        for (int k = 0; k < data->nkernels; k++) {
+            for (int s = 0; s < data->nsizes; s++) {
+                bench_progress("running for thread=%3d, NUMA %d -> %d, kernel %s and size=%zu\n", c,
+                               data->nodes[data->pair_src[p]], data->nodes[data->pair_dst[p]],
+                               kernel_names[data->kernels[k]], data->sizes[s]);
+                a.kernel = data->kernels[k];
+                a.size = data->sizes[s];
+                bench_sample(ctx, copy_rep, &a, 1, &data->stats[k][s][c][p]);
+            }
+        }
+    }
+}
+
+// Row and column label of a domain, "local" for first-touch placement.
+static void print_node(int node) {
+    if (node < 0) {
+        fprintf(stdout, "local");
+    } else {
+        fprintf(stdout, "NUMA %d", node);
+    }
+}
+
+// Print a [core][pair] matrix with one row per pair of NUMA domains.
+static void print_pairs(const bench_context_t * ctx, const hostmem_data_t * data, double ** m) {
+    fprintf(stdout, ";");
+    for (int c = 0; c < ctx->ncores; c++) {
+        fprintf(stdout, "Core %d%c", c, c<ctx->ncores-1 ? ';' : '\n');
+    }
+    for (int p = 0; p < data->npairs; p++) {
+        print_node(data->nodes[data->pair_src[p]]);
+        fprintf(stdout, " -> ");
+        print_node(data->nodes[data->pair_dst[p]]);
+        fprintf(stdout, ";");
+        for (int c = 0; c < ctx->ncores; c++) {
+            fprintf(stdout, "%lf%c", m[c][p], c<ctx->ncores-1 ? ';' : '\n');
+        }
+    }
+}
+
+static void format_variant(char * buf, size_t len, const hostmem_data_t * data, int k, int p) {
+    snprintf(buf, len, "kernel=%s,src=%d,dst=%d", kernel_names[data->kernels[k]],
+             data->nodes[data->pair_src[p]], data->nodes[data->pair_dst[p]]);
+}
+
+// Report the copies of every core: records, bandwidth matrices and the
+// bandwidth relative to the copy within the core's own NUMA domain.
+static void report_cores(bench_context_t * ctx, hostmem_data_t * data) {
+    double ** bw = bench_matrix_alloc(ctx->ncores, data->npairs);
+    for (int k = 0; k < data->nkernels; k++) {
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Single core copy %s: absolute measurements (MB/s)\n", kernel_names[data->kernels[k]]);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < data->nsizes; s++) {
+            bench_stats_t ** st = data->stats[k][s];
+            for (int c = 0; c < ctx->ncores; c++) {
+                for (int p = 0; p < data->npairs; p++) {
+                    bw[c][p] = 2.0 * data->sizes[s] / 1e6 / st[c][p].mean;
+                    if (!bench_core_measured(ctx, c)) {
+                        continue;
+                    }
+                    char variant[64];
+                    format_variant(variant, sizeof(variant), data, k, p);
+                    bench_record_t rec;
+                    bench_record_init(&rec, "copy", c, -1, data->sizes[s]);
+                    rec.variant = variant;
+                    rec.stats = &st[c][p];
+                    bench_record_add(&rec, "bandwidth_mbs", bw[c][p]);
+                    bench_output_record(ctx, &rec);
+                }
+            }
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", data->sizes[s] / 1000.0);
+            print_pairs(ctx, data, bw);
+        }
+    }
+
+    // the local copy of a core: source and destination in its own domain
+    if (data->npairs > 1) {
+        double ** rel = bench_matrix_alloc(ctx->ncores, data->npairs);
+        for (int k = 0; k < data->nkernels; k++) {
+            fprintf(stdout, BENCH_SEPARATOR);
+            fprintf(stdout, "Single core copy %s: relative to the copy within the core's NUMA domain\n",
+                    kernel_names[data->kernels[k]]);
+            fprintf(stdout, BENCH_SEPARATOR);
+            for (int s = 0; s < data->nsizes; s++) {
+                bench_stats_t ** st = data->stats[k][s];
+                for (int c = 0; c < ctx->ncores; c++) {
+                    int local = -1;
+                    for (int p = 0; p < data->npairs; p++) {
+                        if (data->nodes[data->pair_src[p]] == ctx->core_numa[c]
+                            && data->pair_src[p] == data->pair_dst[p]) {
+                            local = p;
+                        }
+                    }
+                    for (int p = 0; p < data->npairs; p++) {
+                        rel[c][p] = local >= 0 ? st[c][local].mean / st[c][p].mean : 0.0;
+                    }
+                }
+                fprintf(stdout, "##### Problem Size: %.2f KB\n", data->sizes[s] / 1000.0);
+                print_pairs(ctx, data, rel);
+            }
+        }
+        bench_matrix_free(rel, ctx->ncores);
+    }
+    bench_matrix_free(bw, ctx->ncores);
+}
+
+// STREAM copy with all cores for every pair of NUMA domains, one matrix
+// (source domain x destination domain) per kernel and size.
+static void run_stream(bench_context_t * ctx, hostmem_data_t * data) {
+    int n = data->nnodes;
+    double * bw = (double *)calloc((size_t)n * n, sizeof(double));
+    for (int k = 0; k < data->nkernels; k++) {
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "STREAM copy %s with %d threads (MB/s)\n", kernel_names[data->kernels[k]], ctx->ncores);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < data->nsizes; s++) {
+            for (int p = 0; p < data->npairs; p++) {
+                bench_progress("running STREAM copy %s for NUMA %d -> %d and size=%zu\n",
+                               kernel_names[data->kernels[k]], data->nodes[data->pair_src[p]],
+                               data->nodes[data->pair_dst[p]], data->sizes[s]);
+                copy_arg_t a = { data->kernels[k], data->dst[data->pair_dst[p]], data->src[data->pair_src[p]],
+                                 data->sizes[s], ctx->ncores };
+                bench_stats_t st;
+                bench_sample(ctx, stream_rep, &a, 1, &st);
+                double b = 2.0 * data->sizes[s] / 1e6 / st.mean;
+                bw[data->pair_src[p] * n + data->pair_dst[p]] = b;
+
+                char variant[64];
+                format_variant(variant, sizeof(variant), data, k, p);
+                bench_record_t rec;
+                bench_record_init(&rec, "stream", -1, -1, data->sizes[s]);
+                rec.variant = variant;
+                rec.stats = &st;
+                bench_record_add(&rec, "bandwidth_mbs", b);
+                bench_record_add(&rec, "threads", ctx->ncores);
+                bench_output_record(ctx, &rec);
+            }
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", data->sizes[s] / 1000.0);
+            fprintf(stdout, "source \\ destination");
+            for (int j = 0; j < n; j++) {
+                fprintf(stdout, ";");
+                print_node(data->nodes[j]);
+            }
+            fprintf(stdout, "\n");
+            for (int i = 0; i < n; i++) {
+                print_node(data->nodes[i]);
+                for (int j = 0; j < n; j++) {
+                    fprintf(stdout, ";%lf", bw[i * n + j]);
+                }
+                fprintf(stdout, "\n");
+            }
+        }
+    }
+    free(bw);
+}
+
+// NUMA domains (HOSTMEM_NODES, default all) the buffers are placed on.
+// Without libnuma a single pair of first-touch buffers is used.
+static void setup_nodes(bench_context_t * ctx, hostmem_data_t * data) {
+    data->nodes = (int *)malloc(BENCH_TOPO_MAX_NODES * sizeof(int));
+    data->nnodes = 0;
+    if (bench_numa_num_nodes() > 1 && ctx->topo->nnodes > 1) {
+        const char * env = getenv("HOSTMEM_NODES");
+        size_t * list = NULL;
+        int nlist = env ? bench_parse_size_list(env, &list) : 0;
+        for (int i = 0; i < BENCH_TOPO_MAX_NODES; i++) {
+            int use = ctx->topo->node_present[i] && nlist == 0;
+            for (int j = 0; j < nlist; j++) {
+                use |= ctx->topo->node_present[i] && list[j] == (size_t)i;
+            }
+            if (use) {
+                data->nodes[data->nnodes++] = i;
+            }
+        }
+        free(list);
+    }
+    if (data->nnodes == 0) {
+        data->nodes[data->nnodes++] = -1;
+    }
+    data->npairs = data->nnodes * data->nnodes;
+    data->pair_src = (int *)malloc(data->npairs * sizeof(int));
+    data->pair_dst = (int *)malloc(data->npairs * sizeof(int));
+    for (int i = 0; i < data->nnodes; i++) {
+        for (int j = 0; j < data->nnodes; j++) {
+            data->pair_src[i * data->nnodes + j] = i;
+            data->pair_dst[i * data->nnodes + j] = j;
+        }
+    }
+}
+
+// Copy kernels (HOSTMEM_KERNELS, default all available).
+static void setup_kernels(hostmem_data_t * data) {
+    const char * spec = getenv("HOSTMEM_KERNELS");
+    data->kernels = (int *)malloc(HM_NKERNELS * sizeof(int));
+    data->nkernels = 0;
+    for (int k = 0; k < HM_NKERNELS; k++) {
+        int selected = spec == NULL;
+        for (const char * p = spec; p != NULL && *p; ) {
+            size_t n = strcspn(p, ",");
+            selected |= n == strlen(kernel_names[k]) && strncmp(p, kernel_names[k], n) == 0;
+            p += n;
+            if (*p == ',') {
+                p++;
+            }
+        }
+        if (selected && !kernel_available(k)) {
+            fprintf(stderr, "copy kernel %s is not available on this architecture\n", kernel_names[k]);
+        } else if (selected) {
+            data->kernels[data->nkernels++] = k;
+        }
+    }
+}
+
+static int run(void) {
+    // CPU only, no emulated devices
+    setenv("BENCH_HOST_DEVICES", "0", 0);
+    bench_context_t ctx;
+    bench_init(&ctx, "hostmem", REPS);
+
+    hostmem_data_t data;
+    memset(&data, 0, sizeof(data));
+    setup_nodes(&ctx, &data);
+    setup_kernels(&data);
+    const char * env = getenv("HOSTMEM_SIZES");
+    data.nsizes = bench_parse_size_list(env ? env : "64M", &data.sizes);
+    size_t max_size = 0;
+    for (int s = 0; s < data.nsizes; s++) {
+        max_size = data.sizes[s] > max_size ? data.sizes[s] : max_size;
+    }
+
+    fprintf(stdout, "NUMA domains:");
+    for (int i = 0; i < data.nnodes; i++) {
+        if (data.nodes[i] < 0) {
+            fprintf(stdout, " local (first touch)");
+        } else {
+            fprintf(stdout, " %d", data.nodes[i]);
+        }
+    }
+    fprintf(stdout, "\ncopy kernels:");
+    for (int k = 0; k < data.nkernels; k++) {
+        fprintf(stdout, " %s", kernel_names[data.kernels[k]]);
+    }
+    fprintf(stdout, "\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // source and destination buffer on every domain, placed and touched once
+    data.src = (char **)malloc(data.nnodes * sizeof(char *));
+    data.dst = (char **)malloc(data.nnodes * sizeof(char *));
+    for (int i = 0; i < data.nnodes; i++) {
+        data.src[i] = bench_buffer_alloc(max_size);
+        data.dst[i] = bench_buffer_alloc(max_size);
+        if (data.nodes[i] < 0) {
+            memset(data.src[i], 1, max_size);
+            memset(data.dst[i], 0, max_size);
+        } else if (bench_buffer_place(data.src[i], max_size, BENCH_PAGES_DEFAULT, data.nodes[i]) != 0
+                   || bench_buffer_place(data.dst[i], max_size, BENCH_PAGES_DEFAULT, data.nodes[i]) != 0) {
+            fprintf(stderr, "could not place buffers on NUMA domain %d\n", data.nodes[i]);
+        }
+    }
+
+    data.stats = (bench_stats_t ****)malloc(data.nkernels * sizeof(bench_stats_t ***));
+    for (int k = 0; k < data.nkernels; k++) {
+        data.stats[k] = (bench_stats_t ***)malloc(data.nsizes * sizeof(bench_stats_t **));
+        for (int s = 0; s < data.nsizes; s++) {
+            data.stats[k][s] = bench_stats_matrix_alloc(ctx.ncores, data.npairs);
+        }
+    }
+
+    bench_print_affinity(&ctx);
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    fprintf(stdout, "measurements...\n");
+    bench_sweep_cores(&ctx, measure_core, &data);
+    for (int k = 0; k < data.nkernels; k++) {
+        for (int s = 0; s < data.nsizes; s++) {
+            bench_sweep_fill_rows(&ctx, (void **)data.stats[k][s], data.npairs * sizeof(bench_stats_t));
+        }
+    }
+    report_cores(&ctx, &data);
+
+    // HOSTMEM_STREAM=0 skips the copies with all cores
+    env = getenv("HOSTMEM_STREAM");
+    if (env == NULL || atoi(env) != 0) {
+        run_stream(&ctx, &data);
+    }
+
+    // cleanup
+    for (int k = 0; k < data.nkernels; k++) {
+        for (int s = 0; s < data.nsizes; s++) {
+            bench_stats_matrix_free(data.stats[k][s], ctx.ncores);
+        }
+        free(data.stats[k]);
+    }
+    free(data.stats);
+    for (int i = 0; i < data.nnodes; i++) {
+        bench_buffer_free(data.src[i], max_size);
+        bench_buffer_free(data.dst[i], max_size);
+    }
+    free(data.src);
+    free(data.dst);
+    free(data.nodes);
+    free(data.pair_src);
+    free(data.pair_dst);
+    free(data.kernels);
+    free(data.sizes);
+    bench_finalize(&ctx);
+
+    return 0;
+}
+
+int main(int argc, char const * argv[]) {
+    return bench_config_main(argc, argv, "hostmem", run);
+}
@@ -0,0 +1,582 @@
+#include <float.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "bench.h"
+#include "config.h"
+#include "ompt_tool.h"
+
+#ifndef REPS
+#define REPS 100000
+#endif
+
+typedef struct launch_arg {
+    const bench_backend_t * be;
+    int dev;
+} launch_arg_t;
+
+// one repetition: launch an empty kernel and wait for its completion
+static void launch_rep(void * arg) {
+    launch_arg_t * a = (launch_arg_t *)arg;
+    a->be->launch(a->dev, NULL);
+    a->be->sync(a->dev);
+}
+
+typedef struct sweep_data {
+    bench_stats_t ** stats;
+    bench_ompt_phases_t ** phases;  // NULL if OMPT tracing is inactive
+} sweep_data_t;
+
+static void measure_core(bench_context_t * ctx, int c, void * arg) {
+    sweep_data_t * data = (sweep_data_t *)arg;
+    launch_arg_t a = { ctx->backend, 0 };
+
+    for (int d = 0; d < ctx->ndev; d++) {
+        bench_progress("running for thread=%3d and device=%2d\n", c, d);
+        ctx->backend->init_device(d);
+
+        a.dev = d;
+        // the cores are measured one after another, so the traced phases
+        // belong to this core and device
+        bench_ompt_reset();
+        bench_sample(ctx, launch_rep, &a, 1, &data->stats[c][d]);
+        if (data->phases != NULL) {
+            bench_ompt_read(&data->phases[c][d]);
+        }
+    }
+}
+
+// Print the per-construct time of every target region phase, averaged over
+// the measured cores, next to the measured latency (which additionally
+// contains the time outside of the target construct, e.g. the wait for
+// completion), one row per device.
+static void print_phases(const bench_context_t * ctx, bench_ompt_phases_t ** phases, double ** latency) {
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Target region phases per launch (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, ";regions");
+    for (int p = 0; p < BENCH_OMPT_NPHASES; p++) {
+        fprintf(stdout, ";%s", bench_ompt_phase_names[p]);
+    }
+    fprintf(stdout, ";traced;latency\n");
+    for (int d = 0; d < ctx->ndev; d++) {
+        bench_ompt_phases_t sum;
+        memset(&sum, 0, sizeof(sum));
+        double lat = 0.0;
+        int n = 0;
+        for (int c = 0; c < ctx->ncores; c++) {
+            if (!bench_core_measured(ctx, c)) {
+                continue;
+            }
+            sum.regions += phases[c][d].regions;
+            for (int p = 0; p < BENCH_OMPT_NPHASES; p++) {
+                sum.time[p] += phases[c][d].time[p];
+            }
+            lat += latency[c][d];
+            n++;
+        }
+        double regions = sum.regions > 0 ? (double)sum.regions : 1.0;
+        double traced = 0.0;
+        fprintf(stdout, "GPU %d;%lu", d, sum.regions);
+        for (int p = 0; p < BENCH_OMPT_NPHASES; p++) {
+            fprintf(stdout, ";%lf", sum.time[p] / regions * 1e6);
+            traced += sum.time[p] / regions * 1e6;
+        }
+        fprintf(stdout, ";%lf;%lf\n", traced, n > 0 ? lat / n : 0.0);
+    }
+}
+
+// Launch overhead breakdown (LAT_BREAKDOWN=1)
+typedef struct shape_arg {
+    const bench_backend_t * be;
+    int dev;
+    int batch;                  // launches per repetition
+    bench_launch_t shape;
+} shape_arg_t;
+
+// one repetition: batch shaped launches, then wait for all of them
+static void shape_rep(void * arg) {
+    shape_arg_t * a = (shape_arg_t *)arg;
+    for (int i = 0; i < a->batch; i++) {
+        a->be->launch_shape(a->dev, &a->shape);
+    }
+    a->be->sync(a->dev);
+}
+
+// Round an argument count up to the next supported one (0 or a power of two
+// up to max).
+static int round_count(size_t n, int max) {
+    int r = 1;
+    while (r < (int)n && r < max) {
+        r *= 2;
+    }
+    return n == 0 ? 0 : r;
+}
+
+// Parse grid shapes like "1x1,1x256,full" into teams and threads. Returns
+// the number of shapes.
+static int parse_grids(const char * spec, int * teams, int * threads, int max) {
+    int n = 0;
+    const char * p = spec;
+    while (*p && n < max) {
+        if (strncmp(p, "full", 4) == 0) {
+            teams[n] = BENCH_LAUNCH_FULL;
+            threads[n] = 0;
+            p += 4;
+        } else {
+            char * end;
+            long t = strtol(p, &end, 10);
+            if (end == p || *end != 'x') {
+                break;
+            }
+            p = end + 1;
+            long l = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            p = end;
+            if (t < 1 || l < 1) {
+                continue;
+            }
+            teams[n] = (int)t;
+            threads[n] = (int)l;
+        }
+        n++;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return n;
+}
+
+// Breakdown mode: per-launch time of empty kernels with firstprivate scalar
+// arguments (LAT_SCALARS, default "1,2,4,8,16"), pointer arguments
+// (LAT_POINTERS, default "1,2,4,8"; OpenMP: mapped and present on the device)
+// and grid shapes (LAT_GRIDS, default "1x1,1x256,64x256,full"), each
+// completed synchronously and as a batch of LAT_BATCH (default 100) deferred
+// launches. The overhead of a component is its per-launch time minus the one
+// of the empty single-thread launch. Measured from a single core
+// (LAT_BREAKDOWN_CORE, default 0) to every device.
+static void run_breakdown(bench_context_t * ctx) {
+    const bench_backend_t * be = ctx->backend;
+    int ndev = ctx->ndev;
+    const char * env = getenv("LAT_BREAKDOWN_CORE");
+    int core = env ? atoi(env) : 0;
+    if (core < 0 || core >= ctx->ncores) {
+        core = 0;
+    }
+    env = getenv("LAT_BATCH");
+    int batch = env ? atoi(env) : 100;
+    if (batch < 1) {
+        batch = 1;
+    }
+    if (be->launch_shape == NULL || ndev == 0) {
+        fprintf(stdout, "breakdown mode: nothing to measure (devices=%d, shaped launches %s)\n",
+                ndev, be->launch_shape != NULL ? "supported" : "not supported");
+        return;
+    }
+
+    // Build the list of launch shapes, the empty single-thread launch first.
+    const char * scalar_spec = getenv("LAT_SCALARS");
+    const char * pointer_spec = getenv("LAT_POINTERS");
+    const char * grid_spec = getenv("LAT_GRIDS");
+    size_t * scalars = NULL;
+    size_t * pointers = NULL;
+    int nscalars = bench_parse_size_list(scalar_spec ? scalar_spec : "1,2,4,8,16", &scalars);
+    int npointers = bench_parse_size_list(pointer_spec ? pointer_spec : "1,2,4,8", &pointers);
+    grid_spec = grid_spec ? grid_spec : "1x1,1x256,64x256,full";
+    int ngrids_max = 1;
+    for (const char * p = grid_spec; *p; p++) {
+        ngrids_max += (*p == ',');
+    }
+    int * teams = (int *)malloc(ngrids_max * sizeof(int));
+    int * threads = (int *)malloc(ngrids_max * sizeof(int));
+    int ngrids = parse_grids(grid_spec, teams, threads, ngrids_max);
+
+    int nshapes = 1 + nscalars + npointers + ngrids;
+    bench_launch_t * shapes = (bench_launch_t *)calloc(nshapes, sizeof(bench_launch_t));
+    char (*names)[32] = malloc(nshapes * sizeof(*names));
+    int k = 0;
+    snprintf(names[k++], sizeof(names[0]), "empty");
+    for (int i = 0; i < nscalars; i++, k++) {
+        shapes[k].nscalars = round_count(scalars[i], BENCH_MAX_LAUNCH_SCALARS);
+        snprintf(names[k], sizeof(names[0]), "scalars=%d", shapes[k].nscalars);
+    }
+    for (int i = 0; i < npointers; i++, k++) {
+        shapes[k].nptrs = round_count(pointers[i], BENCH_MAX_LAUNCH_PTRS);
+        snprintf(names[k], sizeof(names[0]), "pointers=%d", shapes[k].nptrs);
+    }
+    for (int i = 0; i < ngrids; i++, k++) {
+        shapes[k].teams = teams[i];
+        shapes[k].threads = threads[i];
+        if (teams[i] == BENCH_LAUNCH_FULL) {
+            snprintf(names[k], sizeof(names[0]), "grid=full");
+        } else {
+            snprintf(names[k], sizeof(names[0]), "grid=%dx%d", teams[i], threads[i]);
+        }
+    }
+
+    fprintf(stdout, "breakdown mode: core %d, %d launch shapes, batch of %d deferred launches\n",
+            core, nshapes, batch);
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // Per-launch time in us indexed by [device][shape][completion].
+    double * time = (double *)calloc((size_t)ndev * nshapes * 2, sizeof(double));
+
+    #pragma omp parallel num_threads(ctx->ncores)
+    {
+        if (omp_get_thread_num() == core) {
+            for (int d = 0; d < ndev; d++) {
+                be->init_device(d);
+
+                // pointer arguments refer to small buffers that stay on the device
+                char host[BENCH_MAX_LAUNCH_PTRS][64];
+                bench_devbuf_t bufs[BENCH_MAX_LAUNCH_PTRS];
+                for (int i = 0; i < BENCH_MAX_LAUNCH_PTRS; i++) {
+                    bench_devbuf_t b = { d, host[i], sizeof(host[i]), NULL };
+                    memset(host[i], 0, sizeof(host[i]));
+                    bufs[i] = b;
+                    if (be->map_to != NULL) {
+                        be->map_to(&bufs[i]);
+                    } else {
+                        be->alloc(&bufs[i]);
+                    }
+                }
+
+                for (int j = 0; j < nshapes; j++) {
+                    for (int w = 0; w < 2; w++) {
+                        bench_progress("running for device=%2d, %s and %s completion\n",
+                                       d, names[j], w ? "nowait" : "sync");
+                        shape_arg_t a = { be, d, w ? batch : 1, shapes[j] };
+                        a.shape.bufs = bufs;
+                        a.shape.nowait = w;
+                        bench_stats_t st;
+                        bench_sample(ctx, shape_rep, &a, 1, &st);
+                        double per_launch = st.mean / a.batch * 1e6;
+                        time[((size_t)d * nshapes + j) * 2 + w] = per_launch;
+
+                        char variant[64];
+                        snprintf(variant, sizeof(variant), "%s,completion=%s", names[j], w ? "nowait" : "sync");
+                        bench_record_t rec;
+                        bench_record_init(&rec, "launch", core, d, 0);
+                        rec.variant = variant;
+                        rec.stats = &st;
+                        bench_record_add(&rec, "launches", a.batch);
+                        bench_record_add(&rec, "per_launch_us", per_launch);
+                        bench_output_record(ctx, &rec);
+                    }
+                }
+
+                for (int i = 0; i < BENCH_MAX_LAUNCH_PTRS; i++) {
+                    if (be->unmap_from != NULL) {
+                        be->unmap_from(&bufs[i]);
+                    } else {
+                        be->free(&bufs[i]);
+                    }
+                }
+            }
+        }
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Launch overhead breakdown per launch (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    for (int d = 0; d < ndev; d++) {
+        const double * t = &time[(size_t)d * nshapes * 2];
+        fprintf(stdout, "##### GPU %d\n", d);
+        fprintf(stdout, "Launch;sync;nowait;sync overhead;nowait overhead\n");
+        for (int j = 0; j < nshapes; j++) {
+            fprintf(stdout, "%s;%lf;%lf;%lf;%lf\n", names[j], t[j * 2], t[j * 2 + 1],
+                    t[j * 2] - t[0], t[j * 2 + 1] - t[1]);
+        }
+    }
+
+    free(time);
+    free(names);
+    free(shapes);
+    free(teams);
+    free(threads);
+    free(scalars);
+    free(pointers);
+}
+
+// Concurrent launches (LAT_THREADS)
+enum thread_op {
+    LAT_OP_LAUNCH = 0,  // empty target region
+    LAT_OP_MAP,         // target region with map(tofrom:) of LAT_MAP_SIZE bytes
+    LAT_NOPS
+};
+
+static const char * const op_names[LAT_NOPS] = { "launch", "map" };
+
+typedef struct thread_arg {
+    const bench_backend_t * be;
+    int dev;
+    char * host;
+    size_t size;
+} thread_arg_t;
+
+// one repetition of a small map: allocate, copy, launch, copy back, free
+static void map_rep(void * arg) {
+    thread_arg_t * a = (thread_arg_t *)arg;
+    a->be->roundtrip(a->dev, a->host, a->size);
+}
+
+// Concurrent mode: T threads (LAT_THREADS: "all" for 1, 2, 4, ... and all
+// cores, or a list like "1,2,8") issue empty target regions and small maps
+// (LAT_MAP_SIZE bytes, default 8) to the same device at the same time. The
+// aggregate rate is the total number of launches over the time from the
+// first start to the last end.
+static void run_threads(bench_context_t * ctx, const char * spec) {
+    const bench_backend_t * be = ctx->backend;
+    int ncores = ctx->ncores;
+    int ndev = ctx->ndev;
+    const char * env = getenv("LAT_MAP_SIZE");
+    size_t map_size = env ? bench_parse_size(env, NULL) : 8;
+    if (map_size == 0) {
+        map_size = 8;
+    }
+
+    // Thread counts: 1, 2, 4, ... and finally all cores, or an explicit list.
+    int nlevels = 0;
+    int * levels = (int *)malloc((ncores + 1) * sizeof(int));
+    if (strcmp(spec, "all") == 0) {
+        for (int k = 1; k < ncores; k *= 2) {
+            levels[nlevels++] = k;
+        }
+        levels[nlevels++] = ncores;
+    } else {
+        size_t * list = NULL;
+        int n = bench_parse_size_list(spec, &list);
+        for (int i = 0; i < n && nlevels <= ncores; i++) {
+            if (list[i] <= (size_t)ncores) {
+                levels[nlevels++] = (int)list[i];
+            }
+        }
+        free(list);
+    }
+    if (nlevels == 0 || ndev == 0) {
+        fprintf(stdout, "concurrent mode: nothing to measure (thread counts=%d, devices=%d)\n", nlevels, ndev);
+        free(levels);
+        return;
+    }
+
+    fprintf(stdout, "concurrent mode: thread counts");
+    for (int l = 0; l < nlevels; l++) {
+        fprintf(stdout, " %d", levels[l]);
+    }
+    fprintf(stdout, ", map size %zu bytes\n", map_size);
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    // Result data indexed by [op][device][level].
+    int ncells = LAT_NOPS * ndev * nlevels;
+    double * mean_latency = (double *)calloc(ncells, sizeof(double));
+    double * max_latency  = (double *)calloc(ncells, sizeof(double));
+    double * rate         = (double *)calloc(ncells, sizeof(double));
+    double * t_start      = (double *)malloc(ncores * sizeof(double));
+    double * t_end        = (double *)malloc(ncores * sizeof(double));
+    double * thread_mean  = (double *)malloc(ncores * sizeof(double));
+    int * thread_reps     = (int *)malloc(ncores * sizeof(int));
+
+    #pragma omp parallel num_threads(ncores)
+    {
+        int cur_thread = omp_get_thread_num();
+        char * host = (char *)malloc(map_size);
+        memset(host, 0, map_size);
+
+        for (int o = 0; o < LAT_NOPS; o++) {
+            for (int d = 0; d < ndev; d++) {
+                for (int l = 0; l < nlevels; l++) {
+                    int active = cur_thread < levels[l];
+                    #pragma omp single
+                    {
+                        bench_progress("running for %3d threads, device=%2d and %s\n", levels[l], d, op_names[o]);
+                    }
+                    // implicit barrier of single: all participants start together
+                    if (active) {
+                        thread_arg_t a = { be, d, host, map_size };
+                        launch_arg_t la = { be, d };
+                        bench_stats_t st;
+                        be->init_device(d);
+                        double ts = omp_get_wtime();
+                        if (o == LAT_OP_LAUNCH) {
+                            bench_sample(ctx, launch_rep, &la, 0, &st);
+                        } else {
+                            bench_sample(ctx, map_rep, &a, 0, &st);
+                        }
+                        double te = omp_get_wtime();
+                        t_start[cur_thread] = ts;
+                        t_end[cur_thread] = te;
+                        thread_mean[cur_thread] = st.mean;
+                        thread_reps[cur_thread] = st.n;
+
+                        char variant[64];
+                        snprintf(variant, sizeof(variant), "op=%s,threads=%d", op_names[o], levels[l]);
+                        bench_record_t rec;
+                        bench_record_init(&rec, "concurrent", cur_thread, d, o == LAT_OP_MAP ? map_size : 0);
+                        rec.variant = variant;
+                        rec.stats = &st;
+                        bench_record_add(&rec, "threads", levels[l]);
+                        bench_output_record(ctx, &rec);
+                    }
+                    #pragma omp barrier
+                    #pragma omp single
+                    {
+                        int idx = (o * ndev + d) * nlevels + l;
+                        double first = DBL_MAX, last = 0.0, sum = 0.0, max = 0.0;
+                        long launches = 0;
+                        for (int c = 0; c < levels[l]; c++) {
+                            first = t_start[c] < first ? t_start[c] : first;
+                            last = t_end[c] > last ? t_end[c] : last;
+                            sum += thread_mean[c];
+                            max = thread_mean[c] > max ? thread_mean[c] : max;
+                            launches += thread_reps[c];
+                        }
+                        mean_latency[idx] = sum / levels[l] * 1e6;
+                        max_latency[idx] = max * 1e6;
+                        rate[idx] = launches / (last - first);
+                    }
+                }
+            }
+        }
+        free(host);
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    for (int o = 0; o < LAT_NOPS; o++) {
+        const char * titles[4] = {
+            "mean per-thread latency (us)", "max per-thread latency (us)",
+            "aggregate rate (launches/s)", "aggregate rate relative to the first thread count"
+        };
+        for (int t = 0; t < 4; t++) {
+            fprintf(stdout, BENCH_SEPARATOR);
+            fprintf(stdout, "Concurrent %s: %s\n", op_names[o], titles[t]);
+            fprintf(stdout, BENCH_SEPARATOR);
+            fprintf(stdout, ";");
+            for (int l = 0; l < nlevels; l++) {
+                fprintf(stdout, "%d threads%c", levels[l], l<nlevels-1 ? ';' : '\n');
+            }
+            for (int d = 0; d < ndev; d++) {
+                int base = (o * ndev + d) * nlevels;
+                fprintf(stdout, "GPU %d;", d);
+                for (int l = 0; l < nlevels; l++) {
+                    double v = t == 0 ? mean_latency[base + l] : t == 1 ? max_latency[base + l]
+                             : t == 2 ? rate[base + l] : rate[base + l] / rate[base];
+                    fprintf(stdout, "%lf%c", v, l<nlevels-1 ? ';' : '\n');
+                }
+            }
+        }
+    }
+
+    free(mean_latency);
+    free(max_latency);
+    free(rate);
+    free(t_start);
+    free(t_end);
+    free(thread_mean);
+    free(thread_reps);
+    free(levels);
+}
+
+static int run(void) {
+    bench_context_t ctx;
+    bench_init(&ctx, "latency", REPS);
+
+    // Allocate the memory to store the result data.
+    const double usec = 1000.0 * 1000.0;
+    bench_stats_t ** stats = bench_stats_matrix_alloc(ctx.ncores, ctx.ndev);
+    double ** latency = bench_matrix_alloc(ctx.ncores, ctx.ndev);
+
+    bench_ompt_print_info(stdout);
+    bench_print_affinity(&ctx);
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_warmup(&ctx);
+
+    // Perform the actual measurements.
+    fprintf(stdout, "measurements...\n");
+    const char * breakdown = getenv("LAT_BREAKDOWN");
+    const char * thread_spec = getenv("LAT_THREADS");
+    if (thread_spec != NULL || (breakdown != NULL && atoi(breakdown) != 0)) {
+        if (thread_spec != NULL) {
+            run_threads(&ctx, thread_spec);
+        } else {
+            run_breakdown(&ctx);
+        }
+        bench_matrix_free(latency, ctx.ncores);
+        bench_stats_matrix_free(stats, ctx.ncores);
+        bench_finalize(&ctx);
+        return 0;
+    }
+    sweep_data_t data = { stats, NULL };
+    if (bench_ompt_active()) {
+        data.phases = (bench_ompt_phases_t **)malloc(ctx.ncores * sizeof(bench_ompt_phases_t *));
+        for (int c = 0; c < ctx.ncores; c++) {
+            data.phases[c] = (bench_ompt_phases_t *)calloc(ctx.ndev > 0 ? ctx.ndev : 1, sizeof(bench_ompt_phases_t));
+        }
+    }
+    bench_sweep_cores(&ctx, measure_core, &data);
+    bench_sweep_fill_rows(&ctx, (void **)stats, ctx.ndev * sizeof(bench_stats_t));
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    bench_stats_extract(stats, ctx.ncores, ctx.ndev, offsetof(bench_stats_t, mean), usec, latency);
+
+    double min_latency = bench_matrix_min(latency, ctx.ncores, ctx.ndev);
+
+    for (int c = 0; c < ctx.ncores; c++) {
+        for (int d = 0; d < ctx.ndev && bench_core_measured(&ctx, c); d++) {
+            bench_record_t rec;
+            bench_record_init(&rec, "sweep", c, d, 0);
+            rec.stats = &stats[c][d];
+            bench_output_record(&ctx, &rec);
+            if (data.phases != NULL) {
+                bench_record_init(&rec, "phases", c, d, 0);
+                bench_ompt_record_add(&rec, &data.phases[c][d]);
+                bench_output_record(&ctx, &rec);
+            }
+        }
+    }
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Absolute measurements (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_print_matrix(stdout, latency, ctx.ncores, ctx.ndev, 1.0);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Relative measurements to minimum latency\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_print_matrix(stdout, latency, ctx.ncores, ctx.ndev, min_latency);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Latency statistics per repetition (us)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    bench_print_stats(stdout, "Latency", "us", stats, ctx.ncores, ctx.ndev, usec);
+
+    if (data.phases != NULL) {
+        print_phases(&ctx, data.phases, latency);
+    }
+
+    bench_sweep_check(&ctx, latency, "latency");
+    bench_print_by_distance(&ctx, latency, "Latency (us)");
+    bench_affinity_report(&ctx, latency, 0);
+
+    // cleanup
+    if (data.phases != NULL) {
+        for (int c = 0; c < ctx.ncores; c++) {
+            free(data.phases[c]);
+        }
+        free(data.phases);
+    }
+    bench_matrix_free(latency, ctx.ncores);
+    bench_stats_matrix_free(stats, ctx.ncores);
+    bench_finalize(&ctx);
+
+    return 0;
+}
+
+int main(int argc, char const * argv[]) {
+    return bench_config_main(argc, argv, "latency", run);
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "config.h"
+
+#ifndef REPS
+#define REPS 100
+#endif
+
+// Copy paths between two devices
+enum peer_path {
+    PEER_DIRECT = 0,    // omp_target_memcpy / cudaMemcpyPeerAsync / hipMemcpyPeerAsync
+    PEER_STAGED,        // copy to a host buffer and from there to the destination
+    PEER_NPATHS
+};
+
+static const char * const path_names[PEER_NPATHS] = { "direct", "staged" };
+
+typedef struct peer_arg {
+    const bench_backend_t * be;
+    bench_devbuf_t * dst;
+    bench_devbuf_t * src;
+    size_t size;
+} peer_arg_t;
+
+// one repetition of a direct device-to-device copy
+static void direct_rep(void * arg) {
+    peer_arg_t * a = (peer_arg_t *)arg;
+    a->be->copy_peer(a->dst, a->src, a->size);
+}
+
+// one repetition of a copy staged through host memory: both device buffers
+// share the same host buffer
+static void staged_rep(void * arg) {
+    peer_arg_t * a = (peer_arg_t *)arg;
+    a->be->copy_d2h(a->src, a->size);
+    a->be->sync(a->src->dev);
+    a->be->copy_h2d(a->dst, a->size);
+    a->be->sync(a->dst->dev);
+}
+
+// Print a device x device matrix (rows: source, columns: destination).
+static void print_peer_matrix(FILE * out, double ** m, int ndev, double divisor) {
+    fprintf(out, "src\\dst;");
+    for (int j = 0; j < ndev; j++) {
+        fprintf(out, "GPU %d%c", j, j<ndev-1 ? ';' : '\n');
+    }
+    for (int i = 0; i < ndev; i++) {
+        fprintf(out, "GPU %d;", i);
+        for (int j = 0; j < ndev; j++) {
+            fprintf(out, "%lf%c", m[i][j] / divisor, j<ndev-1 ? ';' : '\n');
+        }
+    }
+}
+
+static int run(void) {
+    bench_context_t ctx;
+    bench_init(&ctx, "peer", REPS);
+    const bench_backend_t * be = ctx.backend;
+    int ndev = ctx.ndev;
+
+    // Determine the copy sizes: PEER_SIZES (e.g. "8,64K,1M"), default 8 B
+    // (latency), 1 MB and 64 MB.
+    const char * size_list = getenv("PEER_SIZES");
+    size_t * sizes = NULL;
+    int nsizes = bench_parse_size_list(size_list ? size_list : "8,1M,64M", &sizes);
+    size_t max_size = 1;
+    for (int s = 0; s < nsizes; s++) {
+        if (sizes[s] > max_size) {
+            max_size = sizes[s];
+        }
+    }
+    fprintf(stdout, "number of sizes: %d\n", nsizes);
+    fprintf(stdout, "direct copies: %s\n", be->copy_peer != NULL ? "yes" : "not supported");
+    fprintf(stdout, BENCH_SEPARATOR);
+    if (ndev == 0 || nsizes == 0) {
+        fprintf(stdout, "nothing to measure (devices=%d, sizes=%d)\n", ndev, nsizes);
+        free(sizes);
+        bench_finalize(&ctx);
+        return 0;
+    }
+
+    bench_warmup(&ctx);
+
+    // Enable peer access in both directions and record whether it is possible.
+    double ** access = bench_matrix_alloc(ndev, ndev);
+    for (int i = 0; i < ndev; i++) {
+        for (int j = 0; j < ndev; j++) {
+            access[i][j] = be->enable_peer != NULL ? be->enable_peer(i, j) : -1;
+        }
+    }
+
+    // Source and destination buffers on every device (separate ones so that
+    // copies within a device do not overlap) and a staging buffer on the
+    // host (page-locked if the backend supports it).
+    char * host = be->host_alloc_pinned != NULL ? be->host_alloc_pinned(max_size) : (char *)malloc(max_size);
+    memset(host, 0, max_size);
+    bench_devbuf_t * bufs = (bench_devbuf_t *)malloc(2 * ndev * sizeof(bench_devbuf_t));
+    for (int k = 0; k < 2 * ndev; k++) {
+        bench_devbuf_t buf = { k % ndev, host, max_size, NULL };
+        be->init_device(buf.dev);
+        be->alloc(&buf);
+        be->copy_h2d(&buf, max_size);
+        be->sync(buf.dev);
+        bufs[k] = buf;
+    }
+
+    // Results indexed by [path * nsizes + size][src][dst]
+    double *** time = (double ***)malloc(PEER_NPATHS * nsizes * sizeof(double **));
+    for (int k = 0; k < PEER_NPATHS * nsizes; k++) {
+        time[k] = bench_matrix_alloc(ndev, ndev);
+    }
+
+    // Perform the actual measurements from the initial thread.
+    fprintf(stdout, "measurements...\n");
+    for (int p = 0; p < PEER_NPATHS; p++) {
+        if (p == PEER_DIRECT && be->copy_peer == NULL) {
+            continue;
+        }
+        for (int s = 0; s < nsizes; s++) {
+            for (int i = 0; i < ndev; i++) {
+                for (int j = 0; j < ndev; j++) {
+                    bench_progress("running for path=%s, size=%7.2fMB, src=%2d and dst=%2d\n",
+                                   path_names[p], sizes[s] / 1e6, i, j);
+                    peer_arg_t a = { be, &bufs[ndev + j], &bufs[i], sizes[s] };
+                    bench_stats_t st;
+                    be->init_device(i);
+                    bench_sample(&ctx, p == PEER_DIRECT ? direct_rep : staged_rep, &a, 1, &st);
+                    time[p * nsizes + s][i][j] = st.mean;
+
+                    char variant[32];
+                    snprintf(variant, sizeof(variant), "path=%s", path_names[p]);
+                    bench_record_t rec;
+                    bench_record_init(&rec, "peer", -1, j, sizes[s]);
+                    rec.variant = variant;
+                    rec.stats = &st;
+                    bench_record_add(&rec, "src_device", i);
+                    bench_record_add(&rec, "bandwidth_mbs", sizes[s] / 1e6 / st.mean);
+                    bench_record_add(&rec, "peer_access", access[i][j]);
+                    bench_output_record(&ctx, &rec);
+                }
+            }
+        }
+    }
+    fprintf(stdout, BENCH_SEPARATOR);
+
+    fprintf(stdout, BENCH_SEPARATOR);
+    fprintf(stdout, "Peer access (1 = direct, 0 = no, -1 = unknown)\n");
+    fprintf(stdout, BENCH_SEPARATOR);
+    print_peer_matrix(stdout, access, ndev, 1.0);
+
+    double ** bw = bench_matrix_alloc(ndev, ndev);
+    for (int p = 0; p < PEER_NPATHS; p++) {
+        if (p == PEER_DIRECT && be->copy_peer == NULL) {
+            continue;
+        }
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Copy time, %s (us)\n", path_names[p]);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < nsizes; s++) {
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", sizes[s] / 1000.0);
+            print_peer_matrix(stdout, time[p * nsizes + s], ndev, 1e-6);
+        }
+
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Bandwidth, %s (MB/s)\n", path_names[p]);
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < nsizes; s++) {
+            for (int i = 0; i < ndev; i++) {
+                for (int j = 0; j < ndev; j++) {
+                    bw[i][j] = sizes[s] / 1e6 / time[p * nsizes + s][i][j];
+                }
+            }
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", sizes[s] / 1000.0);
+            print_peer_matrix(stdout, bw, ndev, 1.0);
+        }
+    }
+
+    if (be->copy_peer != NULL) {
+        fprintf(stdout, BENCH_SEPARATOR);
+        fprintf(stdout, "Speedup of direct over staged copies\n");
+        fprintf(stdout, BENCH_SEPARATOR);
+        for (int s = 0; s < nsizes; s++) {
+            for (int i = 0; i < ndev; i++) {
+                for (int j = 0; j < ndev; j++) {
+                    bw[i][j] = time[PEER_STAGED * nsizes + s][i][j] / time[PEER_DIRECT * nsizes + s][i][j];
+                }
+            }
+            fprintf(stdout, "##### Problem Size: %.2f KB\n", sizes[s] / 1000.0);
+            print_peer_matrix(stdout, bw, ndev, 1.0);
+        }
+    }
+
+    // cleanup
+    for (int k = 0; k < 2 * ndev; k++) {
+        be->free(&bufs[k]);
+    }
+    free(bufs);
+    if (be->host_alloc_pinned != NULL) {
+        be->host_free_pinned(host, max_size);
+    } else {
+        free(host);
+    }
+    for (int k = 0; k < PEER_NPATHS * nsizes; k++) {
+        bench_matrix_free(time[k], ndev);
+    }
+    free(time);
+    bench_matrix_free(bw, ndev);
+    bench_matrix_free(access, ndev);
+    free(sizes);
+    bench_finalize(&ctx);
+
+    return 0;
+}
+
+int main(int argc, char const * argv[]) {
+    return bench_config_main(argc, argv, "peer", run);
+}
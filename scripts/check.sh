@@ -0,0 +1,173 @@
+#!/bin/bash
+# Smoke test of the host builds without a GPU (make -C benchmarks check):
+#  - every driver runs with the host and the sim backend on tiny sizes,
+#    exits with status 0 and writes JSON Lines that parse
+#  - the sim matrices show the home and remote bandwidths and latencies of
+#    the topology in fixtures/sim
+#  - the topology discovery reads the sysfs tree in fixtures/sysfs
+#  - compare_results.py passes its fixture checks and flags a known
+#    regression of two sim runs with --fail
+#
+# The binaries are taken from BENCH_DIR (default: ../benchmarks next to this
+# script) and have to be built before, e.g. with make -C benchmarks host.
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BENCH_DIR="${BENCH_DIR:-${SCRIPT_DIR}/../benchmarks}"
+FIXTURES="${SCRIPT_DIR}/fixtures"
+TOPOLOGY="${FIXTURES}/sim/topology.txt"
+OUT_DIR="$(mktemp -d)"
+trap 'rm -rf "${OUT_DIR}"' EXIT
+
+FAILED=0
+
+fail() {
+    echo "FAIL: $*"
+    FAILED=1
+}
+
+# tiny problem sizes and few repetitions for every driver
+export BENCH_REPS=5
+export BW_SIZES=64K
+export PEER_SIZES=64K
+export FANOUT_SIZES=64K
+export FANOUT_THREADS=1,2
+export HOSTMEM_SIZES=64K
+export BENCH_HOST_DEVICES=2
+
+binary() {
+    if [ "$1" = "hostmem" ]; then
+        echo "${BENCH_DIR}/hostmem/bin/default/hostmem_default"
+    else
+        echo "${BENCH_DIR}/$1/bin/default/$1_host_default"
+    fi
+}
+
+# run <name> <env...>: run a binary with extra environment, output to OUT_DIR/<name>.{txt,jsonl}
+run() {
+    local name=$1 bench=$2
+    shift 2
+    local bin
+    bin="$(binary "${bench}")"
+    if [ ! -x "${bin}" ]; then
+        fail "${bin} not found, build with make host first"
+        return 1
+    fi
+    env "$@" BENCH_OUTPUT="${OUT_DIR}/${name}.jsonl" timeout 600 "${bin}" > "${OUT_DIR}/${name}.txt" 2>&1
+    local status=$?
+    if [ ${status} -ne 0 ]; then
+        fail "${name} exited with status ${status}"
+        tail -n 20 "${OUT_DIR}/${name}.txt"
+        return 1
+    fi
+    if ! python3 - "${OUT_DIR}/${name}.jsonl" <<'EOF'
+import json
+import sys
+
+types = {}
+with open(sys.argv[1]) as f:
+    for lineno, line in enumerate(f, 1):
+        try:
+            rec = json.loads(line)
+        except ValueError as e:
+            sys.exit("%s:%d: %s" % (sys.argv[1], lineno, e))
+        types[rec.get("type")] = types.get(rec.get("type"), 0) + 1
+if types.get("meta", 0) == 0 or types.get("result", 0) == 0:
+    sys.exit("%s: expected meta and result records, got %s" % (sys.argv[1], types))
+EOF
+    then
+        fail "${name} wrote invalid JSON Lines"
+        return 1
+    fi
+    echo "ok: ${name}"
+}
+
+####################################################
+### Drivers on the host and sim backends
+####################################################
+for backend in host sim; do
+    for bench in bandwidth latency peer fanout hostmem; do
+        run "${bench}_${backend}" "${bench}" BENCH_BACKEND=${backend} BENCH_SIM_TOPOLOGY="${TOPOLOGY}"
+    done
+done
+
+####################################################
+### Sim matrices follow the topology
+####################################################
+# Larger transfers so that the launch latency is small against the copies.
+if run sim_bandwidth bandwidth BENCH_BACKEND=sim BENCH_SIM_TOPOLOGY="${TOPOLOGY}" BW_SIZES=4M \
+    && run sim_latency latency BENCH_BACKEND=sim BENCH_SIM_TOPOLOGY="${TOPOLOGY}"; then
+    python3 - "${TOPOLOGY}" "${OUT_DIR}/sim_bandwidth.jsonl" "${OUT_DIR}/sim_latency.jsonl" <<'EOF' || fail "sim matrices do not match the topology"
+import json
+import sys
+
+topo = {}
+with open(sys.argv[1]) as f:
+    for line in f:
+        fields = line.split("#")[0].split()
+        if fields:
+            topo[fields[0]] = [float(v) for v in fields[1:]]
+home = [int(v) for v in topo["home"]]
+
+errors = 0
+cells = 0
+for path in sys.argv[2:]:
+    with open(path) as f:
+        for line in f:
+            rec = json.loads(line)
+            if rec.get("type") != "result" or rec.get("mode") != "sweep":
+                continue
+            where = "local" if rec["numa"] == home[rec["device"]] else "remote"
+            if rec["benchmark"] == "bandwidth":
+                # GB/s in the topology, MB/s measured
+                expected, value = topo["bandwidth_" + where][0] * 1e3, rec["bandwidth_mbs"]
+            else:
+                expected, value = topo["latency_" + where][0], rec["time_s"]["median"] * 1e6
+            cells += 1
+            if abs(value - expected) > 0.15 * expected:
+                print("%s core %d device %d (%s): %g, expected %g"
+                      % (rec["benchmark"], rec["core"], rec["device"], where, value, expected))
+                errors += 1
+if cells == 0 or errors > 0:
+    sys.exit(1)
+print("ok: sim matrices (%d cells)" % cells)
+EOF
+fi
+
+####################################################
+### Topology discovery on a sysfs fixture
+####################################################
+if run sysfs latency BENCH_SYSFS_ROOT="${FIXTURES}/sysfs" BENCH_DEVICE_PCI=0000:21:00.0,0000:C1:00.0; then
+    for expected in \
+        "NUMA domains: 2" \
+        "NUMA domain 1: cpus 2-3, distances 21 10" \
+        "device 0: pci 0000:21:00.0, NUMA domain 0, link 16.0 GT/s PCIe x16" \
+        "device 1: pci 0000:c1:00.0, NUMA domain 1, link 16.0 GT/s PCIe x16"; do
+        grep -qxF "${expected}" "${OUT_DIR}/sysfs.txt" || fail "sysfs: missing '${expected}'"
+    done
+fi
+
+####################################################
+### Result comparison
+####################################################
+python3 "${SCRIPT_DIR}/test_compare_results.py" || fail "test_compare_results.py"
+
+# A topology with twice the local latency is a regression, the same results are none.
+sed 's/^latency_local .*/latency_local 40/' "${TOPOLOGY}" > "${OUT_DIR}/slow_topology.txt"
+if run compare_base latency BENCH_BACKEND=sim BENCH_SIM_TOPOLOGY="${TOPOLOGY}" \
+    && run compare_slow latency BENCH_BACKEND=sim BENCH_SIM_TOPOLOGY="${OUT_DIR}/slow_topology.txt"; then
+    if python3 "${SCRIPT_DIR}/compare_results.py" --fail "${OUT_DIR}/compare_base.jsonl" \
+        "${OUT_DIR}/compare_slow.jsonl" > "${OUT_DIR}/compare.txt"; then
+        fail "compare_results.py --fail missed the regression"
+    elif ! python3 "${SCRIPT_DIR}/compare_results.py" --fail "${OUT_DIR}/compare_base.jsonl" \
+        "${OUT_DIR}/compare_base.jsonl" > "${OUT_DIR}/compare.txt"; then
+        fail "compare_results.py --fail flagged identical results"
+    else
+        echo "ok: compare_results.py --fail"
+    fi
+fi
+
+if [ ${FAILED} -ne 0 ]; then
+    echo "check failed"
+    exit 1
+fi
+echo "all checks passed"
@@ -0,0 +1,399 @@
+#!/usr/bin/env python3
+"""Compare benchmark result sets and flag significant changes.
+
+Every result set is a file or a directory of files in one of the formats
+the benchmarks write: the stdout tables (e.g. results/results_bw_c18g.txt),
+JSON Lines or CSV (BENCH_OUTPUT). The first set is the baseline, every
+further set is compared against it. Cells are aligned by benchmark, mode,
+variant, core (or NUMA domain with --by numa), device, size and metric and
+compared per node type (host name without the trailing node number).
+
+    compare_results.py results/2024-01 results/2024-06
+    compare_results.py --by numa --threshold 0.05 old.jsonl new.jsonl
+    compare_results.py --fail old/ new/        # exit code 1 on regressions
+
+A cell is flagged if its relative change exceeds the threshold and, where
+the per-repetition statistics are available, Welch's t-test rejects equal
+means at the given significance level.
+"""
+
+import argparse
+import csv
+import json
+import math
+import os
+import re
+import statistics
+import sys
+
+# metrics where a smaller value is better
+LOWER_IS_BETTER = {"time_us", "alpha_s", "n_half_bytes", "cycles", "page_faults",
+                   "context_switches", "llc_misses", "remote_accesses"}
+
+# derived records that are not measurements
+SKIP_MODES = {"affinity"}
+
+
+class Cell:
+    """Mean, standard deviation and repetitions of one measured value."""
+
+    def __init__(self, mean, stddev=None, n=None):
+        self.mean = mean
+        self.stddev = stddev
+        self.n = n
+
+    @staticmethod
+    def combine(cells):
+        # pooled over cores: mean of the means, mean variance, all repetitions
+        mean = statistics.fmean(c.mean for c in cells)
+        if all(c.stddev is not None and c.n for c in cells):
+            var = statistics.fmean(c.stddev ** 2 for c in cells)
+            return Cell(mean, math.sqrt(var), sum(c.n for c in cells))
+        return Cell(mean)
+
+
+class ResultSet:
+    """Cells of one result set indexed by node type and key."""
+
+    def __init__(self, path):
+        self.path = path
+        self.cells = {}     # node type -> key -> list of Cell
+        self.hosts = {}     # node type -> set of host names
+
+    def add(self, node_type, host, key, cell):
+        self.cells.setdefault(node_type, {}).setdefault(key, []).append(cell)
+        self.hosts.setdefault(node_type, set()).add(host)
+
+
+def node_type_of(host, pattern):
+    if pattern is not None:
+        m = re.search(pattern, host)
+        if m:
+            return m.group(1) if m.groups() else m.group(0)
+    return re.sub(r"[-_.]?\d+$", "", host) or host
+
+
+def to_float(value):
+    try:
+        return float(value)
+    except (TypeError, ValueError):
+        return None
+
+
+# ---------------------------------------------------------------------------
+# Loaders, all calling add(host, benchmark, mode, variant, core, numa, device,
+# size, metric, cell)
+# ---------------------------------------------------------------------------
+
+def load_jsonl(path, add):
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            rec = json.loads(line)
+            if rec.get("type") != "result":
+                continue
+            fixed = {"type", "hostname", "benchmark", "backend", "run", "mode", "variant",
+                     "core", "numa", "device", "size", "time_s"}
+            args = (rec.get("hostname", "unknown"), rec.get("benchmark"), rec.get("mode"),
+                    rec.get("variant"), rec.get("core", -1), rec.get("numa", -1),
+                    rec.get("device", -1), rec.get("size", 0))
+            st = rec.get("time_s")
+            if st is not None:
+                add(*args, "time_us", Cell(st["mean"] * 1e6, st["stddev"] * 1e6, st["n"]))
+            for name, value in rec.items():
+                if name not in fixed and isinstance(value, (int, float)):
+                    add(*args, name, Cell(float(value)))
+
+
+def load_csv(path, add):
+    with open(path) as f:
+        rows = csv.DictReader(line for line in f if not line.startswith("#"))
+        seen = set()
+        for row in rows:
+            args = (row["hostname"], row["benchmark"], row["mode"], row["variant"] or None,
+                    int(row["core"]), int(row["numa"]), int(row["device"]), int(row["size"]))
+            mean = to_float(row["mean"])
+            # the statistics are repeated on every row of a record
+            if mean is not None and (args, row.get("run")) not in seen:
+                seen.add((args, row.get("run")))
+                add(*args, "time_us", Cell(mean * 1e6, to_float(row["stddev"]) * 1e6, int(row["n"])))
+            value = to_float(row["value"])
+            if row["metric"] and value is not None:
+                add(*args, row["metric"], Cell(value))
+
+
+def parse_matrix(lines, i):
+    """Parse a ';Core 0;Core 1' table starting at line i into {(core, dev): value}."""
+    header = lines[i].rstrip("\n").split(";")
+    cores = [int(h.split()[-1]) for h in header[1:]]
+    values = {}
+    i += 1
+    while i < len(lines) and lines[i].startswith("GPU "):
+        parts = lines[i].rstrip("\n").split(";")
+        dev = int(parts[0].split()[1])
+        for core, value in zip(cores, parts[1:]):
+            v = to_float(value)
+            if v is not None:
+                values[(core, dev)] = v
+        i += 1
+    return values, i
+
+
+def load_stdout(path, add):
+    """Parse the sweep tables of the stdout format."""
+    with open(path, errors="replace") as f:
+        lines = f.readlines()
+    host = "unknown"
+    variant = None
+    size = 0
+    section = ""
+    stats = {}      # (benchmark, variant, size) -> stat -> matrix
+    bandwidth = {}  # (variant, size) -> matrix
+    latency = {}    # mean latency matrix of the baseline format without statistics
+
+    i = 0
+    while i < len(lines):
+        line = lines[i].rstrip("\n")
+        if line.startswith("hostname: "):
+            host = line[len("hostname: "):].strip()
+        elif line.startswith("##### Host memory: "):
+            variant = "memory=" + line.split(": ", 1)[1].strip()
+        elif line.startswith("##### Problem Size: "):
+            size = float(line.split(": ", 1)[1].split()[0]) * 1000.0
+        elif line.startswith("##### ") and ": " in line:
+            # per-repetition statistics, e.g. "##### Latency: mean (us)"
+            title, stat = line[6:].split(": ", 1)
+            stat = stat.split(" (")[0]
+            if title in ("Latency", "Round trip time") and i + 1 < len(lines) and lines[i + 1].startswith(";Core"):
+                bench = "latency" if title == "Latency" else "bandwidth"
+                key = (bench, variant if bench == "bandwidth" else None, size if bench == "bandwidth" else 0)
+                matrix, i = parse_matrix(lines, i + 1)
+                stats.setdefault(key, {})[stat] = matrix
+                continue
+        elif line.startswith(";Core") and section == "Absolute measurements (MB/s)":
+            matrix, i = parse_matrix(lines, i)
+            bandwidth[(variant, size)] = matrix
+            continue
+        elif line.startswith(";Core") and section == "Absolute measurements (us)":
+            matrix, i = parse_matrix(lines, i)
+            latency = matrix
+            continue
+        elif line and not line.startswith(("#", ";", "GPU ", "-")):
+            section = line.strip()
+        i += 1
+
+    for (bench, var, sz), columns in stats.items():
+        if "mean" not in columns:
+            continue
+        if bench == "bandwidth" and var is None:
+            var = "memory=pageable"
+        for (core, dev), mean in columns["mean"].items():
+            sd = columns.get("standard deviation", {}).get((core, dev))
+            n = columns.get("repetitions", {}).get((core, dev))
+            add(host, bench, "sweep", var, core, -1, dev, sz, "time_us",
+                Cell(mean, sd, int(n) if n else None))
+    if "mean" not in stats.get(("latency", None, 0), {}):
+        for (core, dev), mean in latency.items():
+            add(host, "latency", "sweep", None, core, -1, dev, 0, "time_us", Cell(mean))
+    for (var, sz), matrix in bandwidth.items():
+        for (core, dev), value in matrix.items():
+            add(host, "bandwidth", "sweep", var or "memory=pageable", core, -1, dev, sz,
+                "bandwidth_mbs", Cell(value))
+
+
+def load_set(path, by, node_pattern):
+    rs = ResultSet(path)
+
+    # the stdout tables of a benchmark are only used if no structured results
+    # of the same host and benchmark were found
+    structured = set()
+    pending = []
+
+    def insert(host, benchmark, mode, variant, core, numa, device, size, metric, cell):
+        if by == "numa":
+            core = ("numa", numa)
+        elif by == "device":
+            core = ("all",)
+        # sizes in KB as printed in the tables, so that all formats align
+        key = (benchmark, mode, variant or "", core, device, round(size / 1000.0, 2), metric)
+        rs.add(node_type_of(host, node_pattern), host, key, cell)
+
+    def add(*entry):
+        if entry[2] not in SKIP_MODES:
+            structured.add((entry[0], entry[1]))
+            insert(*entry)
+
+    def add_stdout(*entry):
+        if entry[2] not in SKIP_MODES:
+            pending.append(entry)
+
+    files = [path]
+    if os.path.isdir(path):
+        files = sorted(os.path.join(path, f) for f in os.listdir(path)
+                       if os.path.isfile(os.path.join(path, f)))
+    for f in files:
+        if f.endswith(".jsonl") or f.endswith(".json"):
+            load_jsonl(f, add)
+        elif f.endswith(".csv"):
+            load_csv(f, add)
+        else:
+            load_stdout(f, add_stdout)
+    for entry in pending:
+        if (entry[0], entry[1]) not in structured:
+            insert(*entry)
+    return rs
+
+
+# ---------------------------------------------------------------------------
+# Statistics
+# ---------------------------------------------------------------------------
+
+def betacf(a, b, x):
+    # continued fraction of the incomplete beta function (Numerical Recipes)
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > 1e-300 else 1e-300)
+    h = d
+    for m in range(1, 200):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > 1e-300 else 1e-300)
+        c = 1.0 + aa / c if abs(1.0 + aa / c) > 1e-300 else 1e-300
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > 1e-300 else 1e-300)
+        c = 1.0 + aa / c if abs(1.0 + aa / c) > 1e-300 else 1e-300
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def betai(a, b, x):
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    bt = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b)
+                  + a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return bt * betacf(a, b, x) / a
+    return 1.0 - bt * betacf(b, a, 1.0 - x) / b
+
+
+def welch_p(x, y):
+    """Two-sided p-value of Welch's t-test, None without statistics."""
+    if None in (x.stddev, y.stddev, x.n, y.n) or x.n < 2 or y.n < 2:
+        return None
+    vx, vy = x.stddev ** 2 / x.n, y.stddev ** 2 / y.n
+    if vx + vy == 0.0:
+        return 0.0 if x.mean != y.mean else 1.0
+    t = (y.mean - x.mean) / math.sqrt(vx + vy)
+    df = (vx + vy) ** 2 / ((vx ** 2 / (x.n - 1) if vx else 0.0) + (vy ** 2 / (y.n - 1) if vy else 0.0))
+    return betai(df / 2.0, 0.5, df / (df + t * t))
+
+
+# ---------------------------------------------------------------------------
+# Comparison and reports
+# ---------------------------------------------------------------------------
+
+def format_key(key):
+    benchmark, mode, variant, core, device, size, metric = key
+    if isinstance(core, tuple):
+        core = "all" if core[0] == "all" else "numa %d" % core[1]
+    else:
+        core = "core %d" % core
+    return "%s;%s;%s;%s;GPU %d;%.2f KB;%s" % (benchmark, mode, variant, core, device, size, metric)
+
+
+def compare(base, new, args, out):
+    regressions = 0
+    for node_type in sorted(set(base.cells) & set(new.cells)):
+        b_cells, n_cells = base.cells[node_type], new.cells[node_type]
+        keys = sorted(set(b_cells) & set(n_cells), key=lambda k: tuple(map(str, k)))
+        rows = []
+        summary = {}  # (benchmark, mode, metric) -> [cells, regressions, improvements, changes, deltas]
+        for key in keys:
+            x, y = Cell.combine(b_cells[key]), Cell.combine(n_cells[key])
+            if x.mean == 0.0:
+                continue
+            change = (y.mean - x.mean) / x.mean
+            p = welch_p(x, y)
+            time_key = key[:6] + ("time_us",)
+            if p is None and time_key != key and time_key in b_cells and time_key in n_cells:
+                # values derived from the time of the same record, e.g. bandwidth
+                p = welch_p(Cell.combine(b_cells[time_key]), Cell.combine(n_cells[time_key]))
+            metric = key[6]
+            worse = change > 0 if metric in LOWER_IS_BETTER else change < 0
+            significant = abs(change) > args.threshold and (p is None or p < args.alpha)
+            s = summary.setdefault((key[0], key[1], metric), [0, 0, 0, [], []])
+            s[0] += 1
+            s[3].append(change)
+            s[4].append(y.mean - x.mean)
+            if significant:
+                verdict = "REGRESSION" if worse else "improvement"
+                s[1 if worse else 2] += 1
+                rows.append((format_key(key), x.mean, y.mean, change, p, verdict))
+
+        out.write("#" * 63 + "\n")
+        out.write("Node type %s: %s (%s) vs. %s (%s)\n" % (
+            node_type, base.path, ",".join(sorted(base.hosts[node_type])),
+            new.path, ",".join(sorted(new.hosts[node_type]))))
+        out.write("#" * 63 + "\n")
+        out.write("Summary\n")
+        out.write("benchmark;mode;metric;cells;regressions;improvements;median change (%);median difference\n")
+        for (bench, mode, metric), (cells, reg, imp, changes, deltas) in sorted(summary.items()):
+            out.write("%s;%s;%s;%d;%d;%d;%.2f;%g\n" % (bench, mode, metric, cells, reg, imp,
+                      100.0 * statistics.median(changes), statistics.median(deltas)))
+        if rows:
+            out.write("-" * 63 + "\n")
+            out.write("Significant changes (threshold %.1f%%, alpha %g)\n" % (100.0 * args.threshold, args.alpha))
+            out.write("benchmark;mode;variant;core;device;size;metric;baseline;new;change (%);p-value;verdict\n")
+            rows.sort(key=lambda r: (r[5] != "REGRESSION", -abs(r[3])))
+            for name, xm, ym, change, p, verdict in rows[:args.max_rows]:
+                out.write("%s;%g;%g;%.2f;%s;%s\n" % (name, xm, ym, 100.0 * change,
+                                                    "-" if p is None else "%.3g" % p, verdict))
+            if len(rows) > args.max_rows:
+                out.write("... %d more\n" % (len(rows) - args.max_rows))
+        regressions += sum(1 for r in rows if r[5] == "REGRESSION")
+
+    for node_type in sorted(set(base.cells) ^ set(new.cells)):
+        where = base.path if node_type in base.cells else new.path
+        out.write("Node type %s only in %s, not compared\n" % (node_type, where))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("sets", nargs="+", metavar="RESULTS",
+                        help="result files or directories, the first one is the baseline")
+    parser.add_argument("--by", choices=["core", "numa", "device"], default="core",
+                        help="align cells per core, per NUMA domain or per device (default: core)")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="minimum relative change to report (default: 0.05)")
+    parser.add_argument("--alpha", type=float, default=0.01,
+                        help="significance level of the t-test (default: 0.01)")
+    parser.add_argument("--node-type", metavar="REGEX",
+                        help="regular expression whose first group extracts the node type from the host name")
+    parser.add_argument("--max-rows", type=int, default=50,
+                        help="maximum number of changes listed per node type (default: 50)")
+    parser.add_argument("--fail", action="store_true",
+                        help="exit with status 1 if any regression was found")
+    args = parser.parse_args()
+    if len(args.sets) < 2:
+        parser.error("at least two result sets are required")
+
+    sets = [load_set(path, args.by, args.node_type) for path in args.sets]
+    regressions = 0
+    for new in sets[1:]:
+        regressions += compare(sets[0], new, args, sys.stdout)
+    return 1 if args.fail and regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Checks of compare_results.py against the stdout fixtures.
+
+    python3 scripts/test_compare_results.py
+
+The fixtures in fixtures/compare_results hold the latency tables of the
+baseline format (absolute matrix only) and of the current format (matrix
+plus per-repetition statistics); the *_slow files add 5 us to every cell.
+"""
+
+import io
+import os
+import sys
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FIXTURES = os.path.join(HERE, "fixtures", "compare_results")
+sys.path.insert(0, HERE)
+
+import compare_results  # noqa: E402
+
+
+class Args:
+    threshold = 0.05
+    alpha = 0.01
+    max_rows = 50
+
+
+def load(name):
+    return compare_results.load_set(os.path.join(FIXTURES, name), "core", None)
+
+
+def regressions(base, new):
+    out = io.StringIO()
+    return compare_results.compare(load(base), load(new), Args(), out), out.getvalue()
+
+
+class LatencyStdout(unittest.TestCase):
+
+    def check_cells(self, name, host, with_stats):
+        rs = load(name)
+        cells = rs.cells[compare_results.node_type_of(host, None)]
+        self.assertEqual(len(cells), 4)
+        for key, values in cells.items():
+            self.assertEqual(key[0], "latency")
+            self.assertEqual(key[6], "time_us")
+            # one cell per key: the statistics replace the absolute matrix
+            self.assertEqual(len(values), 1)
+            self.assertEqual(values[0].n is not None, with_stats)
+        self.assertAlmostEqual(cells[("latency", "sweep", "", 1, 0, 0.0, "time_us")][0].mean, 12.4)
+
+    def test_old_format_cells(self):
+        self.check_cells("latency_old_base.txt", "unknown", False)
+
+    def test_new_format_cells(self):
+        self.check_cells("latency_new_base.txt", "node01", True)
+
+    def test_old_format_regression(self):
+        count, text = regressions("latency_old_base.txt", "latency_old_slow.txt")
+        self.assertEqual(count, 4, text)
+        count, text = regressions("latency_old_base.txt", "latency_old_base.txt")
+        self.assertEqual(count, 0, text)
+
+    def test_new_format_regression(self):
+        count, text = regressions("latency_new_base.txt", "latency_new_slow.txt")
+        self.assertEqual(count, 4, text)
+        count, text = regressions("latency_new_slow.txt", "latency_new_base.txt")
+        self.assertEqual(count, 0, text)
+
+
+if __name__ == "__main__":
+    unittest.main()